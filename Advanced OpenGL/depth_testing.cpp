@@ -169,3 +169,26 @@
 
 
 
+
+/*	Depth Testing Without a GPU
+	
+	In Practice/software_rasterizer.h draws the same scenes on the CPU, so they can be rendered on a
+	machine without a GPU and checked against a stored image. The depth test works exactly like the
+	one above: depthFunc takes the glDepthFunc constants, depthMask is glDepthMask and a fragment
+	is shaded only after it passes, with the functions of Lighting/lighting.h (the C++ copy of
+	lighting.glsl).
+	
+		SoftwareRasterizer rasterizer(800, 600, jobs.Parallel());
+		rasterizer.view = camera.GetViewMatrix();
+		rasterizer.projection = projection;
+		rasterizer.viewPos = camera.Position;
+		rasterizer.lights.pointLights.push_back(pointLight);
+		rasterizer.depthFunc = GL_LESS;
+		
+		rasterizer.Clear(glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+		rasterizer.DrawArrays(vertices, 36, model, material);
+		rasterizer.Framebuffer().WritePPM("frame.ppm");
+	
+	The screen is split into 64x64 tiles. Every triangle is put in the list of the tiles it covers,
+	then each tile is filled by one thread, four pixels at a time. Since a tile keeps the order the
+	triangles were drawn in, the image is the same no matter how many threads are used. */
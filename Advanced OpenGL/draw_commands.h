@@ -0,0 +1,335 @@
+#ifndef DRAW_COMMANDS_H
+#define DRAW_COMMANDS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "state_cache.h"
+#include "../In Practice/parallel_for.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// binding point of the optional per-draw uniform block (DrawPacket::uniformBuffer)
+#define DRAW_DATA_BINDING 1
+
+/*  Everything needed to issue one draw call later. Packets are plain data so that any thread can
+    record them; only DrawQueue::Submit touches GL. */
+struct DrawPacket {
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    int material = -1;            // value for the "materialID" uniform, -1 leaves it alone
+    unsigned int textureSet = 0;  // from DrawQueue::AddTextureSet, 0 binds no textures
+    GLenum mode = GL_TRIANGLES;
+    bool indexed = true;          // GL_UNSIGNED_INT indices from the vertex array's element buffer
+    GLsizei count = 0;
+    GLuint first = 0;             // first index, or first vertex when not indexed
+    GLint baseVertex = 0;
+    GLsizei instanceCount = 1;
+    GLuint uniformBuffer = 0;     // bound to DRAW_DATA_BINDING when non-zero
+    GLintptr uniformOffset = 0;
+    GLsizeiptr uniformSize = 0;
+    glm::mat4 model = glm::mat4(1.0f); // uploaded to the "model" uniform if the program has one
+};
+
+/*  Sort keys. The pass always comes first, so passes are submitted in order. Opaque draws are
+    grouped by program, then material, then texture set, and front to back within a group, which
+    keeps state changes rare and lets early-Z reject hidden fragments. Transparent draws have to be
+    blended back to front, so their depth comes right after the pass.
+
+        opaque:       pass:4 | program:10 | material:14 | textures:12 | depth:24
+        transparent:  pass:4 | ~depth:24  | program:10  | material:14 | textures:12
+
+    Program, material and texture set are reduced to their low bits; two that share the low bits
+    are merely interleaved, the packet still carries the real values. */
+const unsigned int DRAW_DEPTH_BITS = 24;
+
+// view-space distance in [near, far] to a 24 bit key field
+inline std::uint32_t quantizeDepth(float distance, float farPlane)
+{
+    float normalized = std::min(std::max(distance / farPlane, 0.0f), 1.0f);
+    return static_cast<std::uint32_t>(normalized * static_cast<float>((1u << DRAW_DEPTH_BITS) - 1));
+}
+
+inline std::uint64_t opaqueKey(unsigned int pass, GLuint program, int material, unsigned int textureSet, std::uint32_t depth)
+{
+    return (std::uint64_t(pass & 0xF) << 60) | (std::uint64_t(program & 0x3FF) << 50) |
+           (std::uint64_t(std::uint32_t(material + 1) & 0x3FFF) << 36) | (std::uint64_t(textureSet & 0xFFF) << 24) |
+           (depth & 0xFFFFFF);
+}
+
+inline std::uint64_t transparentKey(unsigned int pass, std::uint32_t depth, GLuint program, int material, unsigned int textureSet)
+{
+    return (std::uint64_t(pass & 0xF) << 60) | (std::uint64_t(~depth & 0xFFFFFF) << 36) |
+           (std::uint64_t(program & 0x3FF) << 26) | (std::uint64_t(std::uint32_t(material + 1) & 0x3FFF) << 12) |
+           (textureSet & 0xFFF);
+}
+
+inline unsigned int keyPass(std::uint64_t key)
+{
+    return static_cast<unsigned int>(key >> 60);
+}
+
+// draws recorded by one thread
+class DrawList {
+public:
+    std::vector<std::uint64_t> keys;
+    std::vector<DrawPacket> packets;
+
+    void Add(std::uint64_t key, const DrawPacket& packet)
+    {
+        keys.push_back(key);
+        packets.push_back(packet);
+    }
+
+    size_t Size() const
+    {
+        return keys.size();
+    }
+
+    // keeps the capacity, so recording the next frame doesn't allocate
+    void Clear()
+    {
+        keys.clear();
+        packets.clear();
+    }
+};
+
+struct DrawStats {
+    unsigned int draws = 0;
+    unsigned int programChanges = 0;
+    unsigned int materialChanges = 0;
+    unsigned int textureSetChanges = 0;
+    unsigned int vertexArrayChanges = 0;
+};
+
+/*  Replaces drawing while traversing the scene. Each worker records into its own DrawList (list i
+    for chunk i of a ParallelFor, for example), so recording needs no locks and the result doesn't
+    depend on thread timing. Sort merges all lists into one order with a stable LSD radix sort on
+    the keys, and Submit walks that order once on the GL thread, changing program, material,
+    textures and vertex array only when they differ from the previous draw. */
+class DrawQueue {
+public:
+    explicit DrawQueue(size_t listCount = 1)
+        : lists(std::max<size_t>(listCount, 1))
+    {
+    }
+
+    // list for one recording thread; created on first use, not thread-safe while growing
+    DrawList& List(size_t index)
+    {
+        if (index >= lists.size())
+            lists.resize(index + 1);
+        return lists[index];
+    }
+
+    size_t ListCount() const
+    {
+        return lists.size();
+    }
+
+    // textures bound to units 0..n-1 for draws with this set; returns the id to put in DrawPacket::textureSet
+    unsigned int AddTextureSet(const std::vector<GLuint>& textures)
+    {
+        textureSets.push_back(textures);
+        return static_cast<unsigned int>(textureSets.size());
+    }
+
+    // merge all lists into one order by key; equal keys keep list order, then recording order
+    void Sort(const ParallelFor& parallelFor = serialFor, size_t grain = 16384)
+    {
+        sorted.clear();
+        for (size_t list = 0; list < lists.size(); list++)
+            for (size_t i = 0; i < lists[list].Size(); i++)
+                sorted.push_back({ lists[list].keys[i], static_cast<std::uint32_t>(list), static_cast<std::uint32_t>(i) });
+        radixSort(parallelFor, grain);
+    }
+
+    const DrawPacket& Packet(size_t sortedIndex) const
+    {
+        const Entry& entry = sorted[sortedIndex];
+        return lists[entry.list].packets[entry.index];
+    }
+
+    size_t SortedCount() const
+    {
+        return sorted.size();
+    }
+
+    // issue every sorted draw; beginPass is called before the first draw of each pass (depth/blend setup)
+    DrawStats Submit(const std::function<void(unsigned int pass)>& beginPass = nullptr)
+    {
+        DrawStats stats;
+        unsigned int pass = ~0u;
+        GLuint program = 0;
+        ProgramUniforms* uniforms = nullptr;
+        unsigned int textureSet = 0;
+        GLuint vertexArray = ~0u;
+        // anything may have set the uniforms since the last submit
+        for (std::pair<const GLuint, ProgramUniforms>& cached : uniformCache)
+            cached.second.material = -1;
+
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            const DrawPacket& packet = Packet(i);
+            unsigned int packetPass = keyPass(sorted[i].key);
+            if (packetPass != pass)
+            {
+                pass = packetPass;
+                if (beginPass)
+                    beginPass(pass);
+            }
+            if (packet.program != program || !uniforms)
+            {
+                program = packet.program;
+                glState().UseProgram(program);
+                uniforms = &programUniforms(program);
+                stats.programChanges++;
+            }
+            if (packet.material >= 0 && packet.material != uniforms->material && uniforms->materialLocation >= 0)
+            {
+                glUniform1i(uniforms->materialLocation, packet.material);
+                uniforms->material = packet.material;
+                stats.materialChanges++;
+            }
+            if (packet.textureSet != textureSet && packet.textureSet != 0)
+            {
+                textureSet = packet.textureSet;
+                const std::vector<GLuint>& textures = textureSets[textureSet - 1];
+                for (unsigned int unit = 0; unit < textures.size(); unit++)
+                    glState().BindTexture(unit, GL_TEXTURE_2D, textures[unit]);
+                stats.textureSetChanges++;
+            }
+            if (packet.vertexArray != vertexArray)
+            {
+                vertexArray = packet.vertexArray;
+                glState().BindVertexArray(vertexArray);
+                stats.vertexArrayChanges++;
+            }
+            if (packet.uniformBuffer)
+                glState().BindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, packet.uniformBuffer, packet.uniformOffset, packet.uniformSize);
+            if (uniforms->modelLocation >= 0)
+                glUniformMatrix4fv(uniforms->modelLocation, 1, GL_FALSE, glm::value_ptr(packet.model));
+
+            if (packet.indexed)
+                glDrawElementsInstancedBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT,
+                                                  reinterpret_cast<void*>(static_cast<uintptr_t>(packet.first) * sizeof(GLuint)),
+                                                  packet.instanceCount, packet.baseVertex);
+            else
+                glDrawArraysInstanced(packet.mode, static_cast<GLint>(packet.first), packet.count, packet.instanceCount);
+            stats.draws++;
+        }
+        return stats;
+    }
+
+    // empty every list for the next frame, keeping their capacity
+    void Clear()
+    {
+        for (DrawList& list : lists)
+            list.Clear();
+        sorted.clear();
+    }
+
+    // forget cached uniform locations and values, e.g. after a program was relinked
+    void ForgetProgram(GLuint program)
+    {
+        uniformCache.erase(program);
+    }
+
+private:
+    struct Entry {
+        std::uint64_t key;
+        std::uint32_t list;
+        std::uint32_t index;
+    };
+
+    struct ProgramUniforms {
+        GLint modelLocation = -1;
+        GLint materialLocation = -1;
+        int material = -1; // last value set, uniforms keep their value per program
+    };
+
+    std::vector<DrawList> lists;
+    std::vector<std::vector<GLuint>> textureSets;
+    std::vector<Entry> sorted;
+    std::vector<Entry> scratch;
+    std::vector<size_t> histograms;
+    std::unordered_map<GLuint, ProgramUniforms> uniformCache;
+
+    ProgramUniforms& programUniforms(GLuint program)
+    {
+        std::unordered_map<GLuint, ProgramUniforms>::iterator it = uniformCache.find(program);
+        if (it != uniformCache.end())
+            return it->second;
+        ProgramUniforms& uniforms = uniformCache[program];
+        uniforms.modelLocation = glGetUniformLocation(program, "model");
+        uniforms.materialLocation = glGetUniformLocation(program, "materialID");
+        return uniforms;
+    }
+
+    // 8 bits per pass, skipping bytes that are the same in every key; chunks count and scatter in parallel
+    void radixSort(const ParallelFor& parallelFor, size_t grain)
+    {
+        const size_t count = sorted.size();
+        if (count < 2)
+            return;
+
+        std::uint64_t anyBits = 0, allBits = ~std::uint64_t(0);
+        for (const Entry& entry : sorted)
+        {
+            anyBits |= entry.key;
+            allBits &= entry.key;
+        }
+        std::uint64_t varying = anyBits ^ allBits;
+
+        grain = std::max<size_t>(grain, 1);
+        const size_t chunks = (count + grain - 1) / grain;
+        scratch.resize(count);
+        histograms.resize(chunks * 256);
+
+        for (unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            if (((varying >> shift) & 0xFF) == 0)
+                continue;
+
+            std::fill(histograms.begin(), histograms.end(), 0);
+            parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+                for (size_t chunk = begin; chunk < end; chunk++)
+                {
+                    size_t* histogram = &histograms[chunk * 256];
+                    size_t last = std::min(count, (chunk + 1) * grain);
+                    for (size_t i = chunk * grain; i < last; i++)
+                        histogram[(sorted[i].key >> shift) & 0xFF]++;
+                }
+            });
+
+            // exclusive prefix sum, digit-major and chunk-minor so the scatter stays stable
+            size_t offset = 0;
+            for (size_t digit = 0; digit < 256; digit++)
+                for (size_t chunk = 0; chunk < chunks; chunk++)
+                {
+                    size_t n = histograms[chunk * 256 + digit];
+                    histograms[chunk * 256 + digit] = offset;
+                    offset += n;
+                }
+
+            parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+                for (size_t chunk = begin; chunk < end; chunk++)
+                {
+                    size_t* position = &histograms[chunk * 256];
+                    size_t last = std::min(count, (chunk + 1) * grain);
+                    for (size_t i = chunk * grain; i < last; i++)
+                        scratch[position[(sorted[i].key >> shift) & 0xFF]++] = sorted[i];
+                }
+            });
+            sorted.swap(scratch);
+        }
+    }
+};
+#endif
@@ -0,0 +1,438 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum GpuMemoryCategory {
+    GPU_MEMORY_VERTEX = 0,
+    GPU_MEMORY_INDEX,
+    GPU_MEMORY_UNIFORM,
+    GPU_MEMORY_STORAGE,
+    GPU_MEMORY_STREAMING,
+    GPU_MEMORY_TEXTURE,
+    GPU_MEMORY_RENDER_TARGET,
+    GPU_MEMORY_OTHER,
+    GPU_MEMORY_CATEGORY_COUNT
+};
+
+inline const char* gpuMemoryCategoryName(GpuMemoryCategory category)
+{
+    static const char* names[GPU_MEMORY_CATEGORY_COUNT] = {
+        "vertex", "index", "uniform", "storage", "streaming", "texture", "render target", "other"
+    };
+    return category < GPU_MEMORY_CATEGORY_COUNT ? names[category] : "invalid";
+}
+
+enum GpuResourceKind {
+    GPU_RESOURCE_BUFFER = 0,
+    GPU_RESOURCE_TEXTURE = 1
+};
+
+// where an allocation was made; filled in by the GPU_MEMORY_SITE macro
+struct GpuMemorySite {
+    const char* file = "";
+    int line = 0;
+    const char* function = "";
+};
+
+#define GPU_MEMORY_SITE GpuMemorySite{ __FILE__, __LINE__, __func__ }
+
+struct GpuAllocation {
+    GpuResourceKind kind;
+    unsigned int name;
+    GpuMemoryCategory category;
+    size_t bytes;
+    std::string tag;          // who owns it: a mesh, material or system name
+    GpuMemorySite site;
+    // textures only
+    GLenum internalFormat = 0;
+    int width = 0, height = 0, depth = 1;
+    int mipLevels = 1;
+    // eviction
+    unsigned int createdFrame = 0;
+    unsigned int lastUsedFrame = 0;
+    std::function<void()> evict; // frees the resource (and untracks it); empty if it must stay
+};
+
+// bytes per texel, or per 4x4 block for compressed formats; unsized formats count as the size drivers pick
+inline size_t textureFormatBytes(GLenum internalFormat, bool& blockCompressed)
+{
+    blockCompressed = false;
+    switch (internalFormat)
+    {
+    case GL_RED: case GL_R8: case GL_STENCIL_INDEX8:
+        return 1;
+    case GL_RG: case GL_RG8: case GL_R16F: case GL_R16: case GL_DEPTH_COMPONENT16:
+        return 2;
+    // three channel formats are padded to four by practically every driver
+    case GL_RGB: case GL_RGB8: case GL_SRGB8: case GL_RGBA: case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_RGB10_A2:
+    case GL_R11F_G11F_B10F: case GL_RG16F: case GL_R32F: case GL_DEPTH_COMPONENT: case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F: case GL_DEPTH24_STENCIL8: case GL_DEPTH_STENCIL: case GL_RGBA8UI:
+        return 4;
+    case GL_RGB16F: case GL_RGBA16F: case GL_RG32F: case GL_RGBA16: case GL_DEPTH32F_STENCIL8:
+        return 8;
+    case GL_RGB32F: case GL_RGBA32F:
+        return 16;
+    // S3TC/DXT1 and RGTC1 are 8 bytes per 4x4 block, DXT3/5, RGTC2 and BPTC 16
+    case 0x83F0: case 0x83F1: case 0x8C4C: case 0x8C4D: case GL_COMPRESSED_RED_RGTC1: case GL_COMPRESSED_SIGNED_RED_RGTC1:
+        blockCompressed = true;
+        return 8;
+    case 0x83F2: case 0x83F3: case 0x8C4E: case 0x8C4F: case GL_COMPRESSED_RG_RGTC2: case GL_COMPRESSED_SIGNED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT: case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+        blockCompressed = true;
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+// size of a full mip chain; layers of an array don't shrink with the mips, the depth of a 3D texture does
+inline size_t textureBytes(GLenum internalFormat, int width, int height, int depth, int mipLevels, bool depthIsLayers = true)
+{
+    bool blockCompressed;
+    size_t unit = textureFormatBytes(internalFormat, blockCompressed);
+    size_t total = 0;
+    for (int level = 0; level < std::max(mipLevels, 1); level++)
+    {
+        size_t w = std::max(width >> level, 1), h = std::max(height >> level, 1);
+        size_t d = depthIsLayers ? std::max(depth, 1) : std::max(depth >> level, 1);
+        if (blockCompressed)
+            total += ((w + 3) / 4) * ((h + 3) / 4) * d * unit;
+        else
+            total += w * h * d * unit;
+    }
+    return total;
+}
+
+// levels in a full chain down to 1x1, what glGenerateMipmap creates
+inline int fullMipLevels(int width, int height)
+{
+    int levels = 1;
+    while ((width | height) >> levels)
+        levels++;
+    return levels;
+}
+
+/*  GpuMemoryTracker keeps a record of every buffer and texture the renderer allocates: its size,
+    format and mip chain, an owner tag and the source line that created it. GL itself can't tell
+    how much memory an object uses or who asked for it, so every allocation site reports to the
+    tracker right after glBufferData/glTexStorage and before glDelete*:
+
+        glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+        gpuMemory().TrackBuffer(VBO, size, GPU_MEMORY_VERTEX, "backpack", GPU_MEMORY_SITE);
+        ...
+        gpuMemory().Release(GPU_RESOURCE_BUFFER, VBO);
+        glDeleteBuffers(1, &VBO);
+
+    It keeps live totals per category with their high-water marks, lists what is still allocated
+    at shutdown as leaks, and enforces a memory budget: resources registered with an evict
+    function are freed least recently used first until the total fits. Like the state cache it
+    belongs to the GL thread. */
+class GpuMemoryTracker {
+public:
+    // print a leak report when the tracker is destroyed at exit
+    bool reportLeaksOnExit = true;
+
+    ~GpuMemoryTracker()
+    {
+        if (reportLeaksOnExit && !allocations.empty())
+            ReportLeaks(std::cout);
+    }
+
+    void BeginFrame()
+    {
+        frame++;
+    }
+
+    unsigned int Frame() const
+    {
+        return frame;
+    }
+
+    // a new buffer or a new size for an existing one (glBufferData reallocates)
+    void TrackBuffer(unsigned int name, size_t bytes, GpuMemoryCategory category, const std::string& tag, const GpuMemorySite& site)
+    {
+        GpuAllocation allocation;
+        allocation.kind = GPU_RESOURCE_BUFFER;
+        allocation.name = name;
+        allocation.category = category;
+        allocation.bytes = bytes;
+        allocation.tag = tag;
+        allocation.site = site;
+        track(allocation);
+    }
+
+    void TrackTexture(unsigned int name, GLenum internalFormat, int width, int height, int depth, int mipLevels,
+                      GpuMemoryCategory category, const std::string& tag, const GpuMemorySite& site, bool depthIsLayers = true)
+    {
+        GpuAllocation allocation;
+        allocation.kind = GPU_RESOURCE_TEXTURE;
+        allocation.name = name;
+        allocation.category = category;
+        allocation.bytes = textureBytes(internalFormat, width, height, depth, mipLevels, depthIsLayers);
+        allocation.tag = tag;
+        allocation.site = site;
+        allocation.internalFormat = internalFormat;
+        allocation.width = width;
+        allocation.height = height;
+        allocation.depth = depth;
+        allocation.mipLevels = mipLevels;
+        track(allocation);
+    }
+
+    // call before deleting the object; unknown names are ignored
+    void Release(GpuResourceKind kind, unsigned int name)
+    {
+        std::unordered_map<std::uint64_t, GpuAllocation>::iterator it = allocations.find(key(kind, name));
+        if (it == allocations.end())
+            return;
+        categoryBytes[it->second.category] -= it->second.bytes;
+        totalBytes -= it->second.bytes;
+        allocations.erase(it);
+    }
+
+    void Release(GpuResourceKind kind, size_t count, const unsigned int* names)
+    {
+        for (size_t i = 0; i < count; i++)
+            Release(kind, names[i]);
+    }
+
+    // the resource was used this frame, so it is the last candidate for eviction
+    void Touch(GpuResourceKind kind, unsigned int name)
+    {
+        std::unordered_map<std::uint64_t, GpuAllocation>::iterator it = allocations.find(key(kind, name));
+        if (it != allocations.end())
+            it->second.lastUsedFrame = frame;
+    }
+
+    // allow the budget to free this resource; evict has to delete it and call Release
+    void SetEvictable(GpuResourceKind kind, unsigned int name, const std::function<void()>& evict)
+    {
+        std::unordered_map<std::uint64_t, GpuAllocation>::iterator it = allocations.find(key(kind, name));
+        if (it != allocations.end())
+            it->second.evict = evict;
+    }
+
+    // 0 is no budget
+    void SetBudget(size_t bytes)
+    {
+        budget = bytes;
+    }
+
+    size_t Budget() const
+    {
+        return budget;
+    }
+
+    /*  Evict least recently used resources until the total is within the budget. Resources used
+        in the current frame are never evicted, since their draws may still be queued. Returns the
+        bytes freed; if that isn't enough, everything else is in use or not evictable. */
+    size_t EnforceBudget()
+    {
+        if (budget == 0 || totalBytes <= budget)
+            return 0;
+        std::vector<std::pair<unsigned int, std::uint64_t>> candidates;
+        for (const std::pair<const std::uint64_t, GpuAllocation>& entry : allocations)
+            if (entry.second.evict && entry.second.lastUsedFrame != frame)
+                candidates.push_back(std::make_pair(entry.second.lastUsedFrame, entry.first));
+        std::sort(candidates.begin(), candidates.end());
+
+        size_t freed = 0;
+        for (const std::pair<unsigned int, std::uint64_t>& candidate : candidates)
+        {
+            if (totalBytes <= budget)
+                break;
+            std::unordered_map<std::uint64_t, GpuAllocation>::iterator it = allocations.find(candidate.second);
+            if (it == allocations.end())
+                continue; // an earlier eviction already took it along
+            size_t before = totalBytes;
+            std::function<void()> evict = it->second.evict;
+            evict();
+            // an evict function that forgot Release would leave the record and loop the budget forever
+            it = allocations.find(candidate.second);
+            if (it != allocations.end())
+            {
+                std::cout << "ERROR::GPU_MEMORY: evicting " << it->second.tag << " didn't release it" << std::endl;
+                Release(it->second.kind, it->second.name);
+            }
+            freed += before - totalBytes;
+            evictions++;
+        }
+        return freed;
+    }
+
+    size_t TotalBytes() const
+    {
+        return totalBytes;
+    }
+
+    size_t PeakBytes() const
+    {
+        return peakBytes;
+    }
+
+    size_t CategoryBytes(GpuMemoryCategory category) const
+    {
+        return categoryBytes[category];
+    }
+
+    size_t CategoryPeakBytes(GpuMemoryCategory category) const
+    {
+        return categoryPeakBytes[category];
+    }
+
+    size_t AllocationCount() const
+    {
+        return allocations.size();
+    }
+
+    size_t Evictions() const
+    {
+        return evictions;
+    }
+
+    const GpuAllocation* Find(GpuResourceKind kind, unsigned int name) const
+    {
+        std::unordered_map<std::uint64_t, GpuAllocation>::const_iterator it = allocations.find(key(kind, name));
+        return it == allocations.end() ? nullptr : &it->second;
+    }
+
+    // bytes per owner tag, largest first: who owns what
+    std::vector<std::pair<std::string, size_t>> BytesByTag() const
+    {
+        std::unordered_map<std::string, size_t> sums;
+        for (const std::pair<const std::uint64_t, GpuAllocation>& entry : allocations)
+            sums[entry.second.tag] += entry.second.bytes;
+        std::vector<std::pair<std::string, size_t>> result(sums.begin(), sums.end());
+        std::sort(result.begin(), result.end(), [](const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b) {
+            return a.second > b.second;
+        });
+        return result;
+    }
+
+    void Report(std::ostream& out) const
+    {
+        out << "GPU memory: " << megabytes(totalBytes) << " MB in " << allocations.size() << " objects, peak "
+            << megabytes(peakBytes) << " MB";
+        if (budget)
+            out << ", budget " << megabytes(budget) << " MB";
+        out << std::endl;
+        for (int c = 0; c < GPU_MEMORY_CATEGORY_COUNT; c++)
+            if (categoryPeakBytes[c])
+                out << "  " << gpuMemoryCategoryName(GpuMemoryCategory(c)) << ": " << megabytes(categoryBytes[c])
+                    << " MB (peak " << megabytes(categoryPeakBytes[c]) << " MB)" << std::endl;
+        std::vector<std::pair<std::string, size_t>> tags = BytesByTag();
+        for (size_t i = 0; i < tags.size() && i < 10; i++)
+            out << "  " << (tags[i].first.empty() ? "(untagged)" : tags[i].first) << ": " << megabytes(tags[i].second) << " MB" << std::endl;
+    }
+
+    // everything still allocated, largest first, with the line that created it; returns the count
+    size_t ReportLeaks(std::ostream& out) const
+    {
+        std::vector<const GpuAllocation*> leaks;
+        for (const std::pair<const std::uint64_t, GpuAllocation>& entry : allocations)
+            leaks.push_back(&entry.second);
+        std::sort(leaks.begin(), leaks.end(), [](const GpuAllocation* a, const GpuAllocation* b) {
+            return a->bytes > b->bytes;
+        });
+        if (!leaks.empty())
+            out << "ERROR::GPU_MEMORY: " << leaks.size() << " objects (" << megabytes(totalBytes) << " MB) were never released" << std::endl;
+        for (const GpuAllocation* leak : leaks)
+        {
+            out << "  " << (leak->kind == GPU_RESOURCE_BUFFER ? "buffer " : "texture ") << leak->name << " "
+                << gpuMemoryCategoryName(leak->category) << " " << leak->bytes << " bytes";
+            if (leak->kind == GPU_RESOURCE_TEXTURE)
+                out << " " << leak->width << "x" << leak->height << "x" << leak->depth << " format 0x" << std::hex
+                    << leak->internalFormat << std::dec << " " << leak->mipLevels << " mips";
+            out << " '" << leak->tag << "' from " << leak->site.function << " (" << leak->site.file << ":" << leak->site.line
+                << "), frame " << leak->createdFrame << std::endl;
+        }
+        return leaks.size();
+    }
+
+    /*  What the driver says is still free, in kilobytes, where it says anything at all
+        (GL_NVX_gpu_memory_info or GL_ATI_meminfo); -1 otherwise. Useful to pick a budget. */
+    static GLint DriverAvailableKilobytes()
+    {
+        static int extension = -1; // 0 none, 1 NVX, 2 ATI
+        if (extension < 0)
+        {
+            extension = 0;
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count; i++)
+            {
+                const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+                if (name && std::strcmp(name, "GL_NVX_gpu_memory_info") == 0)
+                    extension = 1;
+                else if (name && std::strcmp(name, "GL_ATI_meminfo") == 0 && extension == 0)
+                    extension = 2;
+            }
+        }
+        GLint values[4] = { -1, -1, -1, -1 };
+        if (extension == 1)
+            glGetIntegerv(0x9049, values); // GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+        else if (extension == 2)
+            glGetIntegerv(0x87FC, values); // TEXTURE_FREE_MEMORY_ATI, first value is the total free
+        return values[0];
+    }
+
+private:
+    std::unordered_map<std::uint64_t, GpuAllocation> allocations;
+    size_t categoryBytes[GPU_MEMORY_CATEGORY_COUNT] = {};
+    size_t categoryPeakBytes[GPU_MEMORY_CATEGORY_COUNT] = {};
+    size_t totalBytes = 0;
+    size_t peakBytes = 0;
+    size_t budget = 0;
+    size_t evictions = 0;
+    unsigned int frame = 0;
+
+    static std::uint64_t key(GpuResourceKind kind, unsigned int name)
+    {
+        return (std::uint64_t(kind) << 32) | name;
+    }
+
+    static double megabytes(size_t bytes)
+    {
+        return double(bytes) / (1024.0 * 1024.0);
+    }
+
+    void track(GpuAllocation& allocation)
+    {
+        // a re-specified object keeps its place in the eviction order and its evict function
+        std::uint64_t k = key(allocation.kind, allocation.name);
+        std::unordered_map<std::uint64_t, GpuAllocation>::iterator existing = allocations.find(k);
+        if (existing != allocations.end())
+        {
+            allocation.createdFrame = existing->second.createdFrame;
+            allocation.evict = existing->second.evict;
+            Release(allocation.kind, allocation.name);
+        }
+        else
+            allocation.createdFrame = frame;
+        allocation.lastUsedFrame = frame;
+
+        categoryBytes[allocation.category] += allocation.bytes;
+        categoryPeakBytes[allocation.category] = std::max(categoryPeakBytes[allocation.category], categoryBytes[allocation.category]);
+        totalBytes += allocation.bytes;
+        peakBytes = std::max(peakBytes, totalBytes);
+        allocations.emplace(k, allocation);
+    }
+};
+
+inline GpuMemoryTracker& gpuMemory()
+{
+    static GpuMemoryTracker tracker;
+    return tracker;
+}
+#endif
@@ -0,0 +1,333 @@
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "state_cache.h"
+#include "gpu_memory.h"
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+enum GpuResourceType {
+    GPU_BUFFER = 0,
+    GPU_TEXTURE,
+    GPU_VERTEX_ARRAY,
+    GPU_RESOURCE_TYPE_COUNT
+};
+
+/*  A reference to a GL object in the resource pool. The generation changes every time the pool
+    slot is reused, so a handle kept after its object was destroyed no longer resolves (Name()
+    returns 0) instead of silently pointing at whatever object got the slot next. */
+struct GpuHandle {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0; // 0 is never handed out, so a default handle is always invalid
+
+    bool operator==(const GpuHandle& other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+
+    bool operator!=(const GpuHandle& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+struct GpuResourceStats {
+    size_t live = 0;           // objects alive
+    size_t pending = 0;        // destroyed, waiting for the GPU to finish with them
+    size_t deleted = 0;        // handed back to GL since startup
+    size_t batches = 0;        // glDelete* calls made for them
+    size_t staleLookups = 0;   // Name() calls with an outdated handle
+};
+
+/*  Owns every GL buffer, texture and vertex array created through it. Destroy doesn't call
+    glDelete*: the object may still be read by draws the GPU hasn't run yet, and deleting it in the
+    middle of a frame can make the driver wait for them. Instead the name goes into the current
+    frame's batch. EndFrame closes the batch with a fence, and Collect (at the start of a frame)
+    deletes every batch whose fence has signaled, with one glDelete* call per object type and
+    without ever waiting on the GPU.
+
+    All of it runs on the GL thread. Call Flush before destroying the context. */
+class GpuResourcePool {
+public:
+    GpuResourceStats stats;
+
+    GpuResourcePool()
+    {
+        // slot 0 stays unused so index 0 can never be valid
+        slots.push_back(Slot());
+    }
+
+    ~GpuResourcePool()
+    {
+        // the context may already be gone at static destruction, so no GL calls here
+        if (stats.live || stats.pending)
+            std::cout << "ERROR::GPU_RESOURCES: " << stats.live << " objects alive and " << stats.pending
+                      << " waiting for deletion at exit; call Flush before destroying the context" << std::endl;
+    }
+
+    GpuHandle Create(GpuResourceType type)
+    {
+        unsigned int name = 0;
+        if (type == GPU_BUFFER)
+            glGenBuffers(1, &name);
+        else if (type == GPU_TEXTURE)
+            glGenTextures(1, &name);
+        else
+            glGenVertexArrays(1, &name);
+        return adopt(type, name);
+    }
+
+    // take over an object created elsewhere
+    GpuHandle Adopt(GpuResourceType type, unsigned int name)
+    {
+        return adopt(type, name);
+    }
+
+    // the GL name, or 0 if the handle is stale or was never valid
+    unsigned int Name(GpuHandle handle)
+    {
+        if (!valid(handle))
+        {
+            if (handle.generation != 0)
+                stats.staleLookups++;
+            return 0;
+        }
+        return slots[handle.index].name;
+    }
+
+    bool Valid(GpuHandle handle) const
+    {
+        return valid(handle);
+    }
+
+    // the handle stops resolving right away; the object is deleted once the GPU is done with this frame
+    void Destroy(GpuHandle handle)
+    {
+        if (!valid(handle))
+            return;
+        Slot& slot = slots[handle.index];
+        current.names[slot.type].push_back(slot.name);
+        slot.name = 0;
+        // skip 0 on wrap around so default handles stay invalid
+        if (++slot.generation == 0)
+            slot.generation = 1;
+        freeSlots.push_back(handle.index);
+        stats.live--;
+        stats.pending++;
+    }
+
+    // fence this frame's destroyed objects; call after the frame's last draw
+    void EndFrame()
+    {
+        if (current.Empty())
+            return;
+        current.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        batches.push_back(std::move(current));
+        current = Batch();
+    }
+
+    // delete the batches the GPU is done with; never waits
+    void Collect()
+    {
+        while (!batches.empty())
+        {
+            Batch& batch = batches.front();
+            GLenum status = glClientWaitSync(batch.fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+                break; // later batches were fenced later, so they can't be done either
+            // a fence that can't be waited on would hold back every batch after it; GL defers the
+            // deletion of objects still in use anyway, so release the batch rather than leak it
+            if (status == GL_WAIT_FAILED)
+                std::cout << "ERROR::GPU_RESOURCES::FENCE_WAIT_FAILED: releasing the batch without it" << std::endl;
+            release(batch);
+            batches.pop_front();
+        }
+    }
+
+    // wait for the GPU and delete everything pending, before destroying the context or to reclaim memory now
+    void Flush()
+    {
+        EndFrame();
+        for (Batch& batch : batches)
+        {
+            glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            release(batch);
+        }
+        batches.clear();
+    }
+
+private:
+    struct Slot {
+        unsigned int name = 0;
+        std::uint32_t generation = 1;
+        GpuResourceType type = GPU_BUFFER;
+    };
+
+    struct Batch {
+        std::vector<unsigned int> names[GPU_RESOURCE_TYPE_COUNT];
+        GLsync fence = 0;
+
+        bool Empty() const
+        {
+            for (const std::vector<unsigned int>& list : names)
+                if (!list.empty())
+                    return false;
+            return true;
+        }
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> freeSlots;
+    Batch current;
+    std::deque<Batch> batches;
+
+    bool valid(GpuHandle handle) const
+    {
+        return handle.index != 0 && handle.index < slots.size() && slots[handle.index].generation == handle.generation &&
+               slots[handle.index].name != 0;
+    }
+
+    GpuHandle adopt(GpuResourceType type, unsigned int name)
+    {
+        std::uint32_t index;
+        if (!freeSlots.empty())
+        {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            index = static_cast<std::uint32_t>(slots.size());
+            slots.push_back(Slot());
+        }
+        Slot& slot = slots[index];
+        slot.name = name;
+        slot.type = type;
+        stats.live++;
+
+        GpuHandle handle;
+        handle.index = index;
+        handle.generation = slot.generation;
+        return handle;
+    }
+
+    void release(Batch& batch)
+    {
+        std::vector<unsigned int>& buffers = batch.names[GPU_BUFFER];
+        std::vector<unsigned int>& textures = batch.names[GPU_TEXTURE];
+        std::vector<unsigned int>& vertexArrays = batch.names[GPU_VERTEX_ARRAY];
+        // the state cache must not think a recycled name is still bound
+        for (unsigned int name : buffers)
+            glState().ForgetBuffer(name);
+        for (unsigned int name : textures)
+            glState().ForgetTexture(name);
+        for (unsigned int name : vertexArrays)
+            glState().ForgetVertexArray(name);
+        gpuMemory().Release(GPU_RESOURCE_BUFFER, buffers.size(), buffers.data());
+        gpuMemory().Release(GPU_RESOURCE_TEXTURE, textures.size(), textures.data());
+
+        if (!buffers.empty())
+        {
+            glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+            stats.batches++;
+        }
+        if (!textures.empty())
+        {
+            glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+            stats.batches++;
+        }
+        if (!vertexArrays.empty())
+        {
+            glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+            stats.batches++;
+        }
+        size_t count = buffers.size() + textures.size() + vertexArrays.size();
+        stats.deleted += count;
+        stats.pending -= count;
+        if (batch.fence)
+            glDeleteSync(batch.fence);
+        batch.fence = 0;
+    }
+};
+
+inline GpuResourcePool& gpuResources()
+{
+    static GpuResourcePool pool;
+    return pool;
+}
+
+/*  Move-only owner of one pooled object: the object is destroyed (deferred, see above) when its
+    owner goes away, and can't be aliased by a copy. */
+template <GpuResourceType TYPE>
+class GpuResource {
+public:
+    GpuResource() = default;
+
+    static GpuResource Create()
+    {
+        GpuResource resource;
+        resource.handle = gpuResources().Create(TYPE);
+        return resource;
+    }
+
+    ~GpuResource()
+    {
+        Reset();
+    }
+
+    GpuResource(GpuResource&& other) noexcept
+        : handle(other.handle)
+    {
+        other.handle = GpuHandle();
+    }
+
+    GpuResource& operator=(GpuResource&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            handle = other.handle;
+            other.handle = GpuHandle();
+        }
+        return *this;
+    }
+
+    GpuResource(const GpuResource&) = delete;
+    GpuResource& operator=(const GpuResource&) = delete;
+
+    unsigned int Name() const
+    {
+        return gpuResources().Name(handle);
+    }
+
+    GpuHandle Handle() const
+    {
+        return handle;
+    }
+
+    explicit operator bool() const
+    {
+        return gpuResources().Valid(handle);
+    }
+
+    void Reset()
+    {
+        if (handle.generation != 0)
+            gpuResources().Destroy(handle);
+        handle = GpuHandle();
+    }
+
+private:
+    GpuHandle handle;
+};
+
+typedef GpuResource<GPU_BUFFER> GpuBuffer;
+typedef GpuResource<GPU_TEXTURE> GpuTexture;
+typedef GpuResource<GPU_VERTEX_ARRAY> GpuVertexArray;
+#endif
@@ -0,0 +1,56 @@
+// Material lookup by ID for shaders drawn with MaterialTextures (material_textures.h).
+// Define BINDLESS_TEXTURES when MaterialTextures::Bindless() is true; MATERIAL_BINDING must match
+// the binding passed to MaterialTextures::Bind.
+#pragma once
+
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
+
+#ifndef MATERIAL_BINDING
+#define MATERIAL_BINDING 0
+#endif
+#define MAX_MATERIAL_ARRAYS 8
+
+struct MaterialData {
+    uvec2 diffuseHandle;
+    uvec2 specularHandle;
+    ivec4 layers;       // diffuse array, diffuse layer, specular array, specular layer
+    float shininess;
+};
+
+layout (std430, binding = MATERIAL_BINDING) readonly buffer Materials {
+    MaterialData materials[];
+};
+
+#ifndef BINDLESS_TEXTURES
+uniform sampler2DArray materialArrays[MAX_MATERIAL_ARRAYS];
+
+// the array index has to be dynamically uniform: a per-draw uniform or gl_DrawID both are
+vec4 sampleMaterialArray(int array, int layer, vec2 uv)
+{
+    if (array < 0)
+        return vec4(0.0);
+    return texture(materialArrays[array], vec3(uv, float(layer)));
+}
+#endif
+
+vec4 sampleDiffuse(int materialID, vec2 uv)
+{
+#ifdef BINDLESS_TEXTURES
+    uvec2 handle = materials[materialID].diffuseHandle;
+    return handle == uvec2(0) ? vec4(0.0) : texture(sampler2D(handle), uv);
+#else
+    return sampleMaterialArray(materials[materialID].layers.x, materials[materialID].layers.y, uv);
+#endif
+}
+
+vec4 sampleSpecular(int materialID, vec2 uv)
+{
+#ifdef BINDLESS_TEXTURES
+    uvec2 handle = materials[materialID].specularHandle;
+    return handle == uvec2(0) ? vec4(0.0) : texture(sampler2D(handle), uv);
+#else
+    return sampleMaterialArray(materials[materialID].layers.z, materials[materialID].layers.w, uv);
+#endif
+}
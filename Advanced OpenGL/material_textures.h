@@ -0,0 +1,343 @@
+#ifndef MATERIAL_TEXTURES_H
+#define MATERIAL_TEXTURES_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <stb_image.h>
+
+#include "state_cache.h"
+#include "gpu_memory.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// where a texture lives once uploaded: an array and layer, or a resident bindless handle
+struct MaterialTextureRef {
+    int array = -1;
+    int layer = -1;
+    GLuint64 handle = 0;
+    // index into the set's texture list, -1 for "no texture"
+    int index = -1;
+};
+
+// one material as the shaders see it (std430 layout, see material_textures.glsl)
+struct GPUMaterial {
+    GLuint64 diffuseHandle;
+    GLuint64 specularHandle;
+    // diffuse array, diffuse layer, specular array, specular layer
+    GLint layers[4];
+    float shininess;
+    float padding[3];
+};
+
+/*  MaterialTextures takes the per-draw texture binding out of the render loop. Every material's
+    maps are uploaded once, and a shader finds them through a material ID instead of through
+    whatever happens to be bound to GL_TEXTURE0/GL_TEXTURE1:
+
+    - with ARB_bindless_texture each texture gets a resident 64-bit handle, stored in the material
+      SSBO; the shader turns the handle straight into a sampler2D.
+    - without it, textures with the same size share a GL_TEXTURE_2D_ARRAY and the material stores
+      the array and layer. All arrays are bound once per frame.
+
+    Either way the only per-draw state left is the material ID, which is what allows draws with
+    different materials to be merged into one multi-draw. Textures are expanded to RGBA8 on upload
+    so maps with a different channel count can still share an array. */
+class MaterialTextures {
+public:
+    static const unsigned int MAX_ARRAYS = 8;
+
+    MaterialTextures(bool allowBindless = true)
+    {
+        bindless = allowBindless && GLAD_GL_ARB_bindless_texture;
+    }
+
+    ~MaterialTextures()
+    {
+        release();
+    }
+
+    MaterialTextures(const MaterialTextures&) = delete;
+    MaterialTextures& operator=(const MaterialTextures&) = delete;
+
+    bool Bindless() const
+    {
+        return bindless;
+    }
+
+    // queue raw 8-bit pixels (1 to 4 components); the GPU copy is made in Upload
+    MaterialTextureRef AddTexture(const unsigned char* pixels, int width, int height, int components)
+    {
+        if (texturesUploaded)
+        {
+            std::cout << "ERROR::MATERIAL_TEXTURES: textures must be added before Upload" << std::endl;
+            return MaterialTextureRef();
+        }
+        PendingTexture texture;
+        texture.width = width;
+        texture.height = height;
+        texture.pixels.resize(static_cast<size_t>(width) * height * 4);
+        for (size_t i = 0, n = static_cast<size_t>(width) * height; i < n; i++)
+        {
+            const unsigned char* in = pixels + i * components;
+            unsigned char* out = &texture.pixels[i * 4];
+            out[0] = in[0];
+            out[1] = components > 1 ? in[1] : in[0];
+            out[2] = components > 2 ? in[2] : in[0];
+            out[3] = components > 3 ? in[3] : 255;
+        }
+        textures.push_back(std::move(texture));
+
+        MaterialTextureRef ref;
+        ref.index = static_cast<int>(textures.size() - 1);
+        return ref;
+    }
+
+    // same as loadTexture in the lighting chapter, but into this set
+    MaterialTextureRef LoadTexture(const char* path)
+    {
+        int width, height, nrComponents;
+        unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
+        if (!data)
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return MaterialTextureRef();
+        }
+        MaterialTextureRef ref = AddTexture(data, width, height, nrComponents);
+        stbi_image_free(data);
+        return ref;
+    }
+
+    // register a material and return its ID
+    unsigned int AddMaterial(const MaterialTextureRef& diffuse, const MaterialTextureRef& specular, float shininess)
+    {
+        materials.push_back({ diffuse.index, specular.index, shininess });
+        dirty = true;
+        return static_cast<unsigned int>(materials.size() - 1);
+    }
+
+    // resolve a reference returned by AddTexture after Upload
+    MaterialTextureRef Resolve(const MaterialTextureRef& ref) const
+    {
+        if (ref.index < 0 || ref.index >= static_cast<int>(placements.size()))
+            return ref;
+        return placements[ref.index];
+    }
+
+    // create the GL textures (once, after all textures were added) and the material buffer;
+    // call again after adding materials to rebuild just the buffer
+    void Upload()
+    {
+        if (!dirty && texturesUploaded)
+            return;
+
+        if (!texturesUploaded)
+        {
+            placements.assign(textures.size(), MaterialTextureRef());
+            if (bindless)
+                uploadBindless();
+            else
+                uploadArrays();
+
+            // the pixels live on the GPU now
+            for (PendingTexture& texture : textures)
+                std::vector<unsigned char>().swap(texture.pixels);
+            texturesUploaded = true;
+        }
+
+        // the material buffer
+        std::vector<GPUMaterial> gpuMaterials;
+        for (const Material& material : materials)
+        {
+            GPUMaterial gpu;
+            std::memset(&gpu, 0, sizeof(gpu));
+            MaterialTextureRef diffuse = material.diffuse >= 0 ? placements[material.diffuse] : MaterialTextureRef();
+            MaterialTextureRef specular = material.specular >= 0 ? placements[material.specular] : MaterialTextureRef();
+            gpu.diffuseHandle = diffuse.handle;
+            gpu.specularHandle = specular.handle;
+            gpu.layers[0] = diffuse.array;
+            gpu.layers[1] = diffuse.layer;
+            gpu.layers[2] = specular.array;
+            gpu.layers[3] = specular.layer;
+            gpu.shininess = material.shininess;
+            gpuMaterials.push_back(gpu);
+        }
+        if (!materialBuffer)
+            glGenBuffers(1, &materialBuffer);
+        glState().BindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, gpuMaterials.size() * sizeof(GPUMaterial),
+                     gpuMaterials.empty() ? nullptr : gpuMaterials.data(), GL_STATIC_DRAW);
+        gpuMemory().TrackBuffer(materialBuffer, gpuMaterials.size() * sizeof(GPUMaterial), GPU_MEMORY_STORAGE, "materials", GPU_MEMORY_SITE);
+        dirty = false;
+    }
+
+    // bind the material buffer and (without bindless) all texture arrays; once per frame, not per draw.
+    // The program's "materialArrays" sampler array is pointed at units firstUnit onwards.
+    void Bind(unsigned int program, unsigned int materialBinding = 0, unsigned int firstUnit = 0)
+    {
+        glState().BindBufferRange(GL_SHADER_STORAGE_BUFFER, materialBinding, materialBuffer);
+        if (bindless)
+            return;
+
+        GLint units[MAX_ARRAYS];
+        for (unsigned int i = 0; i < MAX_ARRAYS; i++)
+        {
+            units[i] = firstUnit + i;
+            if (i < arrays.size())
+                glState().BindTexture(firstUnit + i, GL_TEXTURE_2D_ARRAY, arrays[i].id);
+        }
+        glState().UseProgram(program);
+        GLint location = glGetUniformLocation(program, "materialArrays");
+        if (location >= 0)
+            glUniform1iv(location, MAX_ARRAYS, units);
+    }
+
+    size_t ArrayCount() const
+    {
+        return arrays.size();
+    }
+
+private:
+    struct PendingTexture {
+        int width = 0, height = 0;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct Material {
+        int diffuse;
+        int specular;
+        float shininess;
+    };
+
+    struct TextureArray {
+        unsigned int id = 0;
+        int width = 0, height = 0;
+        std::vector<int> layers; // texture indices in layer order
+    };
+
+    bool bindless;
+    bool dirty = false;
+    bool texturesUploaded = false;
+    std::vector<PendingTexture> textures;
+    std::vector<Material> materials;
+    std::vector<MaterialTextureRef> placements;
+    std::vector<TextureArray> arrays;
+    std::vector<unsigned int> singleTextures;
+    unsigned int materialBuffer = 0;
+
+    static int mipLevels(int width, int height)
+    {
+        int levels = 1;
+        while ((width | height) >> levels)
+            levels++;
+        return levels;
+    }
+
+    static void setSamplerParameters(GLenum target)
+    {
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    void uploadBindless()
+    {
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            const PendingTexture& texture = textures[i];
+            unsigned int id;
+            glGenTextures(1, &id);
+            glState().BindTexture(0, GL_TEXTURE_2D, id);
+            glTexStorage2D(GL_TEXTURE_2D, mipLevels(texture.width, texture.height), GL_RGBA8, texture.width, texture.height);
+            gpuMemory().TrackTexture(id, GL_RGBA8, texture.width, texture.height, 1, mipLevels(texture.width, texture.height),
+                                     GPU_MEMORY_TEXTURE, "material textures", GPU_MEMORY_SITE);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture.width, texture.height, GL_RGBA, GL_UNSIGNED_BYTE, texture.pixels.data());
+            glGenerateMipmap(GL_TEXTURE_2D);
+            setSamplerParameters(GL_TEXTURE_2D);
+
+            // a texture can't be modified once it has a handle, so this comes last
+            GLuint64 handle = glGetTextureHandleARB(id);
+            glMakeTextureHandleResidentARB(handle);
+            singleTextures.push_back(id);
+            placements[i].handle = handle;
+            placements[i].index = static_cast<int>(i);
+        }
+    }
+
+    void uploadArrays()
+    {
+        // group by size; each group becomes one array
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            const PendingTexture& texture = textures[i];
+            TextureArray* target = nullptr;
+            for (TextureArray& array : arrays)
+                if (array.width == texture.width && array.height == texture.height)
+                    target = &array;
+            if (!target)
+            {
+                if (arrays.size() == MAX_ARRAYS)
+                {
+                    std::cout << "ERROR::MATERIAL_TEXTURES: more than " << MAX_ARRAYS
+                              << " distinct texture sizes, texture " << i << " skipped" << std::endl;
+                    continue;
+                }
+                arrays.push_back(TextureArray());
+                target = &arrays.back();
+                target->width = texture.width;
+                target->height = texture.height;
+            }
+            placements[i].array = static_cast<int>(target - arrays.data());
+            placements[i].layer = static_cast<int>(target->layers.size());
+            placements[i].index = static_cast<int>(i);
+            target->layers.push_back(static_cast<int>(i));
+        }
+
+        for (TextureArray& array : arrays)
+        {
+            glGenTextures(1, &array.id);
+            glState().BindTexture(0, GL_TEXTURE_2D_ARRAY, array.id);
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, mipLevels(array.width, array.height), GL_RGBA8,
+                           array.width, array.height, static_cast<GLsizei>(array.layers.size()));
+            gpuMemory().TrackTexture(array.id, GL_RGBA8, array.width, array.height, static_cast<int>(array.layers.size()),
+                                     mipLevels(array.width, array.height), GPU_MEMORY_TEXTURE, "material texture array", GPU_MEMORY_SITE);
+            for (size_t layer = 0; layer < array.layers.size(); layer++)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer), array.width, array.height, 1,
+                                GL_RGBA, GL_UNSIGNED_BYTE, textures[array.layers[layer]].pixels.data());
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            setSamplerParameters(GL_TEXTURE_2D_ARRAY);
+        }
+    }
+
+    void release()
+    {
+        for (size_t i = 0; i < singleTextures.size(); i++)
+        {
+            if (placements.size() > i && placements[i].handle)
+                glMakeTextureHandleNonResidentARB(placements[i].handle);
+            glState().ForgetTexture(singleTextures[i]);
+        }
+        gpuMemory().Release(GPU_RESOURCE_TEXTURE, singleTextures.size(), singleTextures.data());
+        if (!singleTextures.empty())
+            glDeleteTextures(static_cast<GLsizei>(singleTextures.size()), singleTextures.data());
+        singleTextures.clear();
+
+        for (TextureArray& array : arrays)
+        {
+            glState().ForgetTexture(array.id);
+            gpuMemory().Release(GPU_RESOURCE_TEXTURE, array.id);
+            glDeleteTextures(1, &array.id);
+        }
+        arrays.clear();
+
+        if (materialBuffer)
+        {
+            glState().ForgetBuffer(materialBuffer);
+            gpuMemory().Release(GPU_RESOURCE_BUFFER, materialBuffer);
+            glDeleteBuffers(1, &materialBuffer);
+            materialBuffer = 0;
+        }
+    }
+};
+#endif
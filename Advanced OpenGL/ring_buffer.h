@@ -0,0 +1,222 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "state_cache.h"
+#include "gpu_memory.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// a piece of this frame's region: write through data, draw from buffer at offset
+struct RingAllocation {
+    void* data = nullptr;
+    unsigned int buffer = 0;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+
+    bool Valid() const
+    {
+        return size > 0;
+    }
+};
+
+struct RingBufferStats {
+    // BeginFrame calls that had to wait for the GPU, and how long they waited in total
+    unsigned int stalls = 0;
+    double stallMilliseconds = 0.0;
+    // allocations that didn't fit in a frame's region
+    unsigned int overflows = 0;
+    GLsizeiptr frameBytes = 0;
+    GLsizeiptr peakFrameBytes = 0;
+};
+
+/*  StreamRingBuffer is for data that is rewritten every frame: instance transforms, uniform
+    blocks, dynamic vertices. One buffer is created with glBufferStorage and mapped once, for good,
+    with GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT, and split into FRAMES regions. Each frame
+    writes into its own region while the GPU may still be reading the previous ones; a fence at
+    the end of every frame tells us when a region is free to be reused.
+
+    Usage per frame:
+
+        ring.BeginFrame();                       // waits only if the GPU is FRAMES frames behind
+        RingAllocation transforms = ring.Write(models.data(), models.size() * sizeof(glm::mat4));
+        ring.BindRange(transforms, 1);           // or use transforms.offset as a vertex offset
+        ... draws ...
+        ring.EndFrame();
+
+    Without ARB_buffer_storage (GL < 4.4) nothing can be mapped persistently: Write still works
+    through glBufferSubData, but Allocate returns allocations without a data pointer. */
+class StreamRingBuffer {
+public:
+    static const unsigned int FRAMES = 3;
+
+    RingBufferStats stats;
+
+    StreamRingBuffer(GLenum target, GLsizeiptr bytesPerFrame)
+        : target(target)
+    {
+        GLint alignment = 16;
+        if (target == GL_UNIFORM_BUFFER)
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        else if (target == GL_SHADER_STORAGE_BUFFER)
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        defaultAlignment = alignment;
+        regionSize = alignUp(bytesPerFrame, defaultAlignment);
+
+        glGenBuffers(1, &buffer);
+        glState().BindBuffer(target, buffer);
+        persistent = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, regionSize * FRAMES, nullptr, flags);
+            mapped = static_cast<char*>(glMapBufferRange(target, 0, regionSize * FRAMES, flags));
+            if (!mapped)
+            {
+                std::cout << "ERROR::RING_BUFFER: persistent mapping failed" << std::endl;
+                persistent = false;
+            }
+        }
+        if (!persistent)
+            glBufferData(target, regionSize * FRAMES, nullptr, GL_DYNAMIC_DRAW);
+        gpuMemory().TrackBuffer(buffer, static_cast<size_t>(regionSize * FRAMES), GPU_MEMORY_STREAMING, "ring buffer", GPU_MEMORY_SITE);
+
+        for (GLsync& fence : fences)
+            fence = 0;
+    }
+
+    ~StreamRingBuffer()
+    {
+        for (GLsync fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+        if (mapped)
+        {
+            glState().BindBuffer(target, buffer);
+            glUnmapBuffer(target);
+        }
+        glState().ForgetBuffer(buffer);
+        gpuMemory().Release(GPU_RESOURCE_BUFFER, buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    StreamRingBuffer(const StreamRingBuffer&) = delete;
+    StreamRingBuffer& operator=(const StreamRingBuffer&) = delete;
+
+    // move on to the next region, waiting for the GPU to finish with it if it hasn't yet
+    void BeginFrame()
+    {
+        region = (region + 1) % FRAMES;
+        head = 0;
+        stats.frameBytes = 0;
+
+        GLsync& fence = fences[region];
+        if (!fence)
+            return;
+
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            // the GPU is more than FRAMES frames behind: this is a real stall
+            auto start = std::chrono::high_resolution_clock::now();
+            do
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            while (status == GL_TIMEOUT_EXPIRED);
+            auto end = std::chrono::high_resolution_clock::now();
+            stats.stalls++;
+            stats.stallMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    // reserve size bytes in this frame's region; alignment 0 uses the target's offset alignment
+    RingAllocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 0)
+    {
+        RingAllocation allocation;
+        GLsizeiptr start = alignUp(head, alignment ? alignment : defaultAlignment);
+        if (start + size > regionSize)
+        {
+            if (stats.overflows++ == 0)
+                std::cout << "ERROR::RING_BUFFER: frame region of " << regionSize << " bytes is too small" << std::endl;
+            return allocation;
+        }
+        head = start + size;
+        stats.frameBytes = head;
+        if (stats.frameBytes > stats.peakFrameBytes)
+            stats.peakFrameBytes = stats.frameBytes;
+
+        allocation.buffer = buffer;
+        allocation.offset = region * regionSize + start;
+        allocation.size = size;
+        if (mapped)
+            allocation.data = mapped + allocation.offset;
+        return allocation;
+    }
+
+    // allocate and copy in one go
+    RingAllocation Write(const void* data, GLsizeiptr size, GLsizeiptr alignment = 0)
+    {
+        RingAllocation allocation = Allocate(size, alignment);
+        if (!allocation.Valid())
+            return allocation;
+        if (allocation.data)
+            std::memcpy(allocation.data, data, size);
+        else
+        {
+            // the region is fenced, so the driver never has to wait on this upload
+            glState().BindBuffer(target, buffer);
+            glBufferSubData(target, allocation.offset, size, data);
+        }
+        return allocation;
+    }
+
+    template <typename T>
+    RingAllocation Write(const std::vector<T>& values, GLsizeiptr alignment = 0)
+    {
+        return Write(values.data(), values.size() * sizeof(T), alignment);
+    }
+
+    // bind an allocation to an indexed uniform/shader storage binding point
+    void BindRange(const RingAllocation& allocation, unsigned int index) const
+    {
+        glState().BindBufferRange(target, index, allocation.buffer, allocation.offset, allocation.size);
+    }
+
+    // fence the region used this frame; call after the frame's last draw that reads from it
+    void EndFrame()
+    {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    unsigned int Buffer() const
+    {
+        return buffer;
+    }
+
+    bool Persistent() const
+    {
+        return persistent;
+    }
+
+private:
+    GLenum target;
+    unsigned int buffer = 0;
+    char* mapped = nullptr;
+    bool persistent;
+    GLsizeiptr regionSize;
+    GLsizeiptr defaultAlignment;
+    unsigned int region = FRAMES - 1;
+    GLsizeiptr head = 0;
+    GLsync fences[FRAMES];
+
+    static GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+};
+#endif
@@ -0,0 +1,333 @@
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+// GL calls issued vs dropped because the state was already set
+struct GLStateCounters {
+    unsigned int issued = 0;
+    unsigned int filtered = 0;
+};
+
+/*  GLStateCache shadows the bits of GL state the renderer changes most often (program, vertex
+    array, buffer bindings, textures per unit, depth and blend state) and drops calls that would
+    set a value that is already current. Because nothing is reset after a draw any more, every
+    bind that goes to GL directly instead of through the cache must be followed by Invalidate(),
+    and anything deleted must be forgotten so a recycled name isn't mistaken for a cached one.
+
+    Keep in mind that the GL_ELEMENT_ARRAY_BUFFER binding belongs to the bound vertex array:
+    binding an index buffer while a mesh's VAO is still current changes that mesh. Bind vertex
+    array 0 through the cache before setting up unrelated buffers. */
+class GLStateCache {
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+    static const unsigned int MAX_INDEXED_BINDINGS = 16;
+
+    // counters for the current frame and since startup
+    GLStateCounters frame;
+    GLStateCounters total;
+
+    GLStateCache()
+    {
+        Invalidate();
+    }
+
+    // start a new frame's counters
+    void BeginFrame()
+    {
+        frame = GLStateCounters();
+    }
+
+    // forget everything; the next call of each kind is always issued
+    void Invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int& buffer : buffers)
+            buffer = UNKNOWN;
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (unsigned int& texture : textures[unit])
+                texture = UNKNOWN;
+        for (unsigned int target = 0; target < INDEXED_TARGET_COUNT; target++)
+            for (IndexedBinding& binding : indexed[target])
+                binding.buffer = UNKNOWN;
+        depthFunc = UNKNOWN;
+        depthMask = UNKNOWN;
+        blendSrc = blendDst = UNKNOWN;
+        for (unsigned int& capability : capabilities)
+            capability = UNKNOWN;
+    }
+
+    void UseProgram(unsigned int id)
+    {
+        if (filter(program == id))
+            return;
+        program = id;
+        glUseProgram(id);
+    }
+
+    void BindVertexArray(unsigned int id)
+    {
+        if (filter(vertexArray == id))
+            return;
+        vertexArray = id;
+        // the element buffer binding is part of the vertex array we just switched to
+        buffers[ELEMENT_ARRAY] = UNKNOWN;
+        glBindVertexArray(id);
+    }
+
+    void BindBuffer(GLenum target, unsigned int id)
+    {
+        int slot = bufferSlot(target);
+        if (slot < 0)
+        {
+            count(false);
+            glBindBuffer(target, id);
+            return;
+        }
+        if (filter(buffers[slot] == id))
+            return;
+        buffers[slot] = id;
+        glBindBuffer(target, id);
+    }
+
+    // glBindBufferRange for uniform/shader storage blocks; a size of 0 binds the whole buffer
+    void BindBufferRange(GLenum target, unsigned int index, unsigned int id, GLintptr offset = 0, GLsizeiptr size = 0)
+    {
+        int slot = indexedSlot(target);
+        if (slot < 0 || index >= MAX_INDEXED_BINDINGS)
+        {
+            count(false);
+            issueIndexed(target, index, id, offset, size);
+            return;
+        }
+        IndexedBinding& binding = indexed[slot][index];
+        if (filter(binding.buffer == id && binding.offset == offset && binding.size == size))
+            return;
+        binding.buffer = id;
+        binding.offset = offset;
+        binding.size = size;
+        // glBindBufferBase/Range also change the generic binding point
+        int generic = bufferSlot(target);
+        if (generic >= 0)
+            buffers[generic] = id;
+        issueIndexed(target, index, id, offset, size);
+    }
+
+    // select a texture unit by index (0 for GL_TEXTURE0)
+    void ActiveTexture(unsigned int unit)
+    {
+        if (filter(activeUnit == unit))
+            return;
+        activeUnit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // bind a texture to a unit, only switching the active unit if the binding actually changes
+    void BindTexture(unsigned int unit, GLenum target, unsigned int id)
+    {
+        int slot = textureSlot(target);
+        if (unit >= MAX_TEXTURE_UNITS || slot < 0)
+        {
+            count(false);
+            ActiveTexture(unit);
+            glBindTexture(target, id);
+            return;
+        }
+        if (filter(textures[unit][slot] == id))
+            return;
+        ActiveTexture(unit);
+        textures[unit][slot] = id;
+        glBindTexture(target, id);
+    }
+
+    void DepthFunc(GLenum func)
+    {
+        if (filter(depthFunc == func))
+            return;
+        depthFunc = func;
+        glDepthFunc(func);
+    }
+
+    void DepthMask(GLboolean flag)
+    {
+        if (filter(depthMask == flag))
+            return;
+        depthMask = flag;
+        glDepthMask(flag);
+    }
+
+    void BlendFunc(GLenum src, GLenum dst)
+    {
+        if (filter(blendSrc == src && blendDst == dst))
+            return;
+        blendSrc = src;
+        blendDst = dst;
+        glBlendFunc(src, dst);
+    }
+
+    // glEnable/glDisable for GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_STENCIL_TEST, GL_SCISSOR_TEST
+    void SetCapability(GLenum capability, bool enabled)
+    {
+        int slot = capabilitySlot(capability);
+        if (slot >= 0)
+        {
+            if (filter(capabilities[slot] == static_cast<unsigned int>(enabled)))
+                return;
+            capabilities[slot] = enabled;
+        }
+        else
+            count(false);
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    // call after deleting objects so a recycled name isn't treated as already bound
+    void ForgetProgram(unsigned int id)
+    {
+        if (program == id)
+            program = UNKNOWN;
+    }
+
+    void ForgetVertexArray(unsigned int id)
+    {
+        if (vertexArray == id)
+            vertexArray = UNKNOWN;
+    }
+
+    void ForgetBuffer(unsigned int id)
+    {
+        for (unsigned int& buffer : buffers)
+            if (buffer == id)
+                buffer = UNKNOWN;
+        for (unsigned int target = 0; target < INDEXED_TARGET_COUNT; target++)
+            for (IndexedBinding& binding : indexed[target])
+                if (binding.buffer == id)
+                    binding.buffer = UNKNOWN;
+    }
+
+    void ForgetTexture(unsigned int id)
+    {
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (unsigned int& texture : textures[unit])
+                if (texture == id)
+                    texture = UNKNOWN;
+    }
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+    enum BufferSlot { ARRAY, ELEMENT_ARRAY, UNIFORM, SHADER_STORAGE, DRAW_INDIRECT, PIXEL_UNPACK, PIXEL_PACK, COPY_READ, COPY_WRITE, BUFFER_TARGET_COUNT };
+    enum TextureSlot { TEXTURE_2D, TEXTURE_2D_ARRAY, TEXTURE_CUBE_MAP, TEXTURE_3D, TEXTURE_TARGET_COUNT };
+    enum IndexedSlot { INDEXED_UNIFORM, INDEXED_SHADER_STORAGE, INDEXED_TARGET_COUNT };
+    enum CapabilitySlot { DEPTH_TEST, BLEND, CULL_FACE, STENCIL_TEST, SCISSOR_TEST, CAPABILITY_COUNT };
+
+    struct IndexedBinding {
+        unsigned int buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int buffers[BUFFER_TARGET_COUNT];
+    unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+    IndexedBinding indexed[INDEXED_TARGET_COUNT][MAX_INDEXED_BINDINGS];
+    unsigned int depthFunc;
+    unsigned int depthMask;
+    unsigned int blendSrc, blendDst;
+    unsigned int capabilities[CAPABILITY_COUNT];
+
+    // update the counters; returns true when the call can be dropped
+    bool filter(bool redundant)
+    {
+        count(redundant);
+        return redundant;
+    }
+
+    void count(bool redundant)
+    {
+        if (redundant)
+        {
+            frame.filtered++;
+            total.filtered++;
+        }
+        else
+        {
+            frame.issued++;
+            total.issued++;
+        }
+    }
+
+    static void issueIndexed(GLenum target, unsigned int index, unsigned int id, GLintptr offset, GLsizeiptr size)
+    {
+        if (size == 0)
+            glBindBufferBase(target, index, id);
+        else
+            glBindBufferRange(target, index, id, offset, size);
+    }
+
+    static int bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER:          return ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER:  return ELEMENT_ARRAY;
+        case GL_UNIFORM_BUFFER:        return UNIFORM;
+        case GL_SHADER_STORAGE_BUFFER: return SHADER_STORAGE;
+        case GL_DRAW_INDIRECT_BUFFER:  return DRAW_INDIRECT;
+        case GL_PIXEL_UNPACK_BUFFER:   return PIXEL_UNPACK;
+        case GL_PIXEL_PACK_BUFFER:     return PIXEL_PACK;
+        case GL_COPY_READ_BUFFER:      return COPY_READ;
+        case GL_COPY_WRITE_BUFFER:     return COPY_WRITE;
+        default:                       return -1;
+        }
+    }
+
+    static int indexedSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_UNIFORM_BUFFER:        return INDEXED_UNIFORM;
+        case GL_SHADER_STORAGE_BUFFER: return INDEXED_SHADER_STORAGE;
+        default:                       return -1;
+        }
+    }
+
+    static int textureSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D:       return TEXTURE_2D;
+        case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+        case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+        case GL_TEXTURE_3D:       return TEXTURE_3D;
+        default:                  return -1;
+        }
+    }
+
+    static int capabilitySlot(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_DEPTH_TEST:   return DEPTH_TEST;
+        case GL_BLEND:        return BLEND;
+        case GL_CULL_FACE:    return CULL_FACE;
+        case GL_STENCIL_TEST: return STENCIL_TEST;
+        case GL_SCISSOR_TEST: return SCISSOR_TEST;
+        default:              return -1;
+        }
+    }
+};
+
+// the cache for the current GL context; everything in this repo shares one context
+inline GLStateCache& glState()
+{
+    static GLStateCache cache;
+    return cache;
+}
+#endif
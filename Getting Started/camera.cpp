@@ -294,3 +294,34 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 		glfwSetScrollCallback(window, scroll_callback);
 	
 */
+
+/*									Doing Less Work
+
+	The callbacks above do more work than they need to. GLFW can report several mouse events in a
+	single frame and each one recomputes cameraFront with four trig calls, yet only the last result
+	is ever used. The render loop also calls glm::lookAt and glm::perspective every frame, even
+	when the camera hasn't moved at all.
+
+	camera.h fixes both. ProcessMouseMovement only adds the offsets to a running total, and
+	Update(), called once per frame, turns the total into a quaternion orientation:
+
+		glm::quat yawRotation = glm::angleAxis(glm::radians(-(Yaw + 90.0f)), WorldUp);
+		glm::quat pitchRotation = glm::angleAxis(glm::radians(Pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+		Orientation = glm::normalize(yawRotation * pitchRotation);
+		Front = Orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+
+	The view, projection and view-projection matrices and the frustum planes (frustum.h) are
+	cached and only rebuilt after something changed them. Version() goes up by one in every frame
+	where the camera moved, so code that depends on the camera, such as culling, can remember the
+	version it last ran against and skip the work while the camera stands still:
+
+		processInput(window);
+		camera.Update();
+		if (camera.Version() != culledVersion)
+		{
+			cullScene(camera.GetFrustum());
+			culledVersion = camera.Version();
+		}
+		lightingShader.setMat4("projection", camera.GetProjectionMatrix());
+		lightingShader.setMat4("view", camera.GetViewMatrix());
+*/
@@ -0,0 +1,218 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "frustum.h"
+
+// Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
+enum Camera_Movement {
+    FORWARD,
+    BACKWARD,
+    LEFT,
+    RIGHT
+};
+
+// Default camera values
+const float YAW         = -90.0f;
+const float PITCH       =  0.0f;
+const float SPEED       =  2.5f;
+const float SENSITIVITY =  0.1f;
+const float ZOOM        =  45.0f;
+
+/*  A camera that only does work when something changed. Mouse events are summed up as they
+    arrive and turned into a new orientation once per frame in Update, so a burst of events costs
+    one quaternion rebuild instead of four trig calls each. The view, projection, view-projection
+    matrices and the frustum planes are cached behind dirty flags, and Version() changes only in
+    frames where the camera actually moved, so culling or light clustering can compare it with the
+    version they last ran against and skip their work for a static camera.
+
+    Call Update() once per frame after input has been processed and before the matrices are used. */
+class Camera
+{
+public:
+    // camera Attributes
+    glm::vec3 Position;
+    glm::vec3 Front;
+    glm::vec3 Up;
+    glm::vec3 Right;
+    glm::vec3 WorldUp;
+    // orientation; Yaw and Pitch are kept for clamping, Orientation is what the vectors come from
+    glm::quat Orientation;
+    float Yaw;
+    float Pitch;
+    // camera options
+    float MovementSpeed;
+    float MouseSensitivity;
+    float Zoom;
+    // projection
+    float AspectRatio;
+    float NearPlane;
+    float FarPlane;
+
+    // constructor with vectors
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH)
+        : MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), AspectRatio(800.0f / 600.0f), NearPlane(0.1f), FarPlane(100.0f)
+    {
+        Position = position;
+        WorldUp = up;
+        Yaw = yaw;
+        Pitch = pitch;
+        updateOrientation();
+        dirty = VIEW_DIRTY | PROJECTION_DIRTY;
+    }
+
+    // apply the input gathered since the last call and refresh what changed; once per frame
+    void Update()
+    {
+        if (pendingX != 0.0f || pendingY != 0.0f)
+        {
+            Yaw   += pendingX;
+            Pitch += pendingY;
+            pendingX = pendingY = 0.0f;
+
+            // make sure that when pitch is out of bounds, screen doesn't get flipped
+            if (Pitch > 89.0f)
+                Pitch = 89.0f;
+            if (Pitch < -89.0f)
+                Pitch = -89.0f;
+
+            updateOrientation();
+            dirty |= VIEW_DIRTY;
+            changed = true;
+        }
+
+        rebuild();
+        if (changed)
+        {
+            version++;
+            changed = false;
+        }
+    }
+
+    // the cached matrices; rebuilt on first use after a change
+    const glm::mat4& GetViewMatrix()
+    {
+        rebuild();
+        return view;
+    }
+
+    const glm::mat4& GetProjectionMatrix()
+    {
+        rebuild();
+        return projection;
+    }
+
+    const glm::mat4& GetViewProjectionMatrix()
+    {
+        rebuild();
+        return viewProjection;
+    }
+
+    const Frustum& GetFrustum()
+    {
+        rebuild();
+        return frustum;
+    }
+
+    // increases by one in every Update that changed the camera
+    unsigned int Version() const
+    {
+        return version;
+    }
+
+    void SetAspectRatio(float aspectRatio)
+    {
+        if (aspectRatio == AspectRatio)
+            return;
+        AspectRatio = aspectRatio;
+        dirty |= PROJECTION_DIRTY;
+        changed = true;
+    }
+
+    // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
+    void ProcessKeyboard(Camera_Movement direction, float deltaTime)
+    {
+        float velocity = MovementSpeed * deltaTime;
+        if (direction == FORWARD)
+            Position += Front * velocity;
+        if (direction == BACKWARD)
+            Position -= Front * velocity;
+        if (direction == LEFT)
+            Position -= Right * velocity;
+        if (direction == RIGHT)
+            Position += Right * velocity;
+        dirty |= VIEW_DIRTY;
+        changed = true;
+    }
+
+    // processes input received from a mouse input system; only accumulates, Update applies it
+    void ProcessMouseMovement(float xoffset, float yoffset)
+    {
+        pendingX += xoffset * MouseSensitivity;
+        pendingY += yoffset * MouseSensitivity;
+    }
+
+    // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
+    void ProcessMouseScroll(float yoffset)
+    {
+        Zoom -= (float)yoffset;
+        if (Zoom < 1.0f)
+            Zoom = 1.0f;
+        if (Zoom > 45.0f)
+            Zoom = 45.0f;
+        dirty |= PROJECTION_DIRTY;
+        changed = true;
+    }
+
+private:
+    enum DirtyFlags {
+        VIEW_DIRTY       = 1 << 0,
+        PROJECTION_DIRTY = 1 << 1
+    };
+
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    Frustum frustum;
+    unsigned int dirty = 0;
+    // set by anything that moves the camera, cleared by Update
+    bool changed = true;
+    unsigned int version = 0;
+    float pendingX = 0.0f;
+    float pendingY = 0.0f;
+
+    // yaw turns around the world up axis, pitch around the camera's own right axis;
+    // a yaw of -90 degrees looks down -z like the Euler angle version did
+    void updateOrientation()
+    {
+        glm::quat yawRotation = glm::angleAxis(glm::radians(-(Yaw + 90.0f)), WorldUp);
+        glm::quat pitchRotation = glm::angleAxis(glm::radians(Pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+        Orientation = glm::normalize(yawRotation * pitchRotation);
+
+        Front = Orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+        Right = Orientation * glm::vec3(1.0f, 0.0f, 0.0f);
+        Up    = Orientation * glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    // recompute whatever is dirty; the view comes straight from the orientation, no lookAt needed
+    void rebuild()
+    {
+        if (!dirty)
+            return;
+        if (dirty & VIEW_DIRTY)
+        {
+            glm::mat3 rotation = glm::transpose(glm::mat3_cast(Orientation));
+            view = glm::mat4(rotation);
+            view[3] = glm::vec4(-(rotation * Position), 1.0f);
+        }
+        if (dirty & PROJECTION_DIRTY)
+            projection = glm::perspective(glm::radians(Zoom), AspectRatio, NearPlane, FarPlane);
+        viewProjection = projection * view;
+        frustum = Frustum(viewProjection);
+        dirty = 0;
+    }
+};
+#endif
@@ -0,0 +1,328 @@
+#ifndef GLSL_PREPROCESSOR_H
+#define GLSL_PREPROCESSOR_H
+
+#include "program_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// the result of expanding one shader: flattened source plus what it was built from
+struct ExpandedSource {
+    std::string text;
+    // content hash of text, so identical expansions share program cache entries
+    std::uint64_t hash = 0;
+    // source-string numbers used in the #line directives; files[0] is the root shader
+    std::vector<std::string> files;
+    // content hash of each file at the time of expansion, parallel to files
+    std::vector<std::uint64_t> fileHashes;
+};
+
+/*  GLSL has no #include, so every lighting shader ends up with its own copy of calcDirLight,
+    calcPointLight and the attenuation code. GLSLPreprocessor expands
+
+        #include "lighting.glsl"    (relative to the including file, then the include directories)
+        #include <lighting.glsl>    (include directories only)
+
+    honours #pragma once, injects a block of #defines after #version and emits #line directives
+    so the driver's error messages can be mapped back to the original file and line with
+    TranslateLog. Expansions are cached per (file, defines) and remember which files they read;
+    Invalidate(file) drops exactly the expansions that depended on a changed file and tells the
+    caller which root shaders need rebuilding. */
+class GLSLPreprocessor {
+public:
+    // expansions served from the cache vs expanded from disk
+    unsigned int cacheHits = 0;
+    unsigned int cacheMisses = 0;
+
+    void AddIncludeDirectory(const std::string& directory)
+    {
+        includeDirectories.push_back(normalize(directory));
+    }
+
+    // expand a shader file, reusing the cached expansion when none of its files changed
+    const ExpandedSource& Expand(const std::string& path, const std::string& defines = "")
+    {
+        std::string root = normalize(path);
+        std::string key = root + '\n' + defines;
+        auto cached = expanded.find(key);
+        if (cached != expanded.end())
+        {
+            cacheHits++;
+            return cached->second;
+        }
+        cacheMisses++;
+
+        ExpandedSource source;
+        std::ostringstream out;
+        std::set<std::string> includedOnce;
+        std::vector<std::string> stack;
+        expandFile(root, defines, out, source, includedOnce, stack);
+        source.text = out.str();
+        source.hash = hashString(source.text);
+
+        for (const std::string& file : source.files)
+            dependents[file].insert(key);
+        return expanded[key] = std::move(source);
+    }
+
+    // forget a changed file and every expansion that included it; returns the root shader paths
+    // that have to be re-expanded (and their programs rebuilt)
+    std::vector<std::string> Invalidate(const std::string& changedFile)
+    {
+        std::string file = normalize(changedFile);
+        files.erase(file);
+        missing.erase(file);
+
+        std::set<std::string> roots;
+        auto it = dependents.find(file);
+        if (it == dependents.end())
+            return {};
+        std::set<std::string> keys = std::move(it->second);
+        dependents.erase(it);
+        for (const std::string& key : keys)
+        {
+            auto entry = expanded.find(key);
+            if (entry == expanded.end())
+                continue;
+            roots.insert(entry->second.files[0]);
+            for (const std::string& dependency : entry->second.files)
+                if (dependency != file)
+                    dependents[dependency].erase(key);
+            expanded.erase(entry);
+        }
+        return std::vector<std::string>(roots.begin(), roots.end());
+    }
+
+    // re-read every file seen so far and invalidate the ones whose contents changed; for use
+    // without a file watcher. Returns the affected root shader paths.
+    std::vector<std::string> Refresh()
+    {
+        std::vector<std::string> changed;
+        for (const auto& entry : files)
+        {
+            std::string text;
+            if (!readText(entry.first, text) || hashString(text) != entry.second.hash)
+                changed.push_back(entry.first);
+        }
+        for (const std::string& file : missing)
+            if (std::filesystem::exists(file))
+                changed.push_back(file);
+
+        std::set<std::string> roots;
+        for (const std::string& file : changed)
+            for (const std::string& root : Invalidate(file))
+                roots.insert(root);
+        return std::vector<std::string>(roots.begin(), roots.end());
+    }
+
+    // rewrite "0(12)" / "0:12" locations in a driver info log to "file:line"
+    std::string TranslateLog(const ExpandedSource& source, const std::string& log) const
+    {
+        static const std::regex location(R"(^(\s*(?:ERROR|WARNING)?:?\s*)(\d+)(?::|\()(\d+)\)?)");
+        std::istringstream lines(log);
+        std::ostringstream out;
+        std::string line;
+        std::smatch match;
+        while (std::getline(lines, line))
+        {
+            if (std::regex_search(line, match, location))
+            {
+                size_t index = std::stoul(match[2].str());
+                if (index < source.files.size())
+                    line = match[1].str() + source.files[index] + ":" + match[3].str() + match.suffix().str();
+            }
+            out << line << "\n";
+        }
+        return out.str();
+    }
+
+private:
+    struct FileEntry {
+        std::string text;
+        std::uint64_t hash;
+    };
+
+    std::vector<std::string> includeDirectories;
+    std::unordered_map<std::string, FileEntry> files;
+    std::unordered_map<std::string, ExpandedSource> expanded;
+    // file -> keys of the expansions that read it (or tried to)
+    std::unordered_map<std::string, std::set<std::string>> dependents;
+    // files an expansion needed but couldn't read
+    std::set<std::string> missing;
+
+    static std::string normalize(const std::string& path)
+    {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+    static bool readText(const std::string& path, std::string& text)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        text = contents.str();
+        return true;
+    }
+
+    const FileEntry* readFile(const std::string& path)
+    {
+        auto it = files.find(path);
+        if (it != files.end())
+            return &it->second;
+
+        std::string text;
+        if (!readText(path, text))
+            return nullptr;
+        FileEntry& entry = files[path];
+        entry.hash = hashString(text);
+        entry.text = std::move(text);
+        return &entry;
+    }
+
+    std::string resolve(const std::string& name, const std::string& includingFile, bool quoted) const
+    {
+        if (quoted)
+        {
+            std::string local = normalize((std::filesystem::path(includingFile).parent_path() / name).string());
+            if (std::filesystem::exists(local))
+                return local;
+        }
+        for (const std::string& directory : includeDirectories)
+        {
+            std::string candidate = normalize((std::filesystem::path(directory) / name).string());
+            if (std::filesystem::exists(candidate))
+                return candidate;
+        }
+        return "";
+    }
+
+    // where an include that resolve() can't find is expected to appear
+    std::string expectedPath(const std::string& name, const std::string& includingFile, bool quoted) const
+    {
+        if (quoted || includeDirectories.empty())
+            return normalize((std::filesystem::path(includingFile).parent_path() / name).string());
+        return normalize((std::filesystem::path(includeDirectories[0]) / name).string());
+    }
+
+    void recordMissing(ExpandedSource& source, const std::string& path)
+    {
+        sourceIndex(source, path, 0);
+        missing.insert(path);
+    }
+
+    int sourceIndex(ExpandedSource& source, const std::string& path, std::uint64_t hash)
+    {
+        for (size_t i = 0; i < source.files.size(); i++)
+            if (source.files[i] == path)
+                return static_cast<int>(i);
+        source.files.push_back(path);
+        source.fileHashes.push_back(hash);
+        return static_cast<int>(source.files.size() - 1);
+    }
+
+    void expandFile(const std::string& path, const std::string& defines, std::ostringstream& out, ExpandedSource& source,
+                    std::set<std::string>& includedOnce, std::vector<std::string>& stack)
+    {
+        const FileEntry* file = readFile(path);
+        if (!file)
+        {
+            std::cout << "ERROR::GLSL_PREPROCESSOR: could not read " << path << std::endl;
+            out << "#error could not read \"" << path << "\"\n";
+            recordMissing(source, path);
+            return;
+        }
+        // the entry pointer can move when included files are added to the map
+        std::string text = file->text;
+        int index = sourceIndex(source, path, file->hash);
+        bool root = stack.empty();
+        stack.push_back(path);
+
+        std::istringstream lines(text);
+        std::string line;
+        int lineNumber = 0;
+        bool sawVersion = false;
+        if (!root)
+            out << "#line 1 " << index << "\n";
+        while (std::getline(lines, line))
+        {
+            lineNumber++;
+            size_t first = line.find_first_not_of(" \t");
+            if (first == std::string::npos || line[first] != '#')
+            {
+                out << line << "\n";
+                continue;
+            }
+
+            std::istringstream words(line.substr(first + 1));
+            std::string directive, argument;
+            words >> directive >> argument;
+            if (directive == "version")
+            {
+                // only the root file may set the version; defines go right after it
+                if (root && !sawVersion)
+                {
+                    out << line << "\n" << defines << "#line " << lineNumber + 1 << " " << index << "\n";
+                    sawVersion = true;
+                }
+                else
+                    out << "\n";
+            }
+            else if (directive == "pragma" && argument == "once")
+            {
+                includedOnce.insert(path);
+                out << "\n";
+            }
+            else if (directive == "include")
+            {
+                size_t open = line.find_first_of("\"<", first);
+                size_t close = open == std::string::npos ? open : line.find_first_of("\">", open + 1);
+                std::string name = close == std::string::npos ? "" : line.substr(open + 1, close - open - 1);
+                std::string target = name.empty() ? "" : resolve(name, path, line[open] == '"');
+                if (target.empty())
+                {
+                    std::cout << "ERROR::GLSL_PREPROCESSOR: " << path << ":" << lineNumber
+                              << ": cannot find include " << (name.empty() ? line : name) << std::endl;
+                    out << "#error cannot find include \"" << name << "\"\n";
+                    // creating the file later has to rebuild this expansion
+                    if (!name.empty())
+                        recordMissing(source, expectedPath(name, path, line[open] == '"'));
+                }
+                else if (std::find(stack.begin(), stack.end(), target) != stack.end())
+                {
+                    std::cout << "ERROR::GLSL_PREPROCESSOR: " << path << ":" << lineNumber
+                              << ": recursive include of " << target << std::endl;
+                    out << "#error recursive include \"" << name << "\"\n";
+                }
+                else if (!includedOnce.count(target))
+                {
+                    expandFile(target, defines, out, source, includedOnce, stack);
+                    out << "#line " << lineNumber + 1 << " " << index << "\n";
+                }
+                else
+                    out << "\n";
+            }
+            else
+                out << line << "\n";
+        }
+        // a root file without #version still gets its defines
+        if (root && !sawVersion && !defines.empty())
+        {
+            std::string body = out.str();
+            out.str("");
+            out << defines << "#line 1 " << index << "\n" << body;
+        }
+        stack.pop_back();
+    }
+};
+#endif
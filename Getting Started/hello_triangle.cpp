@@ -90,7 +90,26 @@ int main()
 //	Clean up shaders
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
-	
+
+/*	Program Binary Cache
+
+	Everything above runs on every launch, and the driver's GLSL compiler is slow. Once a program
+	is linked we can ask for its binary with glGetProgramBinary, store it on disk, and hand it
+	back to glProgramBinary on the next run. program_cache.h does this: entries are keyed on a hash
+	of the sources, any injected defines and the driver string, and if the driver rejects a stored
+	binary it simply compiles from source again. It also records how long each program took and
+	whether it came from the cache:
+
+			#include "program_cache.h"
+
+			ProgramCache programCache("shader_cache");
+			unsigned int shaderProgram = programCache.GetProgram("hello_triangle", {
+				{ GL_VERTEX_SHADER, vertexShaderSource },
+				{ GL_FRAGMENT_SHADER, fragmentShaderSource }
+			});
+			programCache.PrintTimings(std::cout);
+*/
+
 //	Define the triangle's coordinates in normalized device coordinates using a float array
 //	Each vertex has a z coordinate of 0 to make it look like it is 2D
 	float vertices[] = {
@@ -167,6 +186,25 @@ int main()
 
 //	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE)
 
+/*	Streaming Data
+
+	The triangle never changes, so GL_STATIC_DRAW is the right hint. Data that is rewritten every
+	frame (instance transforms, uniform blocks, animated vertices) is different: updating a buffer
+	with glBufferSubData while the GPU may still be drawing from it forces the driver to wait or to
+	make a hidden copy. ring_buffer.h maps one buffer permanently (GL_MAP_PERSISTENT_BIT and
+	GL_MAP_COHERENT_BIT) and splits it into three regions, one per frame in flight. Each frame
+	writes into its own region and puts a glFenceSync behind it, so the CPU only waits when the GPU
+	has fallen three frames behind, and stats.stalls counts how often that happens:
+
+			StreamRingBuffer instances(GL_ARRAY_BUFFER, 1024 * 1024);
+			...
+			instances.BeginFrame();
+			RingAllocation transforms = instances.Write(models);
+			glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)transforms.offset);
+			...
+			instances.EndFrame();
+*/
+
 	
     while (!glfwWindowShouldClose(window))
     {
@@ -0,0 +1,357 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// one stage of a program: its type (GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, ...) and GLSL source
+struct ShaderStage {
+    GLenum type;
+    std::string source;
+};
+
+// how long a single program request took and whether it was served from disk
+struct ProgramTiming {
+    std::string name;
+    bool cacheHit;
+    double milliseconds;
+};
+
+// 64-bit FNV-1a; pass the previous result as seed to hash several pieces in sequence
+inline std::uint64_t hashBytes(const void* data, size_t size, std::uint64_t seed = 14695981039346656037ull)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline std::uint64_t hashString(const std::string& text, std::uint64_t seed = 14695981039346656037ull)
+{
+    return hashBytes(text.data(), text.size(), seed);
+}
+
+// insert a block of #define lines right after the #version directive (or at the top if there is none)
+inline std::string injectDefines(const std::string& source, const std::string& defines)
+{
+    if (defines.empty())
+        return source;
+    size_t version = source.find("#version");
+    if (version == std::string::npos)
+        return defines + source;
+    size_t lineEnd = source.find('\n', version);
+    if (lineEnd == std::string::npos)
+        return source + "\n" + defines;
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+// a program whose compile and link have been issued but not yet checked
+struct PendingProgram {
+    std::string name;
+    unsigned int program = 0;
+    std::vector<unsigned int> shaders;
+    std::chrono::high_resolution_clock::time_point start;
+};
+
+/*  ProgramCache keeps linked program binaries on disk so later runs can skip the driver's GLSL
+    compiler entirely. A cache entry is keyed on the shader sources, the injected defines and the
+    driver string (vendor, renderer and version): a driver update changes the key, and a binary
+    the driver still rejects through glProgramBinary falls back to a normal compile. */
+class ProgramCache {
+public:
+    // one entry per GetProgram call, in request order
+    std::vector<ProgramTiming> timings;
+
+    // constructor
+    ProgramCache(const std::string& directory)
+        : directory(directory)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0;
+
+        // let the driver pick its own number of compiler threads
+        parallelCompile = GLAD_GL_KHR_parallel_shader_compile != 0;
+        if (parallelCompile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+        driver = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+    }
+
+    // return a linked program for the given stages, loading it from disk when possible
+    unsigned int GetProgram(const std::string& name, const std::vector<ShaderStage>& stages, const std::string& defines = "")
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::uint64_t key = MakeKey(stages, defines);
+        unsigned int program = Load(key);
+        bool hit = program != 0;
+        if (!hit)
+        {
+            program = Compile(name, stages, defines);
+            if (program != 0)
+                Store(key, program);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        timings.push_back({ name, hit, std::chrono::duration<double, std::milli>(end - start).count() });
+        return program;
+    }
+
+    // cache key for a set of stages and defines on the current driver
+    std::uint64_t MakeKey(const std::vector<ShaderStage>& stages, const std::string& defines) const
+    {
+        std::uint64_t key = hashString(driver);
+        key = hashString(defines, key);
+        for (const ShaderStage& stage : stages)
+        {
+            key = hashBytes(&stage.type, sizeof(stage.type), key);
+            key = hashString(stage.source, key);
+        }
+        return key;
+    }
+
+    // create a program from a stored binary; returns 0 on a miss or when the driver rejects the binary
+    unsigned int Load(std::uint64_t key)
+    {
+        if (!supported)
+            return 0;
+
+        std::ifstream file(entryPath(key), std::ios::binary);
+        if (!file)
+            return 0;
+        std::error_code error;
+        std::uintmax_t fileSize = std::filesystem::file_size(entryPath(key), error);
+        if (error)
+            return 0;
+
+        EntryHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            header.magic != kMagic || header.key != key)
+            return 0;
+        // a truncated or damaged entry; don't allocate what the file can't hold
+        if (header.length > fileSize - sizeof(header))
+            return 0;
+
+        std::vector<char> binary(header.length);
+        if (!file.read(binary.data(), binary.size()))
+            return 0;
+
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            // stale binary (driver update the key didn't catch); drop it and compile instead
+            glDeleteProgram(program);
+            std::filesystem::remove(entryPath(key), error);
+            return 0;
+        }
+        return program;
+    }
+
+    // write the binary of a linked program to disk under the given key
+    void Store(std::uint64_t key, unsigned int program)
+    {
+        if (!supported)
+            return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        EntryHeader header;
+        header.magic = kMagic;
+        header.key = key;
+        glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+        header.length = static_cast<std::uint32_t>(length);
+
+        // write to a temporary file first so a crash never leaves a truncated entry behind
+        std::string path = entryPath(key);
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(binary.data(), binary.size());
+            if (!file)
+                return;
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+    }
+
+    // compile and link from source, without touching the disk cache
+    unsigned int Compile(const std::string& name, const std::vector<ShaderStage>& stages, const std::string& defines)
+    {
+        PendingProgram pending = BeginCompile(name, stages, defines);
+        return FinishCompile(pending);
+    }
+
+    // issue the compile and link without waiting for them; with KHR_parallel_shader_compile the
+    // driver works on them in the background until IsComplete returns true
+    PendingProgram BeginCompile(const std::string& name, const std::vector<ShaderStage>& stages, const std::string& defines)
+    {
+        PendingProgram pending;
+        pending.name = name;
+        pending.start = std::chrono::high_resolution_clock::now();
+        for (const ShaderStage& stage : stages)
+        {
+            std::string source = injectDefines(stage.source, defines);
+            const char* code = source.c_str();
+            unsigned int shader = glCreateShader(stage.type);
+            glShaderSource(shader, 1, &code, NULL);
+            glCompileShader(shader);
+            pending.shaders.push_back(shader);
+        }
+
+        pending.program = glCreateProgram();
+        // ask the driver to keep a retrievable binary around for Store
+        glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        for (unsigned int shader : pending.shaders)
+            glAttachShader(pending.program, shader);
+        glLinkProgram(pending.program);
+        return pending;
+    }
+
+    // true once the driver has finished a pending link (always true without parallel compile)
+    bool IsComplete(const PendingProgram& pending) const
+    {
+        if (!parallelCompile)
+            return true;
+        GLint complete = GL_FALSE;
+        glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+
+    // check a pending program for errors and release its shaders; returns the program or 0
+    unsigned int FinishCompile(PendingProgram& pending)
+    {
+        bool linked = checkCompileErrors(pending.program, pending.name, true);
+        for (unsigned int shader : pending.shaders)
+        {
+            if (!linked)
+                checkCompileErrors(shader, pending.name, false);
+            glDetachShader(pending.program, shader);
+            glDeleteShader(shader);
+        }
+        pending.shaders.clear();
+
+        unsigned int program = pending.program;
+        pending.program = 0;
+        if (!linked)
+        {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    bool ParallelCompile() const
+    {
+        return parallelCompile;
+    }
+
+    // print per-program compile vs cache-hit cost and the totals for both
+    void PrintTimings(std::ostream& out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        double compileTotal = 0.0, hitTotal = 0.0;
+        int compiles = 0, hits = 0;
+        for (const ProgramTiming& timing : timings)
+        {
+            out << (timing.cacheHit ? "  cache hit  " : "  compiled   ")
+                << std::fixed << std::setprecision(3) << std::setw(10) << timing.milliseconds << " ms  "
+                << timing.name << "\n";
+            if (timing.cacheHit)
+            {
+                hitTotal += timing.milliseconds;
+                hits++;
+            }
+            else
+            {
+                compileTotal += timing.milliseconds;
+                compiles++;
+            }
+        }
+        out << "program cache: " << hits << " hits (" << hitTotal << " ms), "
+            << compiles << " compiles (" << compileTotal << " ms)" << std::endl;
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    static constexpr std::uint32_t kMagic = 0x42504C47; // "GLPB"
+
+    struct EntryHeader {
+        std::uint32_t magic = 0;
+        GLenum format = 0;
+        std::uint64_t key = 0;
+        std::uint32_t length = 0;
+        std::uint32_t padding = 0;
+    };
+
+    std::string directory;
+    std::string driver;
+    bool supported;
+    bool parallelCompile;
+
+    std::string entryPath(std::uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return directory + "/" + name;
+    }
+
+    static std::string glString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    // utility function for checking shader compilation/linking errors.
+    static bool checkCompileErrors(unsigned int object, const std::string& name, bool program)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if (!program)
+        {
+            glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                glGetShaderInfoLog(object, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR in: " << name << "\n" << infoLog << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(object, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glGetProgramInfoLog(object, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR in: " << name << "\n" << infoLog << std::endl;
+            }
+        }
+        return success != 0;
+    }
+};
+#endif
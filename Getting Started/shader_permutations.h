@@ -0,0 +1,260 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "program_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// bit per feature key a shader source can declare with "#pragma feature NAME"
+enum ShaderFeatureBit : std::uint32_t {
+    FEATURE_DIR_LIGHTS    = 1 << 0, // NR_DIR_LIGHTS
+    FEATURE_POINT_LIGHTS  = 1 << 1, // NR_POINT_LIGHTS
+    FEATURE_SPOT_LIGHTS   = 1 << 2, // NR_SPOT_LIGHTS
+    FEATURE_SPECULAR_MAP  = 1 << 3, // HAS_SPECULAR_MAP
+    FEATURE_SKINNING      = 1 << 4  // HAS_SKINNING
+};
+
+// the specialization of a shader for one draw: light counts per type and optional features
+struct ShaderFeatures {
+    // light counts are packed into 4 bits each
+    static constexpr unsigned int MAX_LIGHTS_PER_TYPE = 15;
+
+    unsigned int dirLights   = 1;
+    unsigned int pointLights = 4;
+    unsigned int spotLights  = 0;
+    bool specularMap = true;
+    bool skinning    = false;
+
+    // packed variant key; features the source didn't declare are masked out so they can't
+    // produce two identical programs
+    std::uint32_t Key(std::uint32_t declared) const
+    {
+        std::uint32_t key = 0;
+        if (declared & FEATURE_DIR_LIGHTS)
+            key |= std::min(dirLights, MAX_LIGHTS_PER_TYPE);
+        if (declared & FEATURE_POINT_LIGHTS)
+            key |= std::min(pointLights, MAX_LIGHTS_PER_TYPE) << 4;
+        if (declared & FEATURE_SPOT_LIGHTS)
+            key |= std::min(spotLights, MAX_LIGHTS_PER_TYPE) << 8;
+        if ((declared & FEATURE_SPECULAR_MAP) && specularMap)
+            key |= 1u << 12;
+        if ((declared & FEATURE_SKINNING) && skinning)
+            key |= 1u << 13;
+        return key;
+    }
+
+    // the #define block injected after #version for this variant
+    std::string Defines(std::uint32_t declared) const
+    {
+        std::ostringstream defines;
+        if (declared & FEATURE_DIR_LIGHTS)
+            defines << "#define NR_DIR_LIGHTS " << std::min(dirLights, MAX_LIGHTS_PER_TYPE) << "\n";
+        if (declared & FEATURE_POINT_LIGHTS)
+            defines << "#define NR_POINT_LIGHTS " << std::min(pointLights, MAX_LIGHTS_PER_TYPE) << "\n";
+        if (declared & FEATURE_SPOT_LIGHTS)
+            defines << "#define NR_SPOT_LIGHTS " << std::min(spotLights, MAX_LIGHTS_PER_TYPE) << "\n";
+        if ((declared & FEATURE_SPECULAR_MAP) && specularMap)
+            defines << "#define HAS_SPECULAR_MAP 1\n";
+        if ((declared & FEATURE_SKINNING) && skinning)
+            defines << "#define HAS_SKINNING 1\n";
+        return defines.str();
+    }
+};
+
+// the feature set a mesh needs on its own: a specular map if it has one, skinning if any vertex
+// carries bone weights. Scans every vertex, so call it once at load time and keep the result.
+template <typename MeshType>
+ShaderFeatures meshFeatures(const MeshType& mesh)
+{
+    ShaderFeatures features;
+    features.specularMap = false;
+    for (const auto& texture : mesh.textures)
+        if (texture.type == "texture_specular")
+            features.specularMap = true;
+
+    features.skinning = false;
+    for (const auto& vertex : mesh.vertices)
+    {
+        for (float weight : vertex.m_Weights)
+            if (weight > 0.0f)
+                features.skinning = true;
+        if (features.skinning)
+            break;
+    }
+    return features;
+}
+
+/*  ShaderPermutations owns every compiled variant of one shader. The sources list the features
+    they react to with "#pragma feature NR_POINT_LIGHTS" style lines; each requested feature
+    combination is compiled once with the matching #defines, so unused lights and disabled
+    branches are removed by the GLSL compiler instead of being evaluated per fragment.
+
+    Variants are compiled through the ProgramCache, so only the first run pays for the compile.
+    Prewarm issues every compile up front; with KHR_parallel_shader_compile the driver builds them
+    on its own threads while Poll picks up the ones that are done each frame. */
+class ShaderPermutations {
+public:
+    // constructor
+    ShaderPermutations(ProgramCache& cache, const std::string& name, const std::vector<ShaderStage>& stages)
+        : cache(cache), name(name), stages(stages)
+    {
+        declared = 0;
+        for (const ShaderStage& stage : stages)
+            declared |= declaredFeatures(stage.source);
+    }
+
+    ~ShaderPermutations()
+    {
+        for (auto& entry : variants)
+        {
+            // a variant still compiling gets a program too, which nothing else will delete
+            if (entry.second.pending.program != 0)
+                glDeleteProgram(cache.FinishCompile(entry.second.pending));
+            if (entry.second.program != 0)
+                glDeleteProgram(entry.second.program);
+        }
+    }
+
+    ShaderPermutations(const ShaderPermutations&) = delete;
+    ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+    // the features this shader reacts to; everything else is ignored when choosing a variant
+    std::uint32_t DeclaredFeatures() const
+    {
+        return declared;
+    }
+
+    // start building a variant without waiting for it
+    void Request(const ShaderFeatures& features)
+    {
+        std::uint32_t key = features.Key(declared);
+        if (variants.count(key))
+            return;
+
+        Variant& variant = variants[key];
+        std::string defines = features.Defines(declared);
+        variant.cacheKey = cache.MakeKey(stages, defines);
+        auto start = std::chrono::high_resolution_clock::now();
+        variant.program = cache.Load(variant.cacheKey);
+        if (variant.program != 0)
+        {
+            auto end = std::chrono::high_resolution_clock::now();
+            cache.timings.push_back({ variantName(key), true, std::chrono::duration<double, std::milli>(end - start).count() });
+            return;
+        }
+        variant.pending = cache.BeginCompile(variantName(key), stages, defines);
+    }
+
+    // request every variant in the list; with parallel compile the driver overlaps them all
+    void Prewarm(const std::vector<ShaderFeatures>& featureList)
+    {
+        for (const ShaderFeatures& features : featureList)
+            Request(features);
+    }
+
+    // finish the variants the driver has completed; call once per frame. Returns the number
+    // of variants still compiling.
+    size_t Poll()
+    {
+        size_t remaining = 0;
+        for (auto& entry : variants)
+        {
+            Variant& variant = entry.second;
+            if (variant.pending.program == 0)
+                continue;
+            if (cache.IsComplete(variant.pending))
+                finish(variant);
+            else
+                remaining++;
+        }
+        return remaining;
+    }
+
+    // the program for this feature combination, building it synchronously if it isn't ready yet;
+    // returns 0 if the variant failed to compile
+    unsigned int Select(const ShaderFeatures& features)
+    {
+        std::uint32_t key = features.Key(declared);
+        auto it = variants.find(key);
+        if (it == variants.end())
+        {
+            Request(features);
+            it = variants.find(key);
+        }
+        if (it->second.pending.program != 0)
+            finish(it->second);
+        return it->second.program;
+    }
+
+    size_t VariantCount() const
+    {
+        return variants.size();
+    }
+
+private:
+    struct Variant {
+        unsigned int program = 0;
+        std::uint64_t cacheKey = 0;
+        PendingProgram pending;
+    };
+
+    ProgramCache& cache;
+    std::string name;
+    std::vector<ShaderStage> stages;
+    std::uint32_t declared;
+    std::unordered_map<std::uint32_t, Variant> variants;
+
+    void finish(Variant& variant)
+    {
+        std::string pendingName = variant.pending.name;
+        auto start = variant.pending.start;
+        variant.program = cache.FinishCompile(variant.pending);
+        if (variant.program != 0)
+            cache.Store(variant.cacheKey, variant.program);
+        auto end = std::chrono::high_resolution_clock::now();
+        cache.timings.push_back({ pendingName, false, std::chrono::duration<double, std::milli>(end - start).count() });
+    }
+
+    std::string variantName(std::uint32_t key) const
+    {
+        std::ostringstream variantName;
+        variantName << name << "[" << std::hex << key << "]";
+        return variantName.str();
+    }
+
+    // parse "#pragma feature NAME" lines
+    static std::uint32_t declaredFeatures(const std::string& source)
+    {
+        std::uint32_t features = 0;
+        std::istringstream lines(source);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            std::istringstream words(line);
+            std::string directive, pragma, feature;
+            words >> directive >> pragma >> feature;
+            if (directive != "#pragma" || pragma != "feature")
+                continue;
+
+            if (feature == "NR_DIR_LIGHTS")
+                features |= FEATURE_DIR_LIGHTS;
+            else if (feature == "NR_POINT_LIGHTS")
+                features |= FEATURE_POINT_LIGHTS;
+            else if (feature == "NR_SPOT_LIGHTS")
+                features |= FEATURE_SPOT_LIGHTS;
+            else if (feature == "HAS_SPECULAR_MAP")
+                features |= FEATURE_SPECULAR_MAP;
+            else if (feature == "HAS_SKINNING")
+                features |= FEATURE_SKINNING;
+        }
+        return features;
+    }
+};
+#endif
@@ -0,0 +1,708 @@
+#ifndef ASSET_STREAMING_H
+#define ASSET_STREAMING_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "../Getting Started/frustum.h"
+#include "../Model Loading/mesh.h"
+#include "../Advanced OpenGL/gpu_memory.h"
+#include "../Advanced OpenGL/gpu_resources.h"
+#include "../Advanced OpenGL/state_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*  On-disk layout of streamable assets. Every level can be read on its own with one seek and one
+    read: level 0 is the most detailed, and the levels follow each other from fine to coarse, so
+    a texture's mip chain from any level down to 1x1 is a single contiguous range at the end of
+    the file.
+
+        texture  "STEX" version width height levels {offset size}*levels  RGBA8 mips
+        mesh     "SMSH" version basePixels lods {offset vertexCount indexCount}*lods  {Vertex* uint*}*lods
+
+    basePixels is the size on screen, in pixels, below which a mesh's LOD 0 is more detail than
+    can be seen; every coarser LOD covers half of the size of the one before. */
+
+// an RGBA8 image and its box-filtered mips down to 1x1, finest first
+inline std::vector<std::vector<unsigned char>> buildMipChain(const unsigned char* rgba, int width, int height,
+                                                             std::vector<glm::ivec2>& sizes)
+{
+    std::vector<std::vector<unsigned char>> levels(1, std::vector<unsigned char>(rgba, rgba + size_t(width) * height * 4));
+    sizes.assign(1, glm::ivec2(width, height));
+    while (sizes.back().x > 1 || sizes.back().y > 1)
+    {
+        glm::ivec2 source = sizes.back();
+        glm::ivec2 size(std::max(1, source.x / 2), std::max(1, source.y / 2));
+        std::vector<unsigned char> level(size_t(size.x) * size.y * 4);
+        const std::vector<unsigned char>& above = levels.back();
+        for (int y = 0; y < size.y; y++)
+            for (int x = 0; x < size.x; x++)
+                for (int c = 0; c < 4; c++)
+                {
+                    int x0 = std::min(x * 2, source.x - 1), x1 = std::min(x * 2 + 1, source.x - 1);
+                    int y0 = std::min(y * 2, source.y - 1), y1 = std::min(y * 2 + 1, source.y - 1);
+                    int sum = above[(size_t(y0) * source.x + x0) * 4 + c] + above[(size_t(y0) * source.x + x1) * 4 + c] +
+                              above[(size_t(y1) * source.x + x0) * 4 + c] + above[(size_t(y1) * source.x + x1) * 4 + c];
+                    level[(size_t(y) * size.x + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+        levels.push_back(std::move(level));
+        sizes.push_back(size);
+    }
+    return levels;
+}
+
+// write an RGBA8 image as a streamable texture with its full mip chain
+inline bool writeStreamingTexture(const std::string& path, const unsigned char* rgba, int width, int height)
+{
+    std::vector<glm::ivec2> sizes;
+    std::vector<std::vector<unsigned char>> levels = buildMipChain(rgba, width, height, sizes);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::STREAMING::FAILED_TO_OPEN: " << path << std::endl;
+        return false;
+    }
+    std::uint32_t header[4] = { 1, std::uint32_t(width), std::uint32_t(height), std::uint32_t(levels.size()) };
+    file.write("STEX", 4);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    std::uint64_t offset = 4 + sizeof(header) + levels.size() * 2 * sizeof(std::uint64_t);
+    for (const std::vector<unsigned char>& level : levels)
+    {
+        std::uint64_t entry[2] = { offset, level.size() };
+        file.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+        offset += level.size();
+    }
+    for (const std::vector<unsigned char>& level : levels)
+        file.write(reinterpret_cast<const char*>(level.data()), level.size());
+    return static_cast<bool>(file);
+}
+
+// one level of detail of a streamable mesh
+struct MeshLOD {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+};
+
+inline bool writeStreamingMesh(const std::string& path, const vector<MeshLOD>& lods, float basePixels)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::STREAMING::FAILED_TO_OPEN: " << path << std::endl;
+        return false;
+    }
+    std::uint32_t version = 1, count = std::uint32_t(lods.size());
+    file.write("SMSH", 4);
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char*>(&basePixels), sizeof(basePixels));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    std::uint64_t offset = 16 + lods.size() * 16;
+    for (const MeshLOD& lod : lods)
+    {
+        std::uint32_t counts[2] = { std::uint32_t(lod.vertices.size()), std::uint32_t(lod.indices.size()) };
+        file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+        offset += lod.vertices.size() * sizeof(Vertex) + lod.indices.size() * sizeof(unsigned int);
+    }
+    for (const MeshLOD& lod : lods)
+    {
+        file.write(reinterpret_cast<const char*>(lod.vertices.data()), lod.vertices.size() * sizeof(Vertex));
+        file.write(reinterpret_cast<const char*>(lod.indices.data()), lod.indices.size() * sizeof(unsigned int));
+    }
+    return static_cast<bool>(file);
+}
+
+enum StreamingAssetType {
+    STREAM_TEXTURE = 0,
+    STREAM_MESH
+};
+
+struct StreamingSettings {
+    size_t memoryBudget = size_t(512) << 20;        // GPU bytes the streamed assets may use together
+    size_t maxInFlightBytes = size_t(64) << 20;     // bytes being read at once
+    size_t uploadBytesPerFrame = size_t(16) << 20;  // bytes handed to GL per Update
+    float screenHeight = 1080.0f;                   // pixels, for the projected size
+    float fovY = 45.0f;                             // degrees
+    float outsideFrustumWeight = 0.1f;              // priority scale for assets the camera can't see
+};
+
+struct StreamingStats {
+    std::uint64_t requests = 0;
+    std::uint64_t bytesRead = 0;
+    std::uint64_t uploads = 0;
+    std::uint64_t bytesUploaded = 0;
+    std::uint64_t evictions = 0;   // moves to a coarser level to free memory
+    std::uint64_t failures = 0;
+    size_t residentBytes = 0;
+    size_t inFlightBytes = 0;
+};
+
+/*  Streams textures and meshes in and out while the program runs, instead of loading everything
+    before the first frame. Adding an asset only reads its header; Update, once per frame on the
+    GL thread, then decides per asset which level it should have:
+
+    - the priority is the asset's projected size on screen, from the camera distance to its
+      bounding sphere, scaled down for assets outside the frustum;
+    - the level wanted is the one whose detail matches that size (a 1024 texel texture covering
+      256 pixels wants mip 2).
+
+    An asset with nothing resident asks for its coarsest level first: those are a few bytes each,
+    so the first frame can be drawn right away and everything sharpens over the next ones. Reads
+    go to the job system's worker threads, highest priority first, with at most maxInFlightBytes
+    outstanding. Finished reads are uploaded by Update up to uploadBytesPerFrame, so a burst of
+    arrivals can't stall a frame. A texture gets a new texture object holding its resident mips;
+    a mesh LOD becomes a new Mesh. The objects they replace are freed through the resource pool
+    once the GPU is done with them (gpu_resources.h).
+
+    Detail that is no longer needed, after the camera moved away, stays resident until the memory
+    is needed: when the resident total would go over memoryBudget, the assets with the lowest
+    priority are moved to coarser levels to make room. A texture already holds its coarser mips,
+    so it shrinks on the GPU right away (glCopyImageSubData into a smaller object); a mesh holds
+    only its current LOD and reads the simpler one, as a normal read counted against
+    maxInFlightBytes. An asset never drops below its coarsest level.
+
+    Headers are checked when an asset is added: every level has to have the size its dimensions
+    or counts imply, lie inside the file, and (for textures) follow the level before it. A level
+    whose read fails anyway (the file changed, a mesh index is out of range) is marked and never
+    requested again; the asset keeps what it has or reads the nearest level that hasn't failed.
+
+    GetTexture(id) and GetMesh(id) return what is resident now; draw with whatever they return. */
+class StreamingManager {
+public:
+    StreamingStats stats;
+    StreamingSettings settings;
+
+    StreamingManager(JobSystem& jobs, const StreamingSettings& settings = StreamingSettings())
+        : settings(settings), jobs(jobs)
+    {
+    }
+
+    ~StreamingManager()
+    {
+        // reads still running write into completed
+        jobs.Wait(reading);
+    }
+
+    StreamingManager(const StreamingManager&) = delete;
+    StreamingManager& operator=(const StreamingManager&) = delete;
+
+    // bounds in world space; returns the asset ID, or -1 if the file can't be read
+    int AddTexture(const std::string& path, const glm::vec3& center, float radius)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        std::uint64_t fileSize = file ? static_cast<std::uint64_t>(file.tellg()) : 0;
+        file.seekg(0);
+        char magic[4] = {};
+        std::uint32_t header[4] = {};
+        file.read(magic, 4);
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!file || std::memcmp(magic, "STEX", 4) != 0 || header[0] != 1 || header[1] == 0 || header[2] == 0 ||
+            header[1] > 65536 || header[2] > 65536 || header[3] == 0 || header[3] > mipCount(header[1], header[2]))
+        {
+            std::cout << "ERROR::STREAMING::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return -1;
+        }
+        Asset asset;
+        asset.type = STREAM_TEXTURE;
+        asset.path = path;
+        asset.center = center;
+        asset.radius = radius;
+        asset.width = static_cast<int>(header[1]);
+        asset.height = static_cast<int>(header[2]);
+        asset.baseSize = static_cast<float>(std::max(asset.width, asset.height));
+        for (std::uint32_t level = 0; level < header[3]; level++)
+        {
+            std::uint64_t entry[2] = {};
+            file.read(reinterpret_cast<char*>(entry), sizeof(entry));
+            asset.levels.push_back({ entry[0], entry[1], 0, 0 });
+        }
+        if (!file)
+        {
+            std::cout << "ERROR::STREAMING::FILE_TRUNCATED: " << path << std::endl;
+            return -1;
+        }
+        // uploads read each mip's full size and a level's chain as one range; both have to hold
+        for (size_t level = 0; level < asset.levels.size(); level++)
+        {
+            const Level& entry = asset.levels[level];
+            std::uint64_t expected = std::uint64_t(std::max(1, asset.width >> level)) * std::max(1, asset.height >> level) * 4;
+            bool follows = level == 0 || entry.offset == asset.levels[level - 1].offset + asset.levels[level - 1].size;
+            if (entry.size != expected || !follows || entry.offset > fileSize || entry.size > fileSize - entry.offset)
+            {
+                std::cout << "ERROR::STREAMING::INVALID_LEVEL: " << path << " level " << level << std::endl;
+                return -1;
+            }
+        }
+        assets.push_back(std::move(asset));
+        return static_cast<int>(assets.size() - 1);
+    }
+
+    int AddMesh(const std::string& path, const glm::vec3& center, float radius)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        std::uint64_t fileSize = file ? static_cast<std::uint64_t>(file.tellg()) : 0;
+        file.seekg(0);
+        char magic[4] = {};
+        std::uint32_t version = 0, count = 0;
+        float basePixels = 0.0f;
+        file.read(magic, 4);
+        file.read(reinterpret_cast<char*>(&version), sizeof(version));
+        file.read(reinterpret_cast<char*>(&basePixels), sizeof(basePixels));
+        file.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!file || std::memcmp(magic, "SMSH", 4) != 0 || version != 1 || count == 0)
+        {
+            std::cout << "ERROR::STREAMING::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return -1;
+        }
+        Asset asset;
+        asset.type = STREAM_MESH;
+        asset.path = path;
+        asset.center = center;
+        asset.radius = radius;
+        asset.baseSize = basePixels;
+        for (std::uint32_t lod = 0; lod < count; lod++)
+        {
+            std::uint64_t offset = 0;
+            std::uint32_t counts[2] = {};
+            file.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+            file.read(reinterpret_cast<char*>(counts), sizeof(counts));
+            std::uint64_t size = std::uint64_t(counts[0]) * sizeof(Vertex) + std::uint64_t(counts[1]) * sizeof(unsigned int);
+            asset.levels.push_back({ offset, size, counts[0], counts[1] });
+        }
+        if (!file)
+        {
+            std::cout << "ERROR::STREAMING::FILE_TRUNCATED: " << path << std::endl;
+            return -1;
+        }
+        for (size_t lod = 0; lod < asset.levels.size(); lod++)
+        {
+            const Level& entry = asset.levels[lod];
+            if (entry.vertexCount == 0 || entry.indexCount == 0 || entry.offset > fileSize || entry.size > fileSize - entry.offset)
+            {
+                std::cout << "ERROR::STREAMING::INVALID_LEVEL: " << path << " lod " << lod << std::endl;
+                return -1;
+            }
+        }
+        assets.push_back(std::move(asset));
+        return static_cast<int>(assets.size() - 1);
+    }
+
+    // once per frame on the GL thread: reprioritize, evict, issue reads and upload what arrived
+    void Update(const glm::vec3& cameraPosition, const Frustum& frustum)
+    {
+        prioritize(cameraPosition, frustum);
+        upload();
+        request();
+    }
+
+    // the texture's current GL name, 0 until its first level has arrived
+    unsigned int GetTexture(int id) const
+    {
+        return assets[id].texture.Name();
+    }
+
+    // the mesh's current LOD, null until the first one has arrived
+    Mesh* GetMesh(int id) const
+    {
+        return assets[id].mesh.get();
+    }
+
+    // the finest level resident, or -1
+    int ResidentLevel(int id) const
+    {
+        return assets[id].resident;
+    }
+
+    int WantedLevel(int id) const
+    {
+        return assets[id].wanted;
+    }
+
+    // nothing is being read or waiting for upload and every asset has at least the detail it
+    // wants, or as much of it as its file could deliver
+    bool Settled() const
+    {
+        if (!pending.empty() || stats.inFlightBytes)
+            return false;
+        for (const Asset& asset : assets)
+            if (nextLevel(asset) >= 0)
+                return false;
+        return true;
+    }
+
+private:
+    struct Level {
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint32_t vertexCount; // meshes only
+        std::uint32_t indexCount;
+        bool failed = false;       // its read failed once; it is never requested again
+    };
+
+    struct Asset {
+        StreamingAssetType type = STREAM_TEXTURE;
+        std::string path;
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 1.0f;
+        float baseSize = 1.0f; // texels along the larger side, or basePixels for meshes
+        int width = 0, height = 0;
+        std::vector<Level> levels;
+
+        int resident = -1;     // finest level on the GPU
+        int wanted = -1;
+        int requested = -1;    // level being read, -1 if none
+        float priority = 0.0f;
+        size_t residentBytes = 0;
+
+        GpuTexture texture;
+        std::unique_ptr<Mesh> mesh;
+    };
+
+    // a read that finished on a worker, waiting for Update to upload it
+    struct Completed {
+        int asset;
+        int level;
+        size_t bytes;
+        std::vector<unsigned char> data;
+        bool failed;
+    };
+
+    JobSystem& jobs;
+    std::vector<Asset> assets;
+
+    JobCounter reading;
+    std::mutex completedMutex;
+    std::vector<Completed> completed;
+    std::vector<Completed> pending; // arrived but over this frame's upload budget
+
+    int coarsest(const Asset& asset) const
+    {
+        return static_cast<int>(asset.levels.size()) - 1;
+    }
+
+    static std::uint32_t mipCount(std::uint32_t width, std::uint32_t height)
+    {
+        std::uint32_t count = 1;
+        while ((width >> count) > 0 || (height >> count) > 0)
+            count++;
+        return count;
+    }
+
+    // GPU bytes an asset takes with the given finest level resident
+    size_t levelBytes(const Asset& asset, int level) const
+    {
+        if (level < 0)
+            return 0;
+        if (asset.type == STREAM_MESH)
+            return static_cast<size_t>(asset.levels[level].size);
+        size_t bytes = 0;
+        for (size_t i = static_cast<size_t>(level); i < asset.levels.size(); i++)
+            bytes += static_cast<size_t>(asset.levels[i].size);
+        return bytes;
+    }
+
+    void prioritize(const glm::vec3& cameraPosition, const Frustum& frustum)
+    {
+        float scale = settings.screenHeight / (2.0f * std::tan(glm::radians(settings.fovY) * 0.5f));
+        for (Asset& asset : assets)
+        {
+            float distance = std::max(glm::length(asset.center - cameraPosition) - asset.radius, 0.01f);
+            float pixels = 2.0f * asset.radius * scale / distance;
+            bool visible = frustum.IntersectsSphere(asset.center, asset.radius);
+            asset.priority = visible ? pixels : pixels * settings.outsideFrustumWeight;
+
+            // each level halves the detail, so the wanted level is how many halvings still cover the size.
+            // Assets behind the camera keep theirs; their low priority makes them the first to be evicted
+            float ratio = asset.baseSize / std::max(pixels, 1.0f);
+            int level = ratio > 1.0f ? static_cast<int>(std::floor(std::log2(ratio))) : 0;
+            asset.wanted = std::min(std::max(level, 0), coarsest(asset));
+        }
+    }
+
+    // the level to read next: the coarsest for an asset with nothing resident, otherwise the one
+    // it wants. Levels whose read failed are skipped for the nearest one that may still work;
+    // -1 if there is nothing to read. More detail than wanted is kept until the memory is needed
+    // (see evict)
+    int nextLevel(const Asset& asset) const
+    {
+        if (asset.resident < 0)
+        {
+            for (int level = coarsest(asset); level >= 0; level--)
+                if (!asset.levels[level].failed)
+                    return level;
+            return -1;
+        }
+        for (int level = asset.wanted; level < asset.resident; level++)
+            if (!asset.levels[level].failed)
+                return level;
+        return -1;
+    }
+
+    void request()
+    {
+        std::vector<int> order;
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            const Asset& asset = assets[i];
+            if (asset.requested < 0 && nextLevel(asset) >= 0)
+                order.push_back(static_cast<int>(i));
+        }
+        // nothing resident beats everything else, then the largest on screen
+        std::sort(order.begin(), order.end(), [this](int a, int b) {
+            bool emptyA = assets[a].resident < 0, emptyB = assets[b].resident < 0;
+            if (emptyA != emptyB)
+                return emptyA;
+            return assets[a].priority > assets[b].priority;
+        });
+
+        size_t committed = stats.residentBytes + pendingGrowth();
+        for (int id : order)
+        {
+            Asset& asset = assets[id];
+            int level = nextLevel(asset);
+            size_t now = asset.residentBytes, after = levelBytes(asset, level);
+            if (after > now && committed + (after - now) > settings.memoryBudget)
+            {
+                // make room with assets that matter less, or leave this one as it is until reads
+                // of simpler mesh LODs have brought the memory back
+                committed -= evict(committed + (after - now) - settings.memoryBudget, asset.priority);
+                if (committed + (after - now) > settings.memoryBudget)
+                    continue;
+            }
+            if (stats.inFlightBytes && stats.inFlightBytes + readBytes(asset, level) > settings.maxInFlightBytes)
+                break;
+            if (after > now)
+                committed += after - now;
+            read(id, level);
+        }
+    }
+
+    // move assets below the given priority to coarser levels until bytes are freed; returns what
+    // was freed right away, by shrinking textures. Meshes read a simpler LOD, which frees their
+    // memory only once it has been uploaded
+    size_t evict(size_t bytes, float belowPriority)
+    {
+        std::vector<int> order;
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            const Asset& asset = assets[i];
+            if (asset.requested < 0 && asset.resident >= 0 && asset.resident < coarsest(asset) && asset.priority < belowPriority)
+                order.push_back(static_cast<int>(i));
+        }
+        std::sort(order.begin(), order.end(), [this](int a, int b) { return assets[a].priority < assets[b].priority; });
+
+        size_t freed = 0, freeing = 0;
+        for (int id : order)
+        {
+            if (freed + freeing >= bytes)
+                break;
+            Asset& asset = assets[id];
+            // straight to what it wants if it holds more than that, otherwise one level coarser
+            int level = std::max(asset.resident + 1, asset.wanted);
+            if (asset.levels[level].failed)
+                continue;
+            size_t released = asset.residentBytes - levelBytes(asset, level);
+            if (asset.type == STREAM_TEXTURE)
+            {
+                shrinkTexture(asset, level);
+                freed += released;
+            }
+            else
+            {
+                if (stats.inFlightBytes && stats.inFlightBytes + readBytes(asset, level) > settings.maxInFlightBytes)
+                    continue;
+                read(id, level);
+                freeing += released;
+            }
+            stats.evictions++;
+        }
+        return freed;
+    }
+
+    // bytes the reads in flight and waiting for upload will add
+    size_t pendingGrowth() const
+    {
+        size_t growth = 0;
+        for (const Asset& asset : assets)
+            if (asset.requested >= 0)
+            {
+                size_t after = levelBytes(asset, asset.requested);
+                if (after > asset.residentBytes)
+                    growth += after - asset.residentBytes;
+            }
+        return growth;
+    }
+
+    size_t readBytes(const Asset& asset, int level) const
+    {
+        // a texture rereads the whole chain below its finest level, a mesh only the one LOD
+        return levelBytes(asset, level);
+    }
+
+    void read(int id, int level)
+    {
+        Asset& asset = assets[id];
+        size_t bytes = readBytes(asset, level);
+        std::uint64_t offset = asset.levels[level].offset;
+        std::string path = asset.path;
+        // a mesh LOD's indices are checked against its vertex count before they get near the GPU
+        std::uint32_t vertexCount = asset.type == STREAM_MESH ? asset.levels[level].vertexCount : 0;
+        asset.requested = level;
+        stats.requests++;
+        stats.inFlightBytes += bytes;
+
+        jobs.Run([this, id, level, bytes, offset, path, vertexCount]() {
+            Completed result;
+            result.asset = id;
+            result.level = level;
+            result.bytes = bytes;
+            result.data.resize(bytes);
+            std::ifstream file(path, std::ios::binary);
+            file.seekg(static_cast<std::streamoff>(offset));
+            file.read(reinterpret_cast<char*>(result.data.data()), static_cast<std::streamsize>(bytes));
+            result.failed = !file;
+            if (vertexCount && !result.failed)
+            {
+                const unsigned char* indices = result.data.data() + size_t(vertexCount) * sizeof(Vertex);
+                for (size_t i = 0; i < (bytes - size_t(vertexCount) * sizeof(Vertex)) / sizeof(unsigned int) && !result.failed; i++)
+                {
+                    unsigned int index;
+                    std::memcpy(&index, indices + i * sizeof(unsigned int), sizeof(index));
+                    result.failed = index >= vertexCount;
+                }
+            }
+            std::lock_guard<std::mutex> lock(completedMutex);
+            completed.push_back(std::move(result));
+        }, &reading);
+    }
+
+    void upload()
+    {
+        {
+            std::lock_guard<std::mutex> lock(completedMutex);
+            for (Completed& result : completed)
+            {
+                stats.inFlightBytes -= result.bytes;
+                stats.bytesRead += result.bytes;
+                pending.push_back(std::move(result));
+            }
+            completed.clear();
+        }
+        if (pending.empty())
+            return;
+
+        std::sort(pending.begin(), pending.end(), [this](const Completed& a, const Completed& b) {
+            return assets[a.asset].priority > assets[b.asset].priority;
+        });
+        size_t budget = settings.uploadBytesPerFrame;
+        size_t done = 0;
+        for (; done < pending.size(); done++)
+        {
+            Completed& result = pending[done];
+            // always at least one per frame, however large
+            if (done > 0 && result.bytes > budget)
+                break;
+            budget -= std::min(budget, result.bytes);
+
+            Asset& asset = assets[result.asset];
+            asset.requested = -1;
+            if (result.failed)
+            {
+                // reading it again would fail the same way, every frame
+                asset.levels[result.level].failed = true;
+                std::cout << "ERROR::STREAMING::READ_FAILED: " << asset.path << " level " << result.level << std::endl;
+                stats.failures++;
+                continue;
+            }
+            if (asset.type == STREAM_TEXTURE)
+                uploadTexture(asset, result);
+            else
+                uploadMesh(asset, result);
+            stats.residentBytes -= asset.residentBytes;
+            asset.resident = result.level;
+            asset.residentBytes = levelBytes(asset, result.level);
+            stats.residentBytes += asset.residentBytes;
+            stats.uploads++;
+            stats.bytesUploaded += result.bytes;
+        }
+        pending.erase(pending.begin(), pending.begin() + done);
+    }
+
+    void uploadTexture(Asset& asset, const Completed& result)
+    {
+        int levels = static_cast<int>(asset.levels.size()) - result.level;
+        int width = std::max(1, asset.width >> result.level);
+        int height = std::max(1, asset.height >> result.level);
+
+        // a new object with just the resident mips; the old one is freed once the GPU is done with it
+        GpuTexture texture = GpuTexture::Create();
+        glState().BindTexture(0, GL_TEXTURE_2D, texture.Name());
+        glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
+        const unsigned char* data = result.data.data();
+        for (int level = 0; level < levels; level++)
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, std::max(1, width >> level), std::max(1, height >> level),
+                            GL_RGBA, GL_UNSIGNED_BYTE, data);
+            data += asset.levels[result.level + level].size;
+        }
+        setTextureParameters();
+        gpuMemory().TrackTexture(texture.Name(), GL_RGBA8, width, height, 1, levels, GPU_MEMORY_TEXTURE, asset.path, GPU_MEMORY_SITE);
+        asset.texture = std::move(texture);
+    }
+
+    // drop a texture's finest mips without going back to the file: the coarser ones are copied on the
+    // GPU into a smaller object, and the old one is freed once the GPU is done with it
+    void shrinkTexture(Asset& asset, int level)
+    {
+        int levels = static_cast<int>(asset.levels.size()) - level;
+        int width = std::max(1, asset.width >> level);
+        int height = std::max(1, asset.height >> level);
+
+        GpuTexture texture = GpuTexture::Create();
+        glState().BindTexture(0, GL_TEXTURE_2D, texture.Name());
+        glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
+        for (int i = 0; i < levels; i++)
+            glCopyImageSubData(asset.texture.Name(), GL_TEXTURE_2D, level - asset.resident + i, 0, 0, 0,
+                               texture.Name(), GL_TEXTURE_2D, i, 0, 0, 0,
+                               std::max(1, width >> i), std::max(1, height >> i), 1);
+        setTextureParameters();
+        gpuMemory().TrackTexture(texture.Name(), GL_RGBA8, width, height, 1, levels, GPU_MEMORY_TEXTURE, asset.path, GPU_MEMORY_SITE);
+        asset.texture = std::move(texture);
+
+        stats.residentBytes -= asset.residentBytes;
+        asset.resident = level;
+        asset.residentBytes = levelBytes(asset, level);
+        stats.residentBytes += asset.residentBytes;
+    }
+
+    static void setTextureParameters()
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    void uploadMesh(Asset& asset, const Completed& result)
+    {
+        const Level& lod = asset.levels[result.level];
+        vector<Vertex> vertices(lod.vertexCount);
+        vector<unsigned int> indices(lod.indexCount);
+        std::memcpy(vertices.data(), result.data.data(), vertices.size() * sizeof(Vertex));
+        std::memcpy(indices.data(), result.data.data() + vertices.size() * sizeof(Vertex), indices.size() * sizeof(unsigned int));
+        asset.mesh.reset(new Mesh(std::move(vertices), std::move(indices), vector<Texture>()));
+    }
+};
+#endif
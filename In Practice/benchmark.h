@@ -0,0 +1,415 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*  A small micro-benchmark runner in the style of Google Benchmark, so every optimization comes
+    with a number and a slowdown shows up before it ships. A benchmark is a function that does
+    its setup and then runs the code under test once per loop iteration:
+
+        void cullSpheres(BenchmarkState& state)
+        {
+            vector<glm::vec4> spheres = ...;              // not timed
+            while (state.KeepRunning())
+                benchmarkKeep(countVisible(frustum, spheres));
+            state.SetItemsProcessed(state.Iterations() * spheres.size());
+        }
+
+    The runner calls it with a growing iteration count until one run takes at least the minimum
+    time, then repeats it and reports the median time per iteration. Results go to the console
+    and, with --benchmark_out, to a JSON file laid out like Google Benchmark's. Given a baseline
+    (a file written by an earlier --benchmark_out) with --benchmark_baseline, every benchmark
+    that got slower than the tolerance allows is reported and Run returns 1, so the build step
+    that runs the suite fails.
+
+    Flags: --benchmark_filter=<regex> --benchmark_min_time=<seconds> --benchmark_repetitions=<n>
+           --benchmark_out=<file> --benchmark_baseline=<file> --benchmark_tolerance=<fraction> */
+
+// keep the compiler from optimizing away a result that is never used
+template <typename T>
+inline void benchmarkKeep(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char*>(&value);
+#endif
+}
+
+class BenchmarkState {
+public:
+    BenchmarkState(std::uint64_t iterations, std::int64_t argument)
+        : iterations(iterations), remaining(iterations), argument(argument)
+    {
+    }
+
+    // true once per iteration; the clock runs from the first call to the last
+    bool KeepRunning()
+    {
+        if (!started)
+        {
+            started = true;
+            resumeTiming();
+        }
+        if (remaining == 0)
+        {
+            PauseTiming();
+            return false;
+        }
+        remaining--;
+        return true;
+    }
+
+    // leave per-iteration setup out of the measurement
+    void PauseTiming()
+    {
+        if (!running)
+            return;
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        cpuSeconds += static_cast<double>(std::clock() - startCpu) / CLOCKS_PER_SEC;
+        running = false;
+    }
+
+    void ResumeTiming()
+    {
+        resumeTiming();
+    }
+
+    std::uint64_t Iterations() const
+    {
+        return iterations;
+    }
+
+    // the value the benchmark was registered with, e.g. an object count
+    std::int64_t Argument() const
+    {
+        return argument;
+    }
+
+    // items per iteration times iterations; reported as a throughput
+    void SetItemsProcessed(std::uint64_t items)
+    {
+        itemsProcessed = items;
+    }
+
+    // the benchmark can't run here (missing file, no support); it is left out of the results
+    void SkipWithError(const std::string& message)
+    {
+        error = message;
+        remaining = 0;
+    }
+
+private:
+    friend class BenchmarkRunner;
+
+    std::uint64_t iterations;
+    std::uint64_t remaining;
+    std::int64_t argument;
+    std::uint64_t itemsProcessed = 0;
+    std::string error;
+    bool started = false;
+    bool running = false;
+    double seconds = 0.0;
+    double cpuSeconds = 0.0;
+    std::chrono::steady_clock::time_point startTime;
+    std::clock_t startCpu = 0;
+
+    void resumeTiming()
+    {
+        if (running)
+            return;
+        running = true;
+        startCpu = std::clock();
+        startTime = std::chrono::steady_clock::now();
+    }
+};
+
+struct BenchmarkResult {
+    std::string name;
+    std::uint64_t iterations = 0;
+    double realNanoseconds = 0.0;  // median of the repetitions, per iteration
+    double cpuNanoseconds = 0.0;   // process CPU time, so it adds up the threads of parallel benchmarks
+    double minNanoseconds = 0.0;   // fastest repetition
+    double itemsPerSecond = 0.0;   // 0 when the benchmark didn't report items
+};
+
+class BenchmarkRunner {
+public:
+    double minTime = 0.2;        // seconds one repetition must take at least
+    unsigned int repetitions = 5;
+    double tolerance = 0.10;     // allowed slowdown against the baseline, as a fraction
+    std::string filter;
+    std::string outPath;
+    std::string baselinePath;
+
+    typedef std::function<void(BenchmarkState&)> Function;
+
+    // "name/argument" is reported when an argument is given, like Google Benchmark's ->Arg()
+    void Register(const std::string& name, Function function)
+    {
+        benchmarks.push_back({ name, function, 0 });
+    }
+
+    void Register(const std::string& name, Function function, std::int64_t argument)
+    {
+        benchmarks.push_back({ name + "/" + std::to_string(argument), function, argument });
+    }
+
+    // read the --benchmark_* flags; anything else is left for the caller
+    void ParseArguments(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string argument = argv[i];
+            std::string value;
+            if (flag(argument, "--benchmark_filter=", value))
+                filter = value;
+            else if (flag(argument, "--benchmark_min_time=", value))
+                minTime = std::atof(value.c_str());
+            else if (flag(argument, "--benchmark_repetitions=", value))
+                repetitions = std::max(1, std::atoi(value.c_str()));
+            else if (flag(argument, "--benchmark_out=", value))
+                outPath = value;
+            else if (flag(argument, "--benchmark_baseline=", value))
+                baselinePath = value;
+            else if (flag(argument, "--benchmark_tolerance=", value))
+                tolerance = std::atof(value.c_str());
+        }
+    }
+
+    // run everything that matches the filter; returns the process exit code
+    int Run()
+    {
+#ifndef NDEBUG
+        std::cout << "WARNING::BENCHMARK: built without NDEBUG, timings are not representative" << std::endl;
+#endif
+        std::regex pattern(filter.empty() ? std::string(".") : filter);
+        results.clear();
+        char header[256];
+        std::snprintf(header, sizeof(header), "%-40s %17s %17s %12s", "benchmark", "time", "cpu", "iterations");
+        std::cout << header << std::endl;
+        for (const Benchmark& benchmark : benchmarks)
+        {
+            if (!std::regex_search(benchmark.name, pattern))
+                continue;
+            BenchmarkResult result;
+            std::string error;
+            if (!run(benchmark, result, error))
+            {
+                std::cout << benchmark.name << " SKIPPED: " << error << std::endl;
+                continue;
+            }
+            print(result);
+            results.push_back(result);
+        }
+
+        if (!outPath.empty() && !WriteJSON(outPath))
+            return 1;
+        if (baselinePath.empty())
+            return 0;
+        return CompareWithBaseline(baselinePath) ? 0 : 1;
+    }
+
+    const std::vector<BenchmarkResult>& Results() const
+    {
+        return results;
+    }
+
+    bool WriteJSON(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        char date[32] = "";
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+        file << "{\n  \"context\": {\"date\": \"" << date << "\", \"num_cpus\": " << std::thread::hardware_concurrency()
+#ifdef NDEBUG
+             << ", \"library_build_type\": \"release\"},\n";
+#else
+             << ", \"library_build_type\": \"debug\"},\n";
+#endif
+        // one benchmark per line, which is all ReadJSON relies on
+        file << "  \"benchmarks\": [\n";
+        char line[512];
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchmarkResult& result = results[i];
+            std::snprintf(line, sizeof(line),
+                          "    {\"name\": \"%s\", \"iterations\": %llu, \"real_time\": %.3f, \"cpu_time\": %.3f, "
+                          "\"min_time\": %.3f, \"time_unit\": \"ns\", \"items_per_second\": %.1f}%s\n",
+                          result.name.c_str(), static_cast<unsigned long long>(result.iterations),
+                          result.realNanoseconds, result.cpuNanoseconds, result.minNanoseconds,
+                          result.itemsPerSecond, i + 1 < results.size() ? "," : "");
+            file << line;
+        }
+        file << "  ]\n}\n";
+        return true;
+    }
+
+    // name -> real_time in nanoseconds, from a file written by WriteJSON
+    static bool ReadJSON(const std::string& path, std::map<std::string, double>& times)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::string name;
+            double time = 0.0;
+            if (field(line, "\"name\": \"", name) && number(line, "\"real_time\": ", time))
+                times[name] = time;
+        }
+        return true;
+    }
+
+    // print how every result moved against the baseline; false if any of them regressed
+    bool CompareWithBaseline(const std::string& path) const
+    {
+        std::map<std::string, double> baseline;
+        if (!ReadJSON(path, baseline))
+            return false;
+
+        unsigned int regressions = 0;
+        std::cout << "\nagainst " << path << " (tolerance " << tolerance * 100.0 << "%)" << std::endl;
+        char line[256];
+        for (const BenchmarkResult& result : results)
+        {
+            auto found = baseline.find(result.name);
+            if (found == baseline.end() || found->second <= 0.0)
+            {
+                std::snprintf(line, sizeof(line), "%-40s %14s %14.1f   new", result.name.c_str(), "-", result.realNanoseconds);
+                std::cout << line << std::endl;
+                continue;
+            }
+            double change = result.realNanoseconds / found->second - 1.0;
+            bool regressed = change > tolerance;
+            regressions += regressed;
+            std::snprintf(line, sizeof(line), "%-40s %14.1f %14.1f %+7.1f%%%s", result.name.c_str(), found->second,
+                          result.realNanoseconds, change * 100.0, regressed ? "   REGRESSION" : "");
+            std::cout << line << std::endl;
+        }
+        if (regressions)
+            std::cout << "ERROR::BENCHMARK::REGRESSION: " << regressions << " benchmarks slower than the baseline allows" << std::endl;
+        return regressions == 0;
+    }
+
+private:
+    struct Benchmark {
+        std::string name;
+        Function function;
+        std::int64_t argument;
+    };
+
+    std::vector<Benchmark> benchmarks;
+    std::vector<BenchmarkResult> results;
+
+    bool run(const Benchmark& benchmark, BenchmarkResult& result, std::string& error) const
+    {
+        // grow the iteration count until a run is long enough to time reliably
+        std::uint64_t iterations = 1;
+        BenchmarkState state(iterations, benchmark.argument);
+        for (;;)
+        {
+            state = BenchmarkState(iterations, benchmark.argument);
+            benchmark.function(state);
+            if (!state.error.empty())
+            {
+                error = state.error;
+                return false;
+            }
+            if (state.seconds >= minTime || iterations >= 1000000000ull)
+                break;
+            // aim a little past the minimum so the next run is very likely the last
+            double scale = state.seconds > 0.0 ? minTime * 1.4 / state.seconds : 10.0;
+            scale = std::min(10.0, std::max(2.0, scale));
+            iterations = static_cast<std::uint64_t>(iterations * scale);
+        }
+
+        // the calibrated run counts as the first repetition
+        std::vector<BenchmarkState> runs(1, state);
+        while (runs.size() < repetitions)
+        {
+            runs.push_back(BenchmarkState(iterations, benchmark.argument));
+            benchmark.function(runs.back());
+        }
+        std::sort(runs.begin(), runs.end(),
+                  [](const BenchmarkState& a, const BenchmarkState& b) { return a.seconds < b.seconds; });
+        const BenchmarkState& median = runs[runs.size() / 2];
+
+        result.name = benchmark.name;
+        result.iterations = iterations;
+        result.realNanoseconds = median.seconds * 1e9 / iterations;
+        result.cpuNanoseconds = median.cpuSeconds * 1e9 / iterations;
+        result.minNanoseconds = runs.front().seconds * 1e9 / iterations;
+        result.itemsPerSecond = median.itemsProcessed && median.seconds > 0.0 ? median.itemsProcessed / median.seconds : 0.0;
+        return true;
+    }
+
+    static void print(const BenchmarkResult& result)
+    {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-40s %14.1f ns %14.1f ns %12llu", result.name.c_str(), result.realNanoseconds,
+                      result.cpuNanoseconds, static_cast<unsigned long long>(result.iterations));
+        std::cout << line;
+        if (result.itemsPerSecond > 0.0)
+        {
+            std::snprintf(line, sizeof(line), "   %.3gM items/s", result.itemsPerSecond / 1e6);
+            std::cout << line;
+        }
+        std::cout << std::endl;
+    }
+
+    static bool flag(const std::string& argument, const char* name, std::string& value)
+    {
+        size_t length = std::char_traits<char>::length(name);
+        if (argument.compare(0, length, name) != 0)
+            return false;
+        value = argument.substr(length);
+        return true;
+    }
+
+    static bool field(const std::string& line, const char* key, std::string& value)
+    {
+        size_t begin = line.find(key);
+        if (begin == std::string::npos)
+            return false;
+        begin += std::char_traits<char>::length(key);
+        size_t end = line.find('"', begin);
+        if (end == std::string::npos)
+            return false;
+        value = line.substr(begin, end - begin);
+        return true;
+    }
+
+    static bool number(const std::string& line, const char* key, double& value)
+    {
+        size_t begin = line.find(key);
+        if (begin == std::string::npos)
+            return false;
+        value = std::atof(line.c_str() + begin + std::char_traits<char>::length(key));
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,326 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*  Three slots shared by one producer and one consumer thread. The producer fills Back() and
+    publishes it; the consumer takes the newest published slot with Acquire(). Neither side ever
+    waits for the other: the producer always has a free slot to write, and if it publishes twice
+    before the consumer looks, the older packet is simply overwritten. */
+template <typename T>
+class TripleBuffer {
+public:
+    // producer side
+    T& Back()
+    {
+        return slots[back];
+    }
+
+    void Publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // consumer side
+    bool Fresh() const
+    {
+        return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+    }
+
+    // swap in the newest published slot; false (and Front() unchanged) if nothing new arrived
+    bool Acquire()
+    {
+        if (!Fresh())
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    T& Front()
+    {
+        return slots[front];
+    }
+
+private:
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+
+    T slots[3];
+    unsigned int back = 0;
+    unsigned int front = 1;
+    std::atomic<unsigned int> middle{2};
+};
+
+struct CameraState {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    float zoom = 45.0f;
+
+    glm::mat4 ViewMatrix() const
+    {
+        glm::mat3 rotation = glm::transpose(glm::mat3_cast(orientation));
+        glm::mat4 view(rotation);
+        view[3] = glm::vec4(-(rotation * position), 1.0f);
+        return view;
+    }
+};
+
+struct PacketTransform {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    glm::mat4 Matrix() const
+    {
+        glm::mat3 r = glm::mat3_cast(rotation);
+        return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f), glm::vec4(r[1] * scale.y, 0.0f),
+                         glm::vec4(r[2] * scale.z, 0.0f), glm::vec4(position, 1.0f));
+    }
+};
+
+/*  Everything the renderer needs from one simulation step. Once published a packet is never
+    written again until the render thread has handed it back, so the renderer can read it without
+    locks. The vectors keep their capacity when a slot is reused, so steady-state simulation does
+    not allocate. */
+struct FramePacket {
+    std::uint64_t tick = 0;   // simulation step that produced this packet
+    double simulationTime = 0.0;
+    double publishTime = 0.0; // seconds on the pipeline clock when it was published
+    CameraState camera;
+    std::vector<PacketTransform> transforms; // indexed by object
+    std::vector<std::uint32_t> visible;      // objects that passed culling
+
+    // camera and transforms of the step before (tick - 1), filled in by the pipeline. The renderer
+    // may skip packets when the simulation steps faster than it draws, so the packet it saw last
+    // can be several steps old; interpolating from this one always spans exactly one step
+    CameraState previousCamera;
+    std::vector<PacketTransform> previousTransforms;
+};
+
+inline CameraState interpolate(const CameraState& a, const CameraState& b, float alpha)
+{
+    CameraState state;
+    state.position = glm::mix(a.position, b.position, alpha);
+    state.orientation = glm::slerp(a.orientation, b.orientation, alpha);
+    state.zoom = glm::mix(a.zoom, b.zoom, alpha);
+    return state;
+}
+
+inline PacketTransform interpolate(const PacketTransform& a, const PacketTransform& b, float alpha)
+{
+    PacketTransform transform;
+    transform.position = glm::mix(a.position, b.position, alpha);
+    transform.rotation = glm::slerp(a.rotation, b.rotation, alpha);
+    transform.scale = glm::mix(a.scale, b.scale, alpha);
+    return transform;
+}
+
+// input gathered on the window thread (GLFW only delivers events there) for the simulation thread
+struct SimulationInput {
+    bool forward = false, backward = false, left = false, right = false;
+    float mouseX = 0.0f, mouseY = 0.0f; // summed since the last step
+    float scroll = 0.0f;
+};
+
+/*  Runs the simulation on its own thread with a fixed timestep and hands the results to the
+    render thread through a TripleBuffer of FramePackets. The simulation no longer depends on how
+    long a frame took to render: a slow frame only means the renderer skips packets, and every
+    frame interpolates across the newest packet's last step so motion stays smooth at any frame
+    rate.
+
+    The simulate callback advances the world by one step and fills in the packet it is given;
+    it runs on the simulation thread only. The window thread keeps polling events and forwards
+    them with SetKeys/AddMouse/AddScroll, and calls Acquire, Current and Alpha (or the
+    interpolating InterpolatedCamera and Model) from its render loop. */
+class FramePipeline {
+public:
+    typedef std::function<void(double step, const SimulationInput& input, FramePacket& packet)> SimulateFunction;
+
+    // once the simulation is this far behind, the missing time is dropped instead of caught up
+    unsigned int MaxStepsPerUpdate = 5;
+
+    FramePipeline(double stepSeconds, SimulateFunction simulate)
+        : step(stepSeconds), simulate(std::move(simulate)), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~FramePipeline()
+    {
+        Stop();
+    }
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    void Start()
+    {
+        if (thread.joinable())
+            return;
+        running = true;
+        thread = std::thread(&FramePipeline::simulationLoop, this);
+    }
+
+    void Stop()
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // window thread: input for the next simulation step
+    void SetKeys(bool forward, bool backward, bool left, bool right)
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.forward = forward;
+        input.backward = backward;
+        input.left = left;
+        input.right = right;
+    }
+
+    void AddMouse(float xoffset, float yoffset)
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.mouseX += xoffset;
+        input.mouseY += yoffset;
+    }
+
+    void AddScroll(float yoffset)
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.scroll += yoffset;
+    }
+
+    // render thread: pick up the newest packet, if there is one; call once per frame
+    bool Acquire()
+    {
+        if (!packets.Acquire())
+            return false;
+        received++;
+        return true;
+    }
+
+    const FramePacket& Current()
+    {
+        return packets.Front();
+    }
+
+    // how far the renderer is from Current()'s previous step to Current() itself, in [0, 1]
+    float Alpha()
+    {
+        if (received == 0)
+            return 1.0f;
+        double elapsed = Now() - packets.Front().publishTime;
+        return static_cast<float>(std::min(1.0, std::max(0.0, elapsed / step)));
+    }
+
+    CameraState InterpolatedCamera()
+    {
+        const FramePacket& current = Current();
+        return interpolate(current.previousCamera, current.camera, Alpha());
+    }
+
+    // interpolated model matrix of an object, which may be missing from the previous step
+    glm::mat4 Model(size_t object)
+    {
+        const FramePacket& current = Current();
+        if (object >= current.transforms.size())
+            return glm::mat4(1.0f);
+        if (object >= current.previousTransforms.size())
+            return current.transforms[object].Matrix();
+        return interpolate(current.previousTransforms[object], current.transforms[object], Alpha()).Matrix();
+    }
+
+    // seconds since the pipeline was created
+    double Now() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // steps dropped because the simulation could not keep up
+    std::uint64_t DroppedSteps() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    const double step;
+    SimulateFunction simulate;
+    const std::chrono::steady_clock::time_point start;
+
+    TripleBuffer<FramePacket> packets;
+    std::uint64_t received = 0;
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<std::uint64_t> dropped{0};
+
+    std::mutex inputMutex;
+    SimulationInput input;
+
+    SimulationInput takeInput()
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        SimulationInput taken = input;
+        input.mouseX = input.mouseY = input.scroll = 0.0f;
+        return taken;
+    }
+
+    void simulationLoop()
+    {
+        std::uint64_t tick = 0;
+        double simulated = Now();
+        // the state of the last step, copied into the next packet (assign keeps the capacity)
+        CameraState lastCamera;
+        std::vector<PacketTransform> lastTransforms;
+        while (running)
+        {
+            double now = Now();
+            unsigned int steps = 0;
+            while (simulated + step <= now && steps < MaxStepsPerUpdate)
+            {
+                FramePacket& packet = packets.Back();
+                SimulationInput stepInput = takeInput();
+                simulate(step, stepInput, packet);
+                if (tick == 0)
+                {
+                    lastCamera = packet.camera;
+                    lastTransforms.assign(packet.transforms.begin(), packet.transforms.end());
+                }
+                packet.previousCamera = lastCamera;
+                packet.previousTransforms.assign(lastTransforms.begin(), lastTransforms.end());
+                lastCamera = packet.camera;
+                lastTransforms.assign(packet.transforms.begin(), packet.transforms.end());
+                simulated += step;
+                packet.tick = ++tick;
+                packet.simulationTime = tick * step;
+                packet.publishTime = Now();
+                packets.Publish();
+                steps++;
+            }
+            if (simulated + step <= now)
+            {
+                // too far behind: skip ahead rather than spiral
+                std::uint64_t behind = static_cast<std::uint64_t>((now - simulated) / step);
+                dropped.fetch_add(behind, std::memory_order_relaxed);
+                simulated += behind * step;
+            }
+
+            double wait = simulated + step - Now();
+            if (wait > 0.0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+    }
+};
+#endif
@@ -0,0 +1,348 @@
+#ifndef HOT_PATH_BENCHMARKS_H
+#define HOT_PATH_BENCHMARKS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stb_image.h>
+
+#include <learnopengl/shader.h>
+
+#include "benchmark.h"
+#include "null_gl.h"
+#include "../Getting Started/camera.h"
+#include "../Getting Started/frustum.h"
+#include "../Model Loading/matrix_simd.h"
+#include "../Model Loading/mesh.h"
+#include "../Model Loading/meshlets.h"
+#include "../Model Loading/mesh_compression.h"
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/*  The CPU hot paths of the tutorials as benchmarks: Mesh setup and drawing, texture decoding,
+    uniform lookups by name, the camera's per-frame update, batched matrix products, frustum
+    culling, meshlet culling and compressed mesh decoding. Everything that touches GL is meant to
+    run on the null backend (null_gl.h), so the suite needs no window and measures only our side
+    of each call; it works the same with a real context, which then adds the driver's cost.
+
+    Files the benchmarks need are passed in; a benchmark whose file is missing is skipped. */
+struct BenchmarkAssets {
+    std::string texturePath;          // an image like the ones loadTexture loads
+    std::string vertexShaderPath;     // any shader pair; with the null backend it's only read
+    std::string fragmentShaderPath;
+};
+
+// a flat side x side vertex grid, two triangles per cell
+inline void benchmarkGrid(unsigned int side, vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    for (unsigned int z = 0; z < side; z++)
+        for (unsigned int x = 0; x < side; x++)
+        {
+            Vertex vertex = {};
+            vertex.Position = glm::vec3(static_cast<float>(x), 0.0f, static_cast<float>(z));
+            vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            vertex.TexCoords = glm::vec2(static_cast<float>(x), static_cast<float>(z)) / static_cast<float>(side);
+            vertex.Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+            vertex.Bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
+            vertices.push_back(vertex);
+        }
+    for (unsigned int z = 0; z + 1 < side; z++)
+        for (unsigned int x = 0; x + 1 < side; x++)
+        {
+            unsigned int corner = z * side + x;
+            unsigned int quad[6] = { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+}
+
+// a closed unit sphere of 2 * rings * rings triangles (2 * rings segments around), wound
+// counter-clockwise seen from outside
+inline void benchmarkSphere(unsigned int rings, vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    unsigned int segments = rings * 2;
+    for (unsigned int ring = 0; ring <= rings; ring++)
+        for (unsigned int segment = 0; segment <= segments; segment++)
+        {
+            float theta = 3.14159265f * ring / rings, phi = 6.28318531f * segment / segments;
+            Vertex vertex = {};
+            vertex.Position = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi));
+            vertex.Normal = vertex.Position;
+            vertex.TexCoords = glm::vec2(static_cast<float>(segment) / segments, static_cast<float>(ring) / rings);
+            vertices.push_back(vertex);
+        }
+    for (unsigned int ring = 0; ring < rings; ring++)
+        for (unsigned int segment = 0; segment < segments; segment++)
+        {
+            unsigned int corner = ring * (segments + 1) + segment, below = corner + segments + 1;
+            unsigned int quad[6] = { corner, below, corner + 1, corner + 1, below, below + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+}
+
+// small deterministic generator so every run culls the same scene
+inline float benchmarkRandom(std::uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return static_cast<float>(state >> 8) / 16777216.0f;
+}
+
+// the Mesh constructor: copying the vertex data in, creating and filling the buffers, setting up
+// the attributes, and later deleting it all again. Argument: grid side length
+inline void benchmarkMeshSetup(BenchmarkState& state)
+{
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    benchmarkGrid(static_cast<unsigned int>(state.Argument()), vertices, indices);
+    vector<Texture> textures;
+
+    unsigned int made = 0;
+    while (state.KeepRunning())
+    {
+        Mesh mesh(vertices, indices, textures);
+        benchmarkKeep(mesh.VAO);
+        // a frame's worth of meshes per deletion batch, like a level load would create them
+        if (++made % 256 == 0)
+        {
+            gpuResources().EndFrame();
+            gpuResources().Collect();
+        }
+    }
+    gpuResources().Flush();
+    state.SetItemsProcessed(state.Iterations());
+}
+
+// one Mesh::Draw, alternating between two meshes so the state cache can't filter every bind.
+// Argument 0 binds four textures by name, 1 uses a material ID (material_textures.h)
+inline void benchmarkMeshDraw(BenchmarkState& state, const BenchmarkAssets& assets)
+{
+    if (assets.vertexShaderPath.empty() || assets.fragmentShaderPath.empty())
+    {
+        state.SkipWithError("no shader given");
+        return;
+    }
+    Shader shader(assets.vertexShaderPath.c_str(), assets.fragmentShaderPath.c_str());
+
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    benchmarkGrid(4, vertices, indices);
+    const char* types[4] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+    vector<Mesh> meshes;
+    for (unsigned int m = 0; m < 2; m++)
+    {
+        vector<Texture> textures;
+        for (unsigned int t = 0; t < 4; t++)
+            textures.push_back({ 100 + m * 4 + t, types[t], "" });
+        meshes.emplace_back(vertices, indices, textures);
+        meshes.back().materialID = state.Argument() ? static_cast<int>(m) : -1;
+    }
+
+    glState().UseProgram(shader.ID);
+    while (state.KeepRunning())
+    {
+        meshes[0].Draw(shader);
+        meshes[1].Draw(shader);
+    }
+    meshes.clear();
+    gpuResources().Flush();
+    state.SetItemsProcessed(state.Iterations() * 2);
+}
+
+// the stbi_load half of loadTexture, from memory so disk speed stays out of it; items are pixels
+inline void benchmarkTextureDecode(BenchmarkState& state, const BenchmarkAssets& assets)
+{
+    std::ifstream file(assets.texturePath, std::ios::binary);
+    vector<unsigned char> encoded((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    int width = 0, height = 0, nrComponents = 0;
+    if (encoded.empty())
+    {
+        state.SkipWithError("can't read texture '" + assets.texturePath + "'");
+        return;
+    }
+
+    while (state.KeepRunning())
+    {
+        unsigned char* data = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &nrComponents, 0);
+        benchmarkKeep(data);
+        stbi_image_free(data);
+    }
+    state.SetItemsProcessed(state.Iterations() * static_cast<std::uint64_t>(width) * height);
+}
+
+// the light uniforms of multiple_lights set the way Shader::setVec3/setFloat do it: build the
+// name, look it up, set it. Items are uniforms
+inline void benchmarkUniformNames(BenchmarkState& state)
+{
+    const unsigned int program = 1;
+    const char* vectors[4] = { "].position", "].ambient", "].diffuse", "].specular" };
+    const char* scalars[3] = { "].constant", "].linear", "].quadratic" };
+    glm::vec3 value(1.0f);
+
+    while (state.KeepRunning())
+    {
+        for (unsigned int light = 0; light < 4; light++)
+        {
+            std::string prefix = "pointLights[" + std::to_string(light);
+            for (const char* member : vectors)
+                glUniform3fv(glGetUniformLocation(program, (prefix + member).c_str()), 1, &value[0]);
+            for (const char* member : scalars)
+                glUniform1f(glGetUniformLocation(program, (prefix + member).c_str()), 1.0f);
+        }
+    }
+    state.SetItemsProcessed(state.Iterations() * 4 * 7);
+}
+
+// one frame of camera input: Argument() mouse events through the body of mouse_callback, then
+// Camera::Update and the view-projection the renderer asks for. 0 measures a static camera
+inline void benchmarkCameraUpdate(BenchmarkState& state)
+{
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    camera.SetAspectRatio(800.0f / 600.0f);
+    float lastX = 400.0f, lastY = 300.0f;
+    float xpos = lastX, ypos = lastY;
+    float direction = 1.0f;
+
+    while (state.KeepRunning())
+    {
+        for (std::int64_t event = 0; event < state.Argument(); event++)
+        {
+            // sweep back and forth so the pitch never sticks at its limit
+            xpos += 3.0f * direction;
+            ypos += 1.0f * direction;
+            if (xpos > 700.0f || xpos < 100.0f)
+                direction = -direction;
+
+            float xoffset = xpos - lastX;
+            float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+            lastX = xpos;
+            lastY = ypos;
+            camera.ProcessMouseMovement(xoffset, yoffset);
+        }
+        camera.Update();
+        benchmarkKeep(camera.GetViewProjectionMatrix());
+    }
+    state.SetItemsProcessed(state.Iterations());
+}
+
+// parent * local for Argument() transforms, as a hierarchy update does; items are matrices
+inline void benchmarkMatrixBatch(BenchmarkState& state)
+{
+    size_t count = static_cast<size_t>(state.Argument());
+    vector<glm::mat4> parents(count), locals(count), worlds(count);
+    std::uint32_t seed = 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::vec3 offset(benchmarkRandom(seed), benchmarkRandom(seed), benchmarkRandom(seed));
+        parents[i] = glm::translate(glm::mat4(1.0f), offset * 100.0f);
+        locals[i] = glm::rotate(glm::mat4(1.0f), benchmarkRandom(seed) * 6.28f, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    while (state.KeepRunning())
+    {
+        multiplyMat4Batch(parents.data(), locals.data(), worlds.data(), count);
+        benchmarkKeep(worlds[count - 1]);
+    }
+    state.SetItemsProcessed(state.Iterations() * count);
+}
+
+// bounding spheres scattered around the camera against its frustum; items are objects
+inline void benchmarkFrustumCull(BenchmarkState& state)
+{
+    size_t count = static_cast<size_t>(state.Argument());
+    vector<glm::vec4> spheres(count);
+    std::uint32_t seed = 7;
+    for (glm::vec4& sphere : spheres)
+        sphere = glm::vec4(benchmarkRandom(seed) * 400.0f - 200.0f, benchmarkRandom(seed) * 400.0f - 200.0f,
+                           benchmarkRandom(seed) * 400.0f - 200.0f, 0.5f + benchmarkRandom(seed) * 2.0f);
+
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    camera.SetAspectRatio(800.0f / 600.0f);
+    camera.FarPlane = 150.0f;
+    camera.Update();
+    const Frustum& frustum = camera.GetFrustum();
+
+    while (state.KeepRunning())
+    {
+        size_t visible = 0;
+        for (const glm::vec4& sphere : spheres)
+            visible += frustum.IntersectsSphere(glm::vec3(sphere), sphere.w);
+        benchmarkKeep(visible);
+    }
+    state.SetItemsProcessed(state.Iterations() * count);
+}
+
+// MeshletCuller::Cull on a sphere seen from outside, about half of it backfacing. Argument: sphere
+// rings; items are meshlets
+inline void benchmarkMeshletCull(BenchmarkState& state)
+{
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    benchmarkSphere(static_cast<unsigned int>(state.Argument()), vertices, indices);
+    MeshletSet meshlets = buildMeshlets(vertices, indices);
+
+    Camera camera(glm::vec3(0.0f, 0.0f, 4.0f));
+    camera.SetAspectRatio(800.0f / 600.0f);
+    camera.Update();
+    MeshletCuller culler;
+
+    while (state.KeepRunning())
+    {
+        MeshletCullStats stats = culler.Cull(meshlets, camera.GetFrustum(), camera.Position);
+        benchmarkKeep(stats.ranges);
+    }
+    state.SetItemsProcessed(state.Iterations() * meshlets.meshlets.size());
+}
+
+// CompressedMesh decoding of a sphere with meshlet ordered indices. Argument: sphere rings; items
+// are vertices
+inline void benchmarkMeshDecode(BenchmarkState& state)
+{
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    benchmarkSphere(static_cast<unsigned int>(state.Argument()), vertices, indices);
+    MeshletSet meshlets = buildMeshlets(vertices, indices);
+    std::vector<std::uint8_t> bytes = compressMesh(vertices, meshlets.indices);
+    CompressedMesh compressed;
+    compressed.Load(bytes.data(), bytes.size());
+
+    while (state.KeepRunning())
+    {
+        compressed.DecodeVertices(vertices.data());
+        compressed.DecodeIndices(indices.data());
+        benchmarkKeep(vertices[0].Position.x);
+    }
+    state.SetItemsProcessed(state.Iterations() * vertices.size());
+}
+
+inline void registerHotPathBenchmarks(BenchmarkRunner& runner, const BenchmarkAssets& assets)
+{
+    runner.Register("mesh_setup", benchmarkMeshSetup, 2);
+    runner.Register("mesh_setup", benchmarkMeshSetup, 100);
+    runner.Register("mesh_draw", [assets](BenchmarkState& state) { benchmarkMeshDraw(state, assets); }, 0);
+    runner.Register("mesh_draw", [assets](BenchmarkState& state) { benchmarkMeshDraw(state, assets); }, 1);
+    runner.Register("texture_decode", [assets](BenchmarkState& state) { benchmarkTextureDecode(state, assets); });
+    runner.Register("uniform_names", benchmarkUniformNames);
+    runner.Register("camera_update", benchmarkCameraUpdate, 0);
+    runner.Register("camera_update", benchmarkCameraUpdate, 1);
+    runner.Register("camera_update", benchmarkCameraUpdate, 16);
+    runner.Register("matrix_batch", benchmarkMatrixBatch, 1024);
+    runner.Register("matrix_batch", benchmarkMatrixBatch, 65536);
+    runner.Register("frustum_cull", benchmarkFrustumCull, 1000);
+    runner.Register("frustum_cull", benchmarkFrustumCull, 100000);
+    runner.Register("frustum_cull", benchmarkFrustumCull, 1000000);
+    runner.Register("meshlet_cull", benchmarkMeshletCull, 64);
+    runner.Register("meshlet_cull", benchmarkMeshletCull, 512);
+    runner.Register("mesh_decode", benchmarkMeshDecode, 64);
+    runner.Register("mesh_decode", benchmarkMeshDecode, 512);
+}
+#endif
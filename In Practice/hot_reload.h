@@ -0,0 +1,413 @@
+#ifndef HOT_RELOAD_H
+#define HOT_RELOAD_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <stb_image.h>
+
+#include "job_system.h"
+#include "../Getting Started/program_cache.h"
+#include "../Getting Started/glsl_preprocessor.h"
+#include "../Advanced OpenGL/state_cache.h"
+#include "../Advanced OpenGL/gpu_memory.h"
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/*  Reports files that changed on disk. On Linux the directories of the watched files are
+    watched with inotify, which catches editors that save in place as well as those that write a
+    temporary file and rename it over the original; elsewhere the modification times are compared
+    a few times per second. Editors often write a file in several steps, so a change is only
+    reported once the file has been quiet for QUIET_MILLISECONDS. Poll never blocks. */
+class FileWatcher {
+public:
+    static constexpr int QUIET_MILLISECONDS = 50;
+
+    FileWatcher()
+    {
+#ifdef __linux__
+        descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor < 0)
+            std::cout << "ERROR::FILE_WATCHER::INOTIFY_UNAVAILABLE: falling back to polling" << std::endl;
+#endif
+    }
+
+    ~FileWatcher()
+    {
+#ifdef __linux__
+        if (descriptor >= 0)
+            close(descriptor);
+#endif
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void Watch(const std::string& path)
+    {
+        std::string file = normalize(path);
+        if (!files.emplace(file, modified(file)).second)
+            return;
+#ifdef __linux__
+        if (descriptor < 0)
+            return;
+        std::string directory = std::filesystem::path(file).parent_path().generic_string();
+        if (directory.empty())
+            directory = ".";
+        int watch = inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watch < 0)
+            std::cout << "ERROR::FILE_WATCHER::WATCH_FAILED: " << directory << std::endl;
+        else
+            directories[watch] = directory;
+#endif
+    }
+
+    // the watched files that changed and have settled since the last call
+    std::vector<std::string> Poll()
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+#ifdef __linux__
+        if (descriptor >= 0)
+            readEvents(now);
+        else
+            scan(now);
+#else
+        scan(now);
+#endif
+        std::vector<std::string> settled;
+        for (auto it = changed.begin(); it != changed.end();)
+        {
+            if (now - it->second >= std::chrono::milliseconds(QUIET_MILLISECONDS))
+            {
+                settled.push_back(it->first);
+                it = changed.erase(it);
+            }
+            else
+                ++it;
+        }
+        return settled;
+    }
+
+    static std::string normalize(const std::string& path)
+    {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+private:
+    // watched file -> modification time, for the polling fallback
+    std::unordered_map<std::string, std::filesystem::file_time_type> files;
+    // changed file -> time of its latest change
+    std::map<std::string, std::chrono::steady_clock::time_point> changed;
+    std::chrono::steady_clock::time_point lastScan;
+#ifdef __linux__
+    int descriptor = -1;
+    std::unordered_map<int, std::string> directories;
+
+    void readEvents(std::chrono::steady_clock::time_point now)
+    {
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            ssize_t length = read(descriptor, buffer, sizeof(buffer));
+            if (length <= 0)
+                return;
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    // events were lost; treat everything as changed
+                    for (const auto& file : files)
+                        changed[file.first] = now;
+                    continue;
+                }
+                auto directory = directories.find(event->wd);
+                if (directory == directories.end() || event->len == 0)
+                    continue;
+                std::string file = normalize(directory->second + "/" + event->name);
+                if (files.count(file))
+                    changed[file] = now;
+            }
+        }
+    }
+#endif
+
+    static std::filesystem::file_time_type modified(const std::string& file)
+    {
+        std::error_code error;
+        std::filesystem::file_time_type time = std::filesystem::last_write_time(file, error);
+        return error ? std::filesystem::file_time_type() : time;
+    }
+
+    void scan(std::chrono::steady_clock::time_point now)
+    {
+        if (now - lastScan < std::chrono::milliseconds(250))
+            return;
+        lastScan = now;
+        for (auto& file : files)
+        {
+            std::filesystem::file_time_type time = modified(file.first);
+            if (time != file.second)
+            {
+                file.second = time;
+                changed[file.first] = now;
+            }
+        }
+    }
+};
+
+// one stage of a watched program and the file it is read from
+struct ShaderFile {
+    GLenum type;
+    std::string path;
+};
+
+struct HotReloadStats {
+    unsigned int programsReloaded = 0;
+    unsigned int programsFailed = 0;   // kept their previous version
+    unsigned int texturesReloaded = 0;
+    unsigned int texturesFailed = 0;
+};
+
+/*  Reloads shaders and textures while the program runs. Programs are registered with the
+    variable the renderer reads their name from (a Shader's ID) and textures with their GL name:
+
+        hotReload.WatchProgram(lightingShader.ID, { { GL_VERTEX_SHADER, "4.2.lighting_maps.vs" },
+                                                    { GL_FRAGMENT_SHADER, "4.2.lighting_maps.fs" } },
+                               [&](unsigned int) { lightingShader.use(); lightingShader.setInt("material.diffuse", 0); });
+        hotReload.WatchTexture(diffuseMap, FileSystem::getPath("resources/textures/container2.png"));
+
+    Update, once per frame between frames, asks the FileWatcher what changed. The preprocessor
+    knows which shaders include a changed file, so only the programs built from those are
+    recompiled. Compiles are issued without waiting; with KHR_parallel_shader_compile the driver
+    works on them in the background and Update picks each one up when it has linked, then swaps
+    it into the variable and deletes the old program. A program that fails to compile keeps its
+    previous version. The onReload callback runs after the swap so the uniforms that are only set
+    once (sampler units) can be set again.
+
+    Changed textures are decoded on the job system's workers and uploaded into the same texture
+    name by Update, so nothing that refers to them has to change.
+
+    Everything except the decoding runs on the GL thread; the watched variables have to outlive
+    the HotReload. */
+class HotReload {
+public:
+    HotReloadStats stats;
+
+    HotReload(GLSLPreprocessor& preprocessor, ProgramCache& programs, JobSystem& jobs)
+        : preprocessor(preprocessor), programs(programs), jobs(jobs)
+    {
+    }
+
+    ~HotReload()
+    {
+        // a decode job may still write into decoded
+        jobs.Wait(decoding);
+        for (DecodedTexture& texture : decoded)
+            stbi_image_free(texture.data);
+        for (WatchedProgram& watched : watchedPrograms)
+            if (watched.compiling)
+                glDeleteProgram(programs.FinishCompile(watched.pending));
+    }
+
+    HotReload(const HotReload&) = delete;
+    HotReload& operator=(const HotReload&) = delete;
+
+    // program holds the current program name and is overwritten on every successful reload
+    void WatchProgram(unsigned int& program, const std::vector<ShaderFile>& files,
+                      std::function<void(unsigned int)> onReload = nullptr, const std::string& defines = "")
+    {
+        WatchedProgram watched;
+        watched.program = &program;
+        watched.files = files;
+        watched.onReload = std::move(onReload);
+        watched.defines = defines;
+        for (ShaderFile& file : watched.files)
+        {
+            file.path = FileWatcher::normalize(file.path);
+            // read it now so the preprocessor knows the includes before anything changes
+            watchIncludes(preprocessor.Expand(file.path, defines));
+        }
+        watchedPrograms.push_back(std::move(watched));
+    }
+
+    // texture is the name loadTexture returned for path
+    void WatchTexture(unsigned int texture, const std::string& path)
+    {
+        std::string file = FileWatcher::normalize(path);
+        watchedTextures[file].push_back(texture);
+        watcher.Watch(file);
+    }
+
+    // once per frame on the GL thread, outside of any draw
+    void Update()
+    {
+        for (const std::string& file : watcher.Poll())
+        {
+            // the shader files that read this file, directly or through an #include
+            std::vector<std::string> roots = preprocessor.Invalidate(file);
+            std::set<std::string> affected(roots.begin(), roots.end());
+            for (WatchedProgram& watched : watchedPrograms)
+                for (const ShaderFile& stage : watched.files)
+                    if (affected.count(stage.path))
+                    {
+                        watched.dirty = true;
+                        break;
+                    }
+
+            auto texture = watchedTextures.find(file);
+            if (texture != watchedTextures.end())
+                decode(file, texture->second);
+        }
+
+        for (WatchedProgram& watched : watchedPrograms)
+        {
+            if (watched.dirty && !watched.compiling)
+                beginCompile(watched);
+            else if (watched.compiling && programs.IsComplete(watched.pending))
+                finishCompile(watched);
+        }
+
+        uploadDecoded();
+    }
+
+private:
+    struct WatchedProgram {
+        unsigned int* program = nullptr;
+        std::vector<ShaderFile> files;
+        std::function<void(unsigned int)> onReload;
+        std::string defines;
+        bool dirty = false;
+        bool compiling = false;
+        std::uint64_t key = 0;
+        std::vector<ShaderStage> stages;
+        PendingProgram pending;
+    };
+
+    struct DecodedTexture {
+        std::string path;
+        std::vector<unsigned int> textures;
+        unsigned char* data = nullptr;
+        int width = 0, height = 0, nrComponents = 0;
+    };
+
+    GLSLPreprocessor& preprocessor;
+    ProgramCache& programs;
+    JobSystem& jobs;
+    FileWatcher watcher;
+
+    std::vector<WatchedProgram> watchedPrograms;
+    std::unordered_map<std::string, std::vector<unsigned int>> watchedTextures;
+
+    JobCounter decoding;
+    std::mutex decodedMutex;
+    std::vector<DecodedTexture> decoded;
+
+    void watchIncludes(const ExpandedSource& source)
+    {
+        for (const std::string& file : source.files)
+            watcher.Watch(file);
+    }
+
+    void beginCompile(WatchedProgram& watched)
+    {
+        watched.dirty = false;
+        watched.stages.clear();
+        for (const ShaderFile& file : watched.files)
+        {
+            const ExpandedSource& source = preprocessor.Expand(file.path, watched.defines);
+            // an edit may have added an #include
+            watchIncludes(source);
+            watched.stages.push_back({ file.type, source.text });
+        }
+        watched.key = programs.MakeKey(watched.stages, "");
+        watched.pending = programs.BeginCompile(watched.files[0].path, watched.stages, "");
+        watched.compiling = true;
+    }
+
+    void finishCompile(WatchedProgram& watched)
+    {
+        watched.compiling = false;
+        unsigned int program = programs.FinishCompile(watched.pending);
+        if (program == 0)
+        {
+            std::cout << "ERROR::HOT_RELOAD::PROGRAM_FAILED: " << watched.files[0].path << ", keeping the previous version" << std::endl;
+            stats.programsFailed++;
+            return;
+        }
+        // the next launch gets the new version from the binary cache
+        programs.Store(watched.key, program);
+
+        unsigned int previous = *watched.program;
+        *watched.program = program;
+        glState().ForgetProgram(previous);
+        glDeleteProgram(previous);
+        stats.programsReloaded++;
+        if (watched.onReload)
+            watched.onReload(program);
+    }
+
+    void decode(const std::string& path, const std::vector<unsigned int>& textures)
+    {
+        jobs.Run([this, path, textures]() {
+            DecodedTexture texture;
+            texture.path = path;
+            texture.textures = textures;
+            texture.data = stbi_load(path.c_str(), &texture.width, &texture.height, &texture.nrComponents, 0);
+            std::lock_guard<std::mutex> lock(decodedMutex);
+            decoded.push_back(std::move(texture));
+        }, &decoding);
+    }
+
+    // same as loadTexture, into the existing texture names
+    void uploadDecoded()
+    {
+        std::vector<DecodedTexture> ready;
+        {
+            std::lock_guard<std::mutex> lock(decodedMutex);
+            ready.swap(decoded);
+        }
+        for (DecodedTexture& texture : ready)
+        {
+            if (!texture.data)
+            {
+                // probably caught halfway through a save; the next change event brings it back
+                std::cout << "ERROR::HOT_RELOAD::TEXTURE_FAILED: " << texture.path << ", keeping the previous version" << std::endl;
+                stats.texturesFailed++;
+                continue;
+            }
+            GLenum format = GL_RGBA;
+            if (texture.nrComponents == 1)
+                format = GL_RED;
+            else if (texture.nrComponents == 3)
+                format = GL_RGB;
+
+            for (unsigned int name : texture.textures)
+            {
+                glState().BindTexture(0, GL_TEXTURE_2D, name);
+                glTexImage2D(GL_TEXTURE_2D, 0, format, texture.width, texture.height, 0, format, GL_UNSIGNED_BYTE, texture.data);
+                glGenerateMipmap(GL_TEXTURE_2D);
+                gpuMemory().TrackTexture(name, format, texture.width, texture.height, 1, fullMipLevels(texture.width, texture.height),
+                                         GPU_MEMORY_TEXTURE, texture.path, GPU_MEMORY_SITE);
+            }
+            stbi_image_free(texture.data);
+            stats.texturesReloaded++;
+        }
+    }
+};
+#endif
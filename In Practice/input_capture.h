@@ -0,0 +1,433 @@
+#ifndef INPUT_CAPTURE_H
+#define INPUT_CAPTURE_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum InputEventType : std::uint8_t {
+    INPUT_KEY = 0,
+    INPUT_CURSOR,
+    INPUT_SCROLL
+};
+
+// one GLFW callback as it arrived; time is in seconds since recording started
+struct InputEvent {
+    double time = 0.0;
+    InputEventType type = INPUT_KEY;
+    int key = 0, scancode = 0, action = 0, mods = 0; // INPUT_KEY
+    double x = 0.0, y = 0.0;                         // INPUT_CURSOR position, INPUT_SCROLL offset
+};
+
+// frame times of a run in milliseconds, to compare one build against another
+struct FrameTimeSummary {
+    size_t frames = 0;
+    double mean = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+/*  Sits between GLFW and the tutorial's input callbacks so a camera path can be recorded once
+    and replayed exactly. In record mode every key, cursor and scroll event is timestamped and
+    passed on; the events are written to a file by Stop. In replay mode live input is ignored and
+    the recorded events are fed to the same callbacks on a fixed-timestep clock: each frame
+    advances the clock by one step, however long the frame really took, and delivers the events
+    that happened up to then. Two replays of a file therefore move the camera identically, and
+    the frame times they measure can be compared across builds and machines.
+
+    The render loop gets deltaTime from BeginFrame instead of glfwGetTime(), and processInput
+    asks GetKey instead of glfwGetKey, so held keys are part of the recording too:
+
+        inputCapture().Attach(window, mouse_callback, scroll_callback);
+        inputCapture().Replay("camera_path.input", 1.0 / 60.0);
+        while (!glfwWindowShouldClose(window) && !inputCapture().Finished())
+        {
+            deltaTime = inputCapture().BeginFrame();
+            ...
+        }
+        inputCapture().Stop();
+
+    Everything runs on the window thread, like GLFW itself. */
+class InputCapture {
+public:
+    enum Mode {
+        INPUT_LIVE,
+        INPUT_RECORD,
+        INPUT_REPLAY
+    };
+
+    // install the capture's GLFW callbacks in front of the application's; key may be null
+    void Attach(GLFWwindow* window, GLFWcursorposfun cursor, GLFWscrollfun scroll, GLFWkeyfun key = nullptr)
+    {
+        this->window = window;
+        cursorCallback = cursor;
+        scrollCallback = scroll;
+        keyCallback = key;
+        glfwSetCursorPosCallback(window, onCursor);
+        glfwSetScrollCallback(window, onScroll);
+        glfwSetKeyCallback(window, onKey);
+    }
+
+    // start recording; keys that are already held are recorded as pressed at time 0
+    void Record(const std::string& path)
+    {
+        Stop();
+        mode = INPUT_RECORD;
+        filePath = path;
+        events.clear();
+        start = glfwGetTime();
+        lastTime = 0.0;
+        std::fill(keys, keys + KEY_COUNT, GLFW_RELEASE);
+        for (int key = FIRST_KEY; key < KEY_COUNT; key++)
+            if (window && glfwGetKey(window, key) == GLFW_PRESS)
+            {
+                InputEvent event;
+                event.type = INPUT_KEY;
+                event.key = key;
+                event.action = GLFW_PRESS;
+                record(event);
+                keys[key] = GLFW_PRESS;
+            }
+        beginRun();
+    }
+
+    // play a recording back at step seconds per frame
+    bool Replay(const std::string& path, double step)
+    {
+        Stop();
+        if (!Load(path))
+            return false;
+        mode = INPUT_REPLAY;
+        filePath = path;
+        this->step = step;
+        clock = 0.0;
+        next = 0;
+        std::fill(keys, keys + KEY_COUNT, GLFW_RELEASE);
+        beginRun();
+        return true;
+    }
+
+    // write the recording (record mode) and go back to live input
+    void Stop()
+    {
+        if (mode == INPUT_RECORD)
+        {
+            duration = glfwGetTime() - start;
+            Save(filePath);
+        }
+        mode = INPUT_LIVE;
+        // the next live deltaTime starts from now, not from where the recording's clock was
+        lastTime = glfwGetTime();
+    }
+
+    // call at the top of every frame; returns the deltaTime the frame should simulate
+    float BeginFrame()
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        // only runs are timed; live play would grow the list for the whole session
+        if (frameStarted && mode != INPUT_LIVE)
+            frameTimes.push_back(std::chrono::duration<float, std::milli>(now - frameStart).count());
+        frameStart = now;
+        frameStarted = true;
+
+        if (mode != INPUT_REPLAY)
+        {
+            double time = mode == INPUT_RECORD ? glfwGetTime() - start : glfwGetTime();
+            float delta = static_cast<float>(time - lastTime);
+            lastTime = time;
+            return delta;
+        }
+
+        clock += step;
+        while (next < events.size() && events[next].time <= clock)
+            dispatch(events[next++]);
+        return static_cast<float>(step);
+    }
+
+    // GLFW_PRESS or GLFW_RELEASE; live input in live mode, the recorded key state otherwise
+    int GetKey(GLFWwindow* window, int key) const
+    {
+        if (mode == INPUT_LIVE)
+            return glfwGetKey(window, key);
+        if (key < 0 || key >= KEY_COUNT)
+            return GLFW_RELEASE;
+        return keys[key] == GLFW_RELEASE ? GLFW_RELEASE : GLFW_PRESS;
+    }
+
+    // seconds on the clock the frames run on, for anything else animated by time
+    double Time() const
+    {
+        if (mode == INPUT_REPLAY)
+            return clock;
+        return mode == INPUT_RECORD ? glfwGetTime() - start : glfwGetTime();
+    }
+
+    // replay has reached the end of the recording
+    bool Finished() const
+    {
+        return mode == INPUT_REPLAY && next >= events.size() && clock >= duration;
+    }
+
+    Mode GetMode() const
+    {
+        return mode;
+    }
+
+    const std::vector<InputEvent>& Events() const
+    {
+        return events;
+    }
+
+    bool Save(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::INPUT_CAPTURE::FAILED_TO_OPEN: " << path << std::endl;
+            return false;
+        }
+        file.write("INPT", 4);
+        writeValue<std::uint32_t>(file, 1); // version
+        writeValue<double>(file, duration);
+        writeValue<std::uint64_t>(file, events.size());
+        for (const InputEvent& event : events)
+        {
+            writeValue<double>(file, event.time);
+            writeValue<std::uint8_t>(file, event.type);
+            if (event.type == INPUT_KEY)
+            {
+                writeValue<std::int32_t>(file, event.key);
+                writeValue<std::int32_t>(file, event.scancode);
+                writeValue<std::int32_t>(file, event.action);
+                writeValue<std::int32_t>(file, event.mods);
+            }
+            else
+            {
+                writeValue<double>(file, event.x);
+                writeValue<double>(file, event.y);
+            }
+        }
+        return static_cast<bool>(file);
+    }
+
+    bool Load(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        char magic[4] = {};
+        std::uint32_t version = 0;
+        std::uint64_t count = 0;
+        file.read(magic, 4);
+        readValue(file, version);
+        readValue(file, duration);
+        readValue(file, count);
+        if (!file || std::string(magic, 4) != "INPT" || version != 1)
+        {
+            std::cout << "ERROR::INPUT_CAPTURE::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return false;
+        }
+
+        events.clear();
+        events.reserve(static_cast<size_t>(count));
+        for (std::uint64_t i = 0; i < count && file; i++)
+        {
+            InputEvent event;
+            std::uint8_t type = 0;
+            readValue(file, event.time);
+            readValue(file, type);
+            event.type = static_cast<InputEventType>(type);
+            if (event.type == INPUT_KEY)
+            {
+                std::int32_t values[4] = {};
+                for (std::int32_t& value : values)
+                    readValue(file, value);
+                event.key = values[0];
+                event.scancode = values[1];
+                event.action = values[2];
+                event.mods = values[3];
+            }
+            else
+            {
+                readValue(file, event.x);
+                readValue(file, event.y);
+            }
+            events.push_back(event);
+        }
+        if (!file)
+        {
+            std::cout << "ERROR::INPUT_CAPTURE::FILE_TRUNCATED: " << path << std::endl;
+            events.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // milliseconds per frame of the current run, or of the last one after Stop
+    const std::vector<float>& FrameTimes() const
+    {
+        return frameTimes;
+    }
+
+    FrameTimeSummary Summarize() const
+    {
+        FrameTimeSummary summary;
+        if (frameTimes.empty())
+            return summary;
+        std::vector<float> sorted(frameTimes);
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (float time : sorted)
+            total += time;
+        summary.frames = sorted.size();
+        summary.mean = total / sorted.size();
+        summary.median = sorted[sorted.size() / 2];
+        summary.p95 = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+        summary.p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+        summary.max = sorted.back();
+        return summary;
+    }
+
+    // one line per frame: frame,milliseconds
+    bool WriteFrameTimes(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::INPUT_CAPTURE::FAILED_TO_OPEN: " << path << std::endl;
+            return false;
+        }
+        file << "frame,milliseconds\n";
+        char line[64];
+        for (size_t i = 0; i < frameTimes.size(); i++)
+        {
+            std::snprintf(line, sizeof(line), "%zu,%.4f\n", i, frameTimes[i]);
+            file << line;
+        }
+        return static_cast<bool>(file);
+    }
+
+private:
+    static const int FIRST_KEY = 32; // GLFW_KEY_SPACE; glfwGetKey rejects anything lower
+    static const int KEY_COUNT = GLFW_KEY_LAST + 1;
+
+    Mode mode = INPUT_LIVE;
+    GLFWwindow* window = nullptr;
+    GLFWcursorposfun cursorCallback = nullptr;
+    GLFWscrollfun scrollCallback = nullptr;
+    GLFWkeyfun keyCallback = nullptr;
+
+    std::string filePath;
+    std::vector<InputEvent> events;
+    double duration = 0.0;
+    double start = 0.0;    // glfwGetTime() when recording started
+    double lastTime = 0.0; // for deltaTime outside replay
+    double step = 1.0 / 60.0;
+    double clock = 0.0;    // replay time
+    size_t next = 0;       // first event not yet replayed
+    int keys[KEY_COUNT] = {};
+
+    std::vector<float> frameTimes;
+    std::chrono::steady_clock::time_point frameStart;
+    bool frameStarted = false;
+
+    void beginRun()
+    {
+        frameTimes.clear();
+        frameStarted = false;
+    }
+
+    void record(InputEvent event)
+    {
+        event.time = glfwGetTime() - start;
+        events.push_back(event);
+    }
+
+    // what a live event does: key state first, so the callback already sees it
+    void dispatch(const InputEvent& event)
+    {
+        if (event.type == INPUT_KEY)
+        {
+            if (event.key >= 0 && event.key < KEY_COUNT)
+                keys[event.key] = event.action;
+            if (keyCallback)
+                keyCallback(window, event.key, event.scancode, event.action, event.mods);
+        }
+        else if (event.type == INPUT_CURSOR)
+        {
+            if (cursorCallback)
+                cursorCallback(window, event.x, event.y);
+        }
+        else if (scrollCallback)
+            scrollCallback(window, event.x, event.y);
+    }
+
+    void live(const InputEvent& event)
+    {
+        // recorded input is all that counts during a replay
+        if (mode == INPUT_REPLAY)
+            return;
+        if (mode == INPUT_RECORD)
+            record(event);
+        dispatch(event);
+    }
+
+    static void onCursor(GLFWwindow*, double xpos, double ypos);
+    static void onScroll(GLFWwindow*, double xoffset, double yoffset);
+    static void onKey(GLFWwindow*, int key, int scancode, int action, int mods);
+
+    template <typename T>
+    static void writeValue(std::ofstream& file, T value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static void readValue(std::ifstream& file, T& value)
+    {
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+};
+
+inline InputCapture& inputCapture()
+{
+    static InputCapture capture;
+    return capture;
+}
+
+inline void InputCapture::onCursor(GLFWwindow*, double xpos, double ypos)
+{
+    InputEvent event;
+    event.type = INPUT_CURSOR;
+    event.x = xpos;
+    event.y = ypos;
+    inputCapture().live(event);
+}
+
+inline void InputCapture::onScroll(GLFWwindow*, double xoffset, double yoffset)
+{
+    InputEvent event;
+    event.type = INPUT_SCROLL;
+    event.x = xoffset;
+    event.y = yoffset;
+    inputCapture().live(event);
+}
+
+inline void InputCapture::onKey(GLFWwindow*, int key, int scancode, int action, int mods)
+{
+    InputEvent event;
+    event.type = INPUT_KEY;
+    event.key = key;
+    event.scancode = scancode;
+    event.action = action;
+    event.mods = mods;
+    inputCapture().live(event);
+}
+#endif
@@ -0,0 +1,297 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parallel_for.h"
+
+/*  Counts the jobs that still have to finish before something else may run. Run increments it,
+    every finished job decrements it, and Wait or RunAfter use it as a dependency. A counter can be
+    reused once it is back at zero, and has to outlive the jobs that reference it. */
+struct JobCounter {
+    std::atomic<int> pending{0};
+
+    bool Done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    // jobs queued with RunAfter, submitted when pending drops to zero
+    struct Continuation {
+        std::function<void()> job;
+        JobCounter* counter;
+    };
+    std::mutex mutex;
+    std::vector<Continuation> continuations;
+};
+
+struct JobSystemStats {
+    std::uint64_t executed = 0; // jobs run, by any thread
+    std::uint64_t stolen = 0;   // jobs taken from another thread's queue
+};
+
+/*  A work-stealing job scheduler. Every worker thread owns a queue; jobs submitted from a worker go
+    onto its own queue, and the worker takes new work from the back of it, so the most recently
+    submitted (and still cache-warm) job runs first. A worker whose queue is empty steals from the
+    front of another queue, which holds the oldest and usually largest pieces of work. Idle
+    workers sleep until something is submitted.
+
+    The thread that created the system (normally the one holding the GL context) is not a worker,
+    but it has a queue of its own and runs jobs while it waits in Wait or ParallelFor, so all cores
+    do useful work and GL calls never leave the context thread. */
+class JobSystem {
+public:
+    // threadCount workers besides the calling thread; by default one per remaining core
+    explicit JobSystem(unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1)
+        : queues(threadCount + 1)
+    {
+        for (std::unique_ptr<Queue>& queue : queues)
+            queue.reset(new Queue());
+        for (unsigned int i = 1; i <= threadCount; i++)
+            threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // queue a job; counter (optional) is incremented now and decremented when the job has finished
+    void Run(std::function<void()> job, JobCounter* counter = nullptr)
+    {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        submit(Job{ std::move(job), counter });
+    }
+
+    // queue a job that may only start once dependency has reached zero
+    void RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr)
+    {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(dependency.mutex);
+            if (!dependency.Done())
+            {
+                dependency.continuations.push_back({ std::move(job), counter });
+                return;
+            }
+        }
+        submit(Job{ std::move(job), counter });
+    }
+
+    // run queued jobs on the calling thread until the counter reaches zero
+    void Wait(JobCounter& counter)
+    {
+        while (!counter.Done())
+        {
+            Job job;
+            if (take(currentQueue(), job))
+                execute(job);
+            else
+                std::this_thread::yield();
+        }
+        // the job that brought the count to zero may still hold the counter's lock
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    // body(begin, end) over [0, count) in chunks of grain items; returns when every chunk is done
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+    {
+        if (count == 0)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        if (count <= grain || threads.empty())
+        {
+            body(0, count);
+            return;
+        }
+
+        JobCounter counter;
+        // the calling thread keeps the first chunk for itself
+        for (size_t begin = grain; begin < count; begin += grain)
+        {
+            size_t end = std::min(count, begin + grain);
+            Run([&body, begin, end]() { body(begin, end); }, &counter);
+        }
+        body(0, grain);
+        Wait(counter);
+    }
+
+    // ParallelFor as a function object, for code that takes one (transform_hierarchy.h)
+    ::ParallelFor Parallel()
+    {
+        return [this](size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+            ParallelFor(count, grain, body);
+        };
+    }
+
+    // worker threads, not counting the calling thread
+    unsigned int WorkerCount() const
+    {
+        return static_cast<unsigned int>(threads.size());
+    }
+
+    JobSystemStats Stats() const
+    {
+        JobSystemStats stats;
+        for (const std::unique_ptr<Queue>& queue : queues)
+        {
+            stats.executed += queue->executed.load(std::memory_order_relaxed);
+            stats.stolen += queue->stolen.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+private:
+    struct Job {
+        std::function<void()> function;
+        JobCounter* counter = nullptr;
+    };
+
+    // one per thread, on its own cache line so queues of different threads don't false-share
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        std::atomic<std::uint64_t> executed{0};
+        std::atomic<std::uint64_t> stolen{0};
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; // queues[0] belongs to the creating thread
+    std::vector<std::thread> threads;
+    std::atomic<int> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // which system the current thread works for and the index of its queue
+    struct ThreadSlot {
+        const JobSystem* system = nullptr;
+        unsigned int index = 0;
+    };
+
+    static ThreadSlot& threadSlot()
+    {
+        static thread_local ThreadSlot slot;
+        return slot;
+    }
+
+    // threads that are not workers of this system all share queue 0
+    unsigned int currentQueue() const
+    {
+        const ThreadSlot& slot = threadSlot();
+        return slot.system == this ? slot.index : 0;
+    }
+
+    void submit(Job job)
+    {
+        Queue& queue = *queues[currentQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        // a worker between checking queued and going to sleep would miss the notify otherwise
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // newest job from our own queue, otherwise the oldest job of another queue
+    bool take(unsigned int index, Job& job)
+    {
+        if (queued.load(std::memory_order_acquire) == 0)
+            return false;
+
+        Queue& own = *queues[index];
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty())
+            {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++)
+        {
+            Queue& victim = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty())
+            {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                own.stolen.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(Job& job)
+    {
+        job.function();
+        queues[currentQueue()]->executed.fetch_add(1, std::memory_order_relaxed);
+        if (job.counter)
+            finish(*job.counter);
+    }
+
+    void finish(JobCounter& counter)
+    {
+        std::vector<JobCounter::Continuation> ready;
+        {
+            // decrement under the lock so RunAfter can't add a continuation that is never submitted
+            std::lock_guard<std::mutex> lock(counter.mutex);
+            if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.swap(counter.continuations);
+        }
+        for (JobCounter::Continuation& continuation : ready)
+            submit(Job{ std::move(continuation.job), continuation.counter });
+    }
+
+    void workerLoop(unsigned int index)
+    {
+        threadSlot().system = this;
+        threadSlot().index = index;
+
+        for (;;)
+        {
+            Job job;
+            if (take(index, job))
+            {
+                execute(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping)
+                return;
+        }
+    }
+};
+#endif
@@ -0,0 +1,241 @@
+#ifndef NULL_GL_H
+#define NULL_GL_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "../Advanced OpenGL/state_cache.h"
+
+#include <cstdint>
+
+/*  A GL "driver" that does nothing, for running renderer code without a window or a GPU: the
+    benchmarks use it to time the CPU side of Mesh setup and drawing on a build machine.
+    loadNullGL() points the glad function pointers the renderer uses at stubs instead of calling
+    gladLoadGLLoader. Generated names count up from 1, fences are always signaled, shaders
+    always compile and link, uniform locations are a hash of the name, and queries stay
+    unloaded so the profiler's GPU scopes switch themselves off like they do headless.
+
+    The stubs count what was asked of them (nullGL()), which makes it easy to check that an
+    optimization really issues fewer calls. Nothing here is thread safe, just like a context. */
+struct NullGLCounters {
+    std::uint64_t calls = 0;        // every stubbed call
+    std::uint64_t draws = 0;        // glDraw*
+    std::uint64_t uploadBytes = 0;  // glBufferData / glBufferSubData
+    std::uint64_t uniformLookups = 0;
+    unsigned int nextName = 1;      // shared by every glGen* and glCreate*
+};
+
+inline NullGLCounters& nullGL()
+{
+    static NullGLCounters counters;
+    return counters;
+}
+
+namespace nullgl {
+
+inline void count()
+{
+    nullGL().calls++;
+}
+
+inline void APIENTRY genNames(GLsizei count, GLuint* names)
+{
+    nullgl::count();
+    for (GLsizei i = 0; i < count; i++)
+        names[i] = nullGL().nextName++;
+}
+
+inline void APIENTRY deleteNames(GLsizei, const GLuint*) { count(); }
+inline GLuint APIENTRY createObject() { count(); return nullGL().nextName++; }
+inline GLuint APIENTRY createShader(GLenum) { count(); return nullGL().nextName++; }
+inline void APIENTRY bindTarget(GLenum, GLuint) { count(); }
+inline void APIENTRY bindName(GLuint) { count(); }
+inline void APIENTRY setEnum(GLenum) { count(); }
+inline void APIENTRY setBoolean(GLboolean) { count(); }
+inline void APIENTRY setEnumPair(GLenum, GLenum) { count(); }
+inline void APIENTRY setBitfield(GLbitfield) { count(); }
+inline void APIENTRY setViewport(GLint, GLint, GLsizei, GLsizei) { count(); }
+inline void APIENTRY bindBufferBase(GLenum, GLuint, GLuint) { count(); }
+inline void APIENTRY bindBufferRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr) { count(); }
+
+inline void APIENTRY bufferData(GLenum, GLsizeiptr size, const void*, GLenum)
+{
+    count();
+    nullGL().uploadBytes += static_cast<std::uint64_t>(size);
+}
+
+inline void APIENTRY bufferSubData(GLenum, GLintptr, GLsizeiptr size, const void*)
+{
+    count();
+    nullGL().uploadBytes += static_cast<std::uint64_t>(size);
+}
+
+inline void APIENTRY vertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) { count(); }
+inline void APIENTRY vertexAttribIPointer(GLuint, GLint, GLenum, GLsizei, const void*) { count(); }
+
+inline void APIENTRY texImage2D(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*) { count(); }
+inline void APIENTRY texParameteri(GLenum, GLenum, GLint) { count(); }
+inline void APIENTRY texStorage2D(GLenum, GLsizei, GLenum, GLsizei, GLsizei) { count(); }
+inline void APIENTRY texSubImage2D(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void*) { count(); }
+inline void APIENTRY copyImageSubData(GLuint, GLenum, GLint, GLint, GLint, GLint, GLuint, GLenum, GLint, GLint, GLint, GLint,
+                                      GLsizei, GLsizei, GLsizei) { count(); }
+
+// a real driver hashes the name too, so the lookup isn't free here either
+inline GLint APIENTRY getUniformLocation(GLuint, const GLchar* name)
+{
+    count();
+    nullGL().uniformLookups++;
+    std::uint32_t hash = 2166136261u;
+    for (const char* c = name; *c; c++)
+        hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+    return static_cast<GLint>(hash & 0x7FFF);
+}
+
+inline void APIENTRY uniform1i(GLint, GLint) { count(); }
+inline void APIENTRY uniform1f(GLint, GLfloat) { count(); }
+inline void APIENTRY uniform3f(GLint, GLfloat, GLfloat, GLfloat) { count(); }
+inline void APIENTRY uniformVector(GLint, GLsizei, const GLfloat*) { count(); }
+inline void APIENTRY uniformMatrix(GLint, GLsizei, GLboolean, const GLfloat*) { count(); }
+
+inline void APIENTRY drawArrays(GLenum, GLint, GLsizei) { count(); nullGL().draws++; }
+inline void APIENTRY drawElements(GLenum, GLsizei, GLenum, const void*) { count(); nullGL().draws++; }
+inline void APIENTRY drawArraysInstanced(GLenum, GLint, GLsizei, GLsizei) { count(); nullGL().draws++; }
+inline void APIENTRY drawElementsInstancedBaseVertex(GLenum, GLsizei, GLenum, const void*, GLsizei, GLint)
+{
+    count();
+    nullGL().draws++;
+}
+
+// no extensions and no memory info: every integer query answers 0
+inline void APIENTRY getIntegerv(GLenum, GLint* data)
+{
+    count();
+    *data = 0;
+}
+
+inline const GLubyte* APIENTRY getString(GLenum)
+{
+    count();
+    return reinterpret_cast<const GLubyte*>("");
+}
+
+inline const GLubyte* APIENTRY getStringi(GLenum, GLuint)
+{
+    count();
+    return reinterpret_cast<const GLubyte*>("");
+}
+
+inline GLsync APIENTRY fenceSync(GLenum, GLbitfield)
+{
+    count();
+    // any non-null value will do, nobody looks behind it
+    return reinterpret_cast<GLsync>(static_cast<std::uintptr_t>(nullGL().nextName++));
+}
+
+inline GLenum APIENTRY clientWaitSync(GLsync, GLbitfield, GLuint64) { count(); return GL_ALREADY_SIGNALED; }
+inline void APIENTRY deleteSync(GLsync) { count(); }
+
+inline void APIENTRY shaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) { count(); }
+inline void APIENTRY attachShader(GLuint, GLuint) { count(); }
+inline void APIENTRY programParameteri(GLuint, GLenum, GLint) { count(); }
+
+// compile and link status are GL_TRUE, log lengths are 0
+inline void APIENTRY getObjectiv(GLuint, GLenum pname, GLint* params)
+{
+    count();
+    *params = (pname == GL_COMPILE_STATUS || pname == GL_LINK_STATUS) ? GL_TRUE : 0;
+}
+
+inline void APIENTRY getInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+{
+    count();
+    if (length)
+        *length = 0;
+    if (bufSize > 0)
+        infoLog[0] = '\0';
+}
+
+} // namespace nullgl
+
+// install the stubs; call instead of gladLoadGLLoader, never alongside a real context
+inline void loadNullGL()
+{
+    nullGL() = NullGLCounters();
+
+    glad_glGenBuffers = nullgl::genNames;
+    glad_glGenTextures = nullgl::genNames;
+    glad_glGenVertexArrays = nullgl::genNames;
+    glad_glDeleteBuffers = nullgl::deleteNames;
+    glad_glDeleteTextures = nullgl::deleteNames;
+    glad_glDeleteVertexArrays = nullgl::deleteNames;
+    glad_glCreateProgram = nullgl::createObject;
+    glad_glCreateShader = nullgl::createShader;
+    glad_glDeleteProgram = nullgl::bindName;
+    glad_glDeleteShader = nullgl::bindName;
+
+    glad_glBindBuffer = nullgl::bindTarget;
+    glad_glBindTexture = nullgl::bindTarget;
+    glad_glBindVertexArray = nullgl::bindName;
+    glad_glUseProgram = nullgl::bindName;
+    glad_glActiveTexture = nullgl::setEnum;
+    glad_glBindBufferBase = nullgl::bindBufferBase;
+    glad_glBindBufferRange = nullgl::bindBufferRange;
+
+    glad_glBufferData = nullgl::bufferData;
+    glad_glBufferSubData = nullgl::bufferSubData;
+    glad_glEnableVertexAttribArray = nullgl::bindName;
+    glad_glDisableVertexAttribArray = nullgl::bindName;
+    glad_glVertexAttribPointer = nullgl::vertexAttribPointer;
+    glad_glVertexAttribIPointer = nullgl::vertexAttribIPointer;
+
+    glad_glTexImage2D = nullgl::texImage2D;
+    glad_glTexParameteri = nullgl::texParameteri;
+    glad_glTexStorage2D = nullgl::texStorage2D;
+    glad_glTexSubImage2D = nullgl::texSubImage2D;
+    glad_glCopyImageSubData = nullgl::copyImageSubData;
+    glad_glGenerateMipmap = nullgl::setEnum;
+
+    glad_glGetUniformLocation = nullgl::getUniformLocation;
+    glad_glUniform1i = nullgl::uniform1i;
+    glad_glUniform1f = nullgl::uniform1f;
+    glad_glUniform3f = nullgl::uniform3f;
+    glad_glUniform2fv = nullgl::uniformVector;
+    glad_glUniform3fv = nullgl::uniformVector;
+    glad_glUniform4fv = nullgl::uniformVector;
+    glad_glUniformMatrix3fv = nullgl::uniformMatrix;
+    glad_glUniformMatrix4fv = nullgl::uniformMatrix;
+
+    glad_glDrawArrays = nullgl::drawArrays;
+    glad_glDrawElements = nullgl::drawElements;
+    glad_glDrawArraysInstanced = nullgl::drawArraysInstanced;
+    glad_glDrawElementsInstancedBaseVertex = nullgl::drawElementsInstancedBaseVertex;
+
+    glad_glEnable = nullgl::setEnum;
+    glad_glDisable = nullgl::setEnum;
+    glad_glDepthFunc = nullgl::setEnum;
+    glad_glDepthMask = nullgl::setBoolean;
+    glad_glBlendFunc = nullgl::setEnumPair;
+    glad_glClear = nullgl::setBitfield;
+    glad_glViewport = nullgl::setViewport;
+    glad_glGetIntegerv = nullgl::getIntegerv;
+    glad_glGetString = nullgl::getString;
+    glad_glGetStringi = nullgl::getStringi;
+
+    glad_glFenceSync = nullgl::fenceSync;
+    glad_glClientWaitSync = nullgl::clientWaitSync;
+    glad_glDeleteSync = nullgl::deleteSync;
+
+    glad_glShaderSource = nullgl::shaderSource;
+    glad_glCompileShader = nullgl::bindName;
+    glad_glAttachShader = nullgl::attachShader;
+    glad_glDetachShader = nullgl::attachShader;
+    glad_glLinkProgram = nullgl::bindName;
+    glad_glProgramParameteri = nullgl::programParameteri;
+    glad_glGetShaderiv = nullgl::getObjectiv;
+    glad_glGetProgramiv = nullgl::getObjectiv;
+    glad_glGetShaderInfoLog = nullgl::getInfoLog;
+    glad_glGetProgramInfoLog = nullgl::getInfoLog;
+
+    // the state cache may remember bindings from an earlier run
+    glState().Invalidate();
+}
+#endif
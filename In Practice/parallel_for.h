@@ -0,0 +1,15 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <cstddef>
+#include <functional>
+
+// runs body(begin, end) over [0, count) in chunks of about grain items, possibly on several threads
+using ParallelFor = std::function<void(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)>;
+
+inline void serialFor(size_t count, size_t, const std::function<void(size_t, size_t)>& body)
+{
+    if (count)
+        body(0, count);
+}
+#endif
@@ -0,0 +1,699 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*  Per-pass timing for the CPU and the GPU. A frame is bracketed by BeginFrame and EndFrame,
+    and inside it scopes are measured with
+
+        PROFILE_SCOPE("Cull");           // CPU time of the enclosing block, on any thread
+        PROFILE_GPU_SCOPE("Lighting");   // GPU time of the GL commands issued in the block
+
+    CPU scopes write to a ring buffer owned by their thread: no lock, no allocation, two clock
+    reads and a store. EndFrame drains every ring on the calling thread. GPU scopes put a
+    glQueryCounter timestamp at each end; the results are read a few frames later, once
+    GL_QUERY_RESULT_AVAILABLE says they are there, so the CPU never waits on the GPU.
+    Timestamps are used rather than GL_TIME_ELAPSED queries because those can't be nested.
+
+    Without a GL context (headless, or before gladLoadGLLoader) GPU scopes do nothing and the CPU
+    scopes keep working. Define PROFILER_DISABLED to compile every scope out.
+
+    Events can be written as Chrome trace JSON (chrome://tracing, Perfetto) or in a compact
+    binary form that can be turned into JSON later. */
+
+enum ProfileEventKind : std::uint8_t {
+    PROFILE_CPU = 0,
+    PROFILE_GPU = 1
+};
+
+struct ProfileEvent {
+    const char* name;      // must outlive the profiler, so string literals
+    std::uint64_t begin;   // nanoseconds since the profiler started
+    std::uint64_t end;
+    std::uint32_t frame;
+    std::uint16_t thread;  // index into ThreadNames(); GPU events use thread 0xFFFF
+    std::uint8_t depth;    // nesting on its thread
+    std::uint8_t kind;
+};
+
+// total time per scope name within one frame, for an on-screen readout
+struct ProfileTotal {
+    const char* name;
+    double cpuMilliseconds = 0.0;
+    double gpuMilliseconds = 0.0;
+    unsigned int calls = 0;
+};
+
+class Profiler {
+public:
+    static const std::uint32_t THREAD_CAPACITY = 16384; // CPU events buffered per thread between drains
+    static const std::uint32_t GPU_FRAMES = 4;          // frames of GPU queries in flight
+    static const std::uint32_t GPU_SCOPES = 64;         // GPU scopes per frame
+    static const std::uint16_t GPU_THREAD = 0xFFFF;
+    static const std::uint32_t CALIBRATE_FRAMES = 600;  // frames between GPU clock calibrations
+
+    Profiler()
+        : start(std::chrono::steady_clock::now())
+    {
+    }
+
+    // name the calling thread in exported traces
+    void SetThreadName(const std::string& name)
+    {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threadNames[buffer.index] = name;
+    }
+
+    void BeginFrame()
+    {
+        frameIndex++;
+        frameBegin = Now();
+        if (gpuAvailable())
+            beginGpuFrame();
+    }
+
+    // collects the finished CPU events of every thread and whatever GPU results have arrived
+    void EndFrame()
+    {
+        std::uint64_t frameEnd = Now();
+        if (gpuAvailable() && gpuRecording)
+            glQueryCounter(currentGpuFrame().frameEnd, GL_TIMESTAMP);
+        gpuRecording = false;
+
+        lastFrame.clear();
+        ProfileEvent frame = { "Frame", frameBegin, frameEnd, frameIndex, threadBuffer().index, 0, PROFILE_CPU };
+        store(frame);
+
+        std::vector<ThreadBuffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            for (const std::unique_ptr<ThreadBuffer>& buffer : threads)
+                buffers.push_back(buffer.get());
+        }
+        for (ThreadBuffer* buffer : buffers)
+        {
+            std::uint32_t read = buffer->read.load(std::memory_order_relaxed);
+            std::uint32_t write = buffer->write.load(std::memory_order_acquire);
+            for (; read != write; read++)
+                store(buffer->events[read % THREAD_CAPACITY]);
+            buffer->read.store(read, std::memory_order_release);
+        }
+        if (gpuAvailable())
+            resolveGpuFrames();
+    }
+
+    // start keeping every event for export, up to maxEvents
+    void StartCapture(size_t maxEvents = 4 * 1024 * 1024)
+    {
+        captured.clear();
+        captureLimit = maxEvents;
+        capturing = true;
+    }
+
+    void StopCapture()
+    {
+        capturing = false;
+    }
+
+    bool Capturing() const
+    {
+        return capturing;
+    }
+
+    const std::vector<ProfileEvent>& Captured() const
+    {
+        return captured;
+    }
+
+    // the events collected by the last EndFrame; GPU events there belong to an older frame
+    const std::vector<ProfileEvent>& LastFrame() const
+    {
+        return lastFrame;
+    }
+
+    // events lost because a thread's ring was full, a capture was full or every GPU frame was still in flight
+    size_t Dropped() const
+    {
+        size_t dropped = droppedEvents + droppedGpuFrames;
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : threads)
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        return dropped;
+    }
+
+    // CPU times of the last frame and the latest GPU times, summed per name in first-seen order
+    std::vector<ProfileTotal> Totals() const
+    {
+        std::vector<ProfileTotal> totals;
+        std::map<std::string, size_t> slots;
+        auto add = [&](const ProfileEvent& event) {
+            std::map<std::string, size_t>::iterator slot = slots.find(event.name);
+            if (slot == slots.end())
+            {
+                slot = slots.emplace(event.name, totals.size()).first;
+                ProfileTotal total;
+                total.name = event.name;
+                totals.push_back(total);
+            }
+            double milliseconds = (event.end - event.begin) / 1e6;
+            if (event.kind == PROFILE_GPU)
+                totals[slot->second].gpuMilliseconds += milliseconds;
+            else
+            {
+                totals[slot->second].cpuMilliseconds += milliseconds;
+                totals[slot->second].calls++;
+            }
+        };
+        for (const ProfileEvent& event : lastFrame)
+            if (event.kind == PROFILE_CPU)
+                add(event);
+        for (const ProfileEvent& event : lastGpuFrame)
+            add(event);
+        return totals;
+    }
+
+    std::vector<std::string> ThreadNames() const
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        return threadNames;
+    }
+
+    std::uint64_t Now() const
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // used by ProfileScope; the event is only stored when the scope ends
+    std::uint8_t BeginCpu()
+    {
+        return threadBuffer().depth++;
+    }
+
+    void EndCpu(const char* name, std::uint64_t begin, std::uint8_t depth)
+    {
+        ThreadBuffer& buffer = threadBuffer();
+        buffer.depth = depth;
+        std::uint32_t write = buffer.write.load(std::memory_order_relaxed);
+        if (write - buffer.read.load(std::memory_order_acquire) >= THREAD_CAPACITY)
+        {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ProfileEvent& event = buffer.events[write % THREAD_CAPACITY];
+        event.name = name;
+        event.begin = begin;
+        event.end = Now();
+        event.frame = frameIndex;
+        event.thread = buffer.index;
+        event.depth = depth;
+        event.kind = PROFILE_CPU;
+        buffer.write.store(write + 1, std::memory_order_release);
+    }
+
+    // used by GpuProfileScope; returns the scope's slot or -1 when GPU timing is off this frame
+    int BeginGpu(const char* name)
+    {
+        if (!gpuRecording)
+            return -1;
+        GpuFrame& frame = currentGpuFrame();
+        if (frame.count >= GPU_SCOPES)
+            return -1;
+        int slot = static_cast<int>(frame.count++);
+        frame.names[slot] = name;
+        frame.depths[slot] = gpuDepth++;
+        glQueryCounter(frame.queries[slot * 2], GL_TIMESTAMP);
+        return slot;
+    }
+
+    void EndGpu(int slot)
+    {
+        if (slot < 0 || !gpuRecording)
+            return;
+        gpuDepth--;
+        glQueryCounter(currentGpuFrame().queries[slot * 2 + 1], GL_TIMESTAMP);
+    }
+
+    /*  Chrome trace format: complete ("X") events in microseconds, one row per thread and one for
+        the GPU. GPU timestamps are moved onto the CPU clock with the offset measured at the start
+        of their frame, so passes line up with the CPU work that issued them (give or take the
+        driver's queueing). */
+    static bool WriteChromeTrace(const std::string& path, const std::vector<ProfileEvent>& events, const std::vector<std::string>& threadNames)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER::FAILED_TO_OPEN: " << path << std::endl;
+            return false;
+        }
+        file << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (size_t i = 0; i < threadNames.size(); i++)
+        {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i
+                 << ",\"args\":{\"name\":\"" << escape(threadNames[i]) << "\"}}";
+            first = false;
+        }
+        file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_THREAD
+             << ",\"args\":{\"name\":\"GPU\"}}";
+        char number[64];
+        for (const ProfileEvent& event : events)
+        {
+            std::snprintf(number, sizeof(number), "%.3f,\"dur\":%.3f", event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+            file << ",\n{\"name\":\"" << escape(event.name) << "\",\"cat\":\"" << (event.kind == PROFILE_GPU ? "gpu" : "cpu")
+                 << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread << ",\"ts\":" << number
+                 << ",\"args\":{\"frame\":" << event.frame << "}}";
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+
+    bool WriteChromeTrace(const std::string& path) const
+    {
+        return WriteChromeTrace(path, captured, ThreadNames());
+    }
+
+    /*  Binary capture: a header, the thread names, the distinct scope names and then 24 bytes
+        per event, with the name as an index into the name table and times relative to the first
+        event. About a fifth of the JSON size and quick to write in the middle of a session. */
+    bool WriteBinary(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER::FAILED_TO_OPEN: " << path << std::endl;
+            return false;
+        }
+        std::vector<const char*> names;
+        std::map<const char*, std::uint32_t> nameIndex;
+        std::uint64_t origin = captured.empty() ? 0 : captured[0].begin;
+        for (const ProfileEvent& event : captured)
+        {
+            origin = std::min(origin, event.begin);
+            if (nameIndex.emplace(event.name, static_cast<std::uint32_t>(names.size())).second)
+                names.push_back(event.name);
+        }
+
+        std::vector<std::string> threadNames = ThreadNames();
+        file.write("PROF", 4);
+        writeValue<std::uint32_t>(file, 1); // version
+        writeValue<std::uint64_t>(file, origin);
+        writeValue<std::uint32_t>(file, static_cast<std::uint32_t>(threadNames.size()));
+        for (const std::string& name : threadNames)
+            writeString(file, name);
+        writeValue<std::uint32_t>(file, static_cast<std::uint32_t>(names.size()));
+        for (const char* name : names)
+            writeString(file, name);
+        writeValue<std::uint64_t>(file, captured.size());
+        for (const ProfileEvent& event : captured)
+        {
+            writeValue<std::uint32_t>(file, nameIndex[event.name]);
+            writeValue<std::uint64_t>(file, event.begin - origin);
+            writeValue<std::uint32_t>(file, static_cast<std::uint32_t>(std::min<std::uint64_t>(event.end - event.begin, 0xFFFFFFFFu)));
+            writeValue<std::uint32_t>(file, event.frame);
+            writeValue<std::uint16_t>(file, event.thread);
+            writeValue<std::uint8_t>(file, event.depth);
+            writeValue<std::uint8_t>(file, event.kind);
+        }
+        return static_cast<bool>(file);
+    }
+
+    // a binary capture read back for conversion; the events point into the returned name storage
+    struct Capture {
+        std::vector<std::string> threadNames;
+        std::vector<std::unique_ptr<std::string>> names;
+        std::vector<ProfileEvent> events;
+    };
+
+    static bool ReadBinary(const std::string& path, Capture& capture)
+    {
+        std::ifstream file(path, std::ios::binary);
+        char magic[4] = {};
+        file.read(magic, 4);
+        std::uint32_t version = 0;
+        readValue(file, version);
+        if (!file || std::memcmp(magic, "PROF", 4) != 0 || version != 1)
+        {
+            std::cout << "ERROR::PROFILER::NOT_A_CAPTURE: " << path << std::endl;
+            return false;
+        }
+        std::uint64_t origin = 0, eventCount = 0;
+        std::uint32_t threadCount = 0, nameCount = 0;
+        readValue(file, origin);
+        readValue(file, threadCount);
+        capture.threadNames.resize(threadCount);
+        for (std::string& name : capture.threadNames)
+            readString(file, name);
+        readValue(file, nameCount);
+        capture.names.clear();
+        for (std::uint32_t i = 0; i < nameCount && file; i++)
+        {
+            capture.names.emplace_back(new std::string());
+            readString(file, *capture.names.back());
+        }
+        readValue(file, eventCount);
+        capture.events.clear();
+        for (std::uint64_t i = 0; i < eventCount && file; i++)
+        {
+            std::uint32_t name = 0, duration = 0;
+            std::uint64_t begin = 0;
+            ProfileEvent event;
+            readValue(file, name);
+            readValue(file, begin);
+            readValue(file, duration);
+            readValue(file, event.frame);
+            readValue(file, event.thread);
+            readValue(file, event.depth);
+            readValue(file, event.kind);
+            if (name >= capture.names.size())
+                break;
+            event.name = capture.names[name]->c_str();
+            event.begin = origin + begin;
+            event.end = event.begin + duration;
+            capture.events.push_back(event);
+        }
+        return static_cast<bool>(file);
+    }
+
+private:
+    struct ThreadBuffer {
+        // single producer (the owning thread), single consumer (whoever calls EndFrame)
+        alignas(64) std::atomic<std::uint32_t> write{ 0 };
+        alignas(64) std::atomic<std::uint32_t> read{ 0 };
+        std::atomic<size_t> dropped{ 0 };
+        std::atomic<bool> retired{ false }; // its thread has exited
+        std::uint16_t index = 0;
+        std::uint8_t depth = 0;
+        ProfileEvent events[THREAD_CAPACITY];
+    };
+
+    struct GpuFrame {
+        GLuint queries[GPU_SCOPES * 2];
+        GLuint frameBegin = 0, frameEnd = 0;
+        const char* names[GPU_SCOPES];
+        std::uint8_t depths[GPU_SCOPES];
+        std::uint32_t count = 0;
+        std::uint32_t frame = 0;
+        std::uint64_t issued = 0; // our clock when frameBegin was queued; the GPU can't get to it earlier
+        bool pending = false;
+    };
+
+    std::chrono::steady_clock::time_point start;
+    std::atomic<std::uint32_t> frameIndex{ 0 };
+    std::uint64_t frameBegin = 0;
+
+    mutable std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+    std::vector<std::string> threadNames;
+
+    std::vector<ProfileEvent> lastFrame;
+    std::vector<ProfileEvent> lastGpuFrame;
+    std::vector<ProfileEvent> captured;
+    size_t captureLimit = 0;
+    bool capturing = false;
+    size_t droppedEvents = 0;
+
+    std::unique_ptr<GpuFrame[]> gpuFrames;
+    std::uint32_t gpuFrameIndex = 0;
+    std::uint8_t gpuDepth = 0;
+    bool gpuRecording = false;
+    size_t droppedGpuFrames = 0;
+    std::int64_t gpuOffset = 0; // CPU clock minus GPU clock, in nanoseconds
+    bool calibrated = false;
+    std::uint32_t calibratedFrame = 0;
+
+    // marks the ring of a thread as free for reuse when the thread exits
+    struct ThreadRegistration {
+        const Profiler* owner = nullptr;
+        ThreadBuffer* buffer = nullptr;
+
+        ~ThreadRegistration()
+        {
+            if (buffer)
+                buffer->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    ThreadBuffer& threadBuffer()
+    {
+        // one ring per thread and profiler; threads register on their first scope
+        thread_local ThreadRegistration registration;
+        if (registration.owner != this)
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            ThreadBuffer* buffer = nullptr;
+            // take over the ring of a thread that has exited once all its events were collected
+            for (const std::unique_ptr<ThreadBuffer>& candidate : threads)
+                if (candidate->retired.load(std::memory_order_acquire) &&
+                    candidate->read.load(std::memory_order_acquire) == candidate->write.load(std::memory_order_relaxed))
+                {
+                    buffer = candidate.get();
+                    break;
+                }
+            if (!buffer)
+            {
+                threads.emplace_back(new ThreadBuffer());
+                buffer = threads.back().get();
+                buffer->index = static_cast<std::uint16_t>(threads.size() - 1);
+                threadNames.push_back(std::string());
+            }
+            buffer->retired.store(false, std::memory_order_relaxed);
+            buffer->depth = 0;
+            threadNames[buffer->index] = buffer->index == 0 ? "Main" : "Thread " + std::to_string(buffer->index);
+            registration.owner = this;
+            registration.buffer = buffer;
+        }
+        return *registration.buffer;
+    }
+
+    void store(const ProfileEvent& event)
+    {
+        lastFrame.push_back(event);
+        if (!capturing)
+            return;
+        if (captured.size() < captureLimit)
+            captured.push_back(event);
+        else
+            droppedEvents++;
+    }
+
+    // glad leaves the function pointers null until a context is loaded
+    static bool gpuAvailable()
+    {
+        return glQueryCounter != nullptr && glGetQueryObjectui64v != nullptr;
+    }
+
+    GpuFrame& currentGpuFrame()
+    {
+        return gpuFrames[gpuFrameIndex % GPU_FRAMES];
+    }
+
+    void beginGpuFrame()
+    {
+        if (!gpuFrames)
+        {
+            gpuFrames.reset(new GpuFrame[GPU_FRAMES]);
+            for (std::uint32_t i = 0; i < GPU_FRAMES; i++)
+            {
+                glGenQueries(GPU_SCOPES * 2, gpuFrames[i].queries);
+                glGenQueries(1, &gpuFrames[i].frameBegin);
+                glGenQueries(1, &gpuFrames[i].frameEnd);
+            }
+        }
+        resolveGpuFrames();
+
+        gpuFrameIndex++;
+        GpuFrame& frame = currentGpuFrame();
+        if (frame.pending)
+        {
+            // the GPU is more than GPU_FRAMES behind; skip timing this frame rather than wait
+            droppedGpuFrames++;
+            gpuRecording = false;
+            return;
+        }
+        if (!calibrated || frameIndex - calibratedFrame >= CALIBRATE_FRAMES)
+            calibrate();
+        frame.count = 0;
+        frame.frame = frameIndex;
+        frame.pending = true;
+        gpuDepth = 0;
+        gpuRecording = true;
+        frame.issued = Now();
+        glQueryCounter(frame.frameBegin, GL_TIMESTAMP);
+    }
+
+    // measure the GPU clock against ours. The query is synchronous, a round trip to the GPU, so it
+    // runs at the first frame, every CALIBRATE_FRAMES after that, and when resolveGpuFrames sees
+    // the clocks drift apart
+    void calibrate()
+    {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuOffset = static_cast<std::int64_t>(Now()) - static_cast<std::int64_t>(gpuNow);
+        calibrated = true;
+        calibratedFrame = frameIndex;
+    }
+
+    // read every frame whose last query has finished, oldest first, without waiting for any
+    void resolveGpuFrames()
+    {
+        if (!gpuFrames)
+            return;
+        for (std::uint32_t i = 1; i <= GPU_FRAMES; i++)
+        {
+            GpuFrame& frame = gpuFrames[(gpuFrameIndex + i) % GPU_FRAMES];
+            if (!frame.pending || (gpuRecording && &frame == &currentGpuFrame()))
+                continue;
+            GLuint available = 0;
+            glGetQueryObjectuiv(frame.frameEnd, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break; // later frames can't be done either
+            lastGpuFrame.clear();
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.frameBegin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.frameEnd, GL_QUERY_RESULT, &end);
+            // a frame that seems to start before it was queued, or end after now, means the offset drifted
+            if (toCpu(begin) < frame.issued || toCpu(end) > Now())
+                calibrated = false;
+            storeGpu({ "GPU Frame", toCpu(begin), toCpu(end), frame.frame, GPU_THREAD, 0, PROFILE_GPU });
+            for (std::uint32_t s = 0; s < frame.count; s++)
+            {
+                glGetQueryObjectui64v(frame.queries[s * 2], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.queries[s * 2 + 1], GL_QUERY_RESULT, &end);
+                storeGpu({ frame.names[s], toCpu(begin), toCpu(end), frame.frame, GPU_THREAD, static_cast<std::uint8_t>(frame.depths[s] + 1), PROFILE_GPU });
+            }
+            frame.pending = false;
+        }
+    }
+
+    void storeGpu(const ProfileEvent& event)
+    {
+        lastGpuFrame.push_back(event);
+        if (capturing && captured.size() < captureLimit)
+            captured.push_back(event);
+        else if (capturing)
+            droppedEvents++;
+    }
+
+    std::uint64_t toCpu(GLuint64 gpuTime) const
+    {
+        std::int64_t time = static_cast<std::int64_t>(gpuTime) + gpuOffset;
+        return time < 0 ? 0 : static_cast<std::uint64_t>(time);
+    }
+
+    static std::string escape(const std::string& text)
+    {
+        std::string result;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20)
+                result += c;
+        }
+        return result;
+    }
+
+    template <typename T>
+    static void writeValue(std::ofstream& file, T value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static void readValue(std::ifstream& file, T& value)
+    {
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    static void writeString(std::ofstream& file, const std::string& text)
+    {
+        writeValue<std::uint32_t>(file, static_cast<std::uint32_t>(text.size()));
+        file.write(text.data(), text.size());
+    }
+
+    static void readString(std::ifstream& file, std::string& text)
+    {
+        std::uint32_t size = 0;
+        readValue(file, size);
+        if (!file || size > (1u << 20))
+        {
+            file.setstate(std::ios::failbit);
+            return;
+        }
+        text.resize(size);
+        file.read(&text[0], size);
+    }
+};
+
+inline Profiler& profiler()
+{
+    static Profiler instance;
+    return instance;
+}
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name)
+        : name(name), depth(profiler().BeginCpu()), begin(profiler().Now())
+    {
+    }
+
+    ~ProfileScope()
+    {
+        profiler().EndCpu(name, begin, depth);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    std::uint8_t depth;
+    std::uint64_t begin;
+};
+
+// GPU scopes must be opened and closed on the GL thread, between BeginFrame and EndFrame
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name)
+        : slot(profiler().BeginGpu(name))
+    {
+    }
+
+    ~GpuProfileScope()
+    {
+        profiler().EndGpu(slot);
+    }
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    int slot;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#ifndef PROFILER_DISABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#endif
+#endif
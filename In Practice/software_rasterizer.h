@@ -0,0 +1,626 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <glm/glm.hpp>
+
+#include "parallel_for.h"
+#include "../Lighting/lighting.h"
+#include "../Model Loading/matrix_simd.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFTWARE_RASTERIZER_SSE
+#endif
+
+/*  A CPU implementation of the small part of OpenGL the tutorials use, for machines without a GPU:
+    indexed and non-indexed triangle drawing, a depth buffer with every glDepthFunc comparison,
+    back-face culling and the Phong lighting of lighting.glsl (through its C++ twin lighting.h). It
+    doesn't need a GL context, glad or a window, so the same scene can be rendered headless and
+    compared against a stored golden image, and the time spent in each stage can be tracked.
+
+    Each draw runs in three stages, each split over a ParallelFor:
+        vertices    transformed to clip space, world space and normal space
+        setup       triangles clipped against the near plane, culled, turned into edge equations
+                    and put into the bin of every 64x64 tile they touch
+        raster      every tile walks its bin in submission order and evaluates the edge functions
+                    for four pixels at a time with SSE, depth tests and shades what passes
+    A tile is only ever touched by one thread and triangles reach it in draw order, so the image is
+    the same for any number of threads. */
+
+// the values match GL_NEVER .. GL_ALWAYS, so glDepthFunc arguments can be passed as they are
+enum DepthFunction {
+    DEPTH_NEVER    = 0x0200,
+    DEPTH_LESS     = 0x0201,
+    DEPTH_EQUAL    = 0x0202,
+    DEPTH_LEQUAL   = 0x0203,
+    DEPTH_GREATER  = 0x0204,
+    DEPTH_NOTEQUAL = 0x0205,
+    DEPTH_GEQUAL   = 0x0206,
+    DEPTH_ALWAYS   = 0x0207
+};
+
+inline bool depthPasses(unsigned int function, float incoming, float stored)
+{
+    switch (function)
+    {
+    case DEPTH_NEVER:    return false;
+    case DEPTH_LESS:     return incoming < stored;
+    case DEPTH_EQUAL:    return incoming == stored;
+    case DEPTH_LEQUAL:   return incoming <= stored;
+    case DEPTH_GREATER:  return incoming > stored;
+    case DEPTH_NOTEQUAL: return incoming != stored;
+    case DEPTH_GEQUAL:   return incoming >= stored;
+    default:             return true;
+    }
+}
+
+// RGBA8 texture with repeat wrapping and bilinear filtering
+struct SoftwareTexture {
+    int width = 0;
+    int height = 0;
+    std::vector<glm::vec4> texels; // linear 0..1, row 0 at the bottom like a GL texture
+
+    bool Load(const std::string& path)
+    {
+        int components;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &components, 4);
+        if (!data)
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return false;
+        }
+        // stb loads top row first; GL textures and texture coordinates start at the bottom. The rows
+        // are flipped here rather than with stbi_set_flip_vertically_on_load, which is global
+        texels.resize(size_t(width) * height);
+        for (int y = 0; y < height; y++)
+        {
+            const unsigned char* row = data + size_t(height - 1 - y) * width * 4;
+            for (int x = 0; x < width; x++)
+                texels[size_t(y) * width + x] = glm::vec4(row[x * 4], row[x * 4 + 1], row[x * 4 + 2], row[x * 4 + 3]) / 255.0f;
+        }
+        stbi_image_free(data);
+        return true;
+    }
+
+    glm::vec4 Sample(const glm::vec2& uv) const
+    {
+        if (texels.empty())
+            return glm::vec4(1.0f);
+        float x = uv.x * width - 0.5f;
+        float y = uv.y * height - 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        float tx = x - fx, ty = y - fy;
+        int x0 = wrap(static_cast<int>(fx), width), x1 = wrap(static_cast<int>(fx) + 1, width);
+        int y0 = wrap(static_cast<int>(fy), height), y1 = wrap(static_cast<int>(fy) + 1, height);
+        glm::vec4 bottom = glm::mix(texels[size_t(y0) * width + x0], texels[size_t(y0) * width + x1], tx);
+        glm::vec4 top = glm::mix(texels[size_t(y1) * width + x0], texels[size_t(y1) * width + x1], tx);
+        return glm::mix(bottom, top, ty);
+    }
+
+private:
+    static int wrap(int i, int size)
+    {
+        i %= size;
+        return i < 0 ? i + size : i;
+    }
+};
+
+// the uniforms of the lighting shaders: colors are used where no map is given
+struct SoftwareMaterial {
+    glm::vec3 diffuse = glm::vec3(1.0f);
+    glm::vec3 specular = glm::vec3(0.5f);
+    float shininess = 32.0f;
+    const SoftwareTexture* diffuseMap = nullptr;
+    const SoftwareTexture* specularMap = nullptr;
+    bool unlit = false; // output the diffuse color as is, like the light cube shader
+};
+
+struct SoftwareLights {
+    std::vector<DirLight> dirLights;
+    std::vector<PointLight> pointLights;
+    std::vector<SpotLight> spotLights;
+};
+
+// color and depth; row 0 is the bottom row, as in GL
+struct SoftwareFramebuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint32_t> color; // RGBA8, R in the lowest byte
+    std::vector<float> depth;
+
+    void Resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        color.assign(size_t(width) * height, 0);
+        depth.assign(size_t(width) * height, 1.0f);
+    }
+
+    // binary PPM, top row first so image viewers show it the right way up
+    bool WritePPM(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "P6\n" << width << " " << height << "\n255\n";
+        std::vector<unsigned char> row(size_t(width) * 3);
+        for (int y = height - 1; y >= 0; y--)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                std::uint32_t c = color[size_t(y) * width + x];
+                row[x * 3 + 0] = c & 0xFF;
+                row[x * 3 + 1] = (c >> 8) & 0xFF;
+                row[x * 3 + 2] = (c >> 16) & 0xFF;
+            }
+            file.write(reinterpret_cast<const char*>(row.data()), row.size());
+        }
+        return static_cast<bool>(file);
+    }
+
+    bool ReadPPM(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string magic;
+        int maximum;
+        file >> magic >> width >> height >> maximum;
+        file.get();
+        if (!file || magic != "P6" || maximum != 255 || width <= 0 || height <= 0)
+            return false;
+        Resize(width, height);
+        std::vector<unsigned char> row(size_t(width) * 3);
+        for (int y = height - 1; y >= 0; y--)
+        {
+            file.read(reinterpret_cast<char*>(row.data()), row.size());
+            for (int x = 0; x < width; x++)
+                color[size_t(y) * width + x] = row[x * 3] | (row[x * 3 + 1] << 8) | (row[x * 3 + 2] << 16) | 0xFF000000u;
+        }
+        return static_cast<bool>(file);
+    }
+};
+
+struct ImageDifference {
+    size_t differentPixels = 0; // pixels where a channel differs by more than the tolerance
+    int maxChannelDifference = 0;
+};
+
+// compare against a golden image; a size mismatch counts every pixel as different
+inline ImageDifference compareImages(const SoftwareFramebuffer& a, const SoftwareFramebuffer& b, int tolerance = 0)
+{
+    ImageDifference difference;
+    if (a.width != b.width || a.height != b.height)
+    {
+        difference.differentPixels = std::max(a.color.size(), b.color.size());
+        difference.maxChannelDifference = 255;
+        return difference;
+    }
+    for (size_t i = 0; i < a.color.size(); i++)
+    {
+        int worst = 0;
+        for (int shift = 0; shift < 24; shift += 8)
+            worst = std::max(worst, std::abs(int((a.color[i] >> shift) & 0xFF) - int((b.color[i] >> shift) & 0xFF)));
+        difference.maxChannelDifference = std::max(difference.maxChannelDifference, worst);
+        if (worst > tolerance)
+            difference.differentPixels++;
+    }
+    return difference;
+}
+
+struct SoftwareStats {
+    size_t draws = 0;
+    size_t trianglesSubmitted = 0;
+    size_t trianglesCulled = 0;   // back faces, zero area and triangles completely off screen
+    size_t trianglesClipped = 0;  // crossed the near plane
+    size_t fragmentsTested = 0;
+    size_t fragmentsShaded = 0;
+    double vertexMilliseconds = 0.0;
+    double setupMilliseconds = 0.0;
+    double rasterMilliseconds = 0.0;
+};
+
+class SoftwareRasterizer {
+public:
+    static const int TILE_SIZE = 64;
+
+    // the state the GL versions set with uniforms and glEnable
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    SoftwareLights lights;
+    bool depthTest = true;
+    bool depthMask = true;
+    unsigned int depthFunc = DEPTH_LESS;
+    bool cullBackFaces = false; // counter-clockwise is front, as in GL
+    SoftwareStats stats;
+
+    SoftwareRasterizer(int width, int height, const ParallelFor& parallelFor = serialFor)
+        : parallelFor(parallelFor)
+    {
+        Resize(width, height);
+    }
+
+    void Resize(int width, int height)
+    {
+        framebuffer.Resize(width, height);
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    }
+
+    const SoftwareFramebuffer& Framebuffer() const
+    {
+        return framebuffer;
+    }
+
+    // glClearColor + glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT)
+    void Clear(const glm::vec4& color, float depth = 1.0f)
+    {
+        std::fill(framebuffer.color.begin(), framebuffer.color.end(), packColor(color));
+        std::fill(framebuffer.depth.begin(), framebuffer.depth.end(), depth);
+    }
+
+    // any vertex type with Position, Normal and TexCoords members, such as Mesh's Vertex
+    template <typename VertexType>
+    void DrawIndexed(const std::vector<VertexType>& vertices, const std::vector<unsigned int>& indices,
+                     const glm::mat4& model, const SoftwareMaterial& material)
+    {
+        inputs.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            inputs[i] = { vertices[i].Position, vertices[i].Normal, vertices[i].TexCoords };
+        draw(indices.data(), indices.size(), model, material);
+    }
+
+    // the interleaved arrays of the tutorials: position, normal and texture coordinates, stride in floats
+    void DrawArrays(const float* data, size_t vertexCount, const glm::mat4& model, const SoftwareMaterial& material, int stride = 8)
+    {
+        inputs.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const float* v = data + i * stride;
+            inputs[i].position = glm::vec3(v[0], v[1], v[2]);
+            inputs[i].normal = stride >= 6 ? glm::vec3(v[3], v[4], v[5]) : glm::vec3(0.0f, 0.0f, 1.0f);
+            inputs[i].uv = stride >= 8 ? glm::vec2(v[6], v[7]) : glm::vec2(0.0f);
+        }
+        draw(nullptr, vertexCount, model, material);
+    }
+
+private:
+    struct InputVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 uv;
+    };
+
+    struct TransformedVertex {
+        glm::vec4 clip;
+        glm::vec3 world;
+        glm::vec3 normal;
+        glm::vec2 uv;
+    };
+
+    // a screen-space triangle ready for rasterization
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3]; // E(x, y) = A x + B y + C, >= 0 inside
+        bool topLeft[3];
+        float z[3];                         // window depth, 0..1
+        float invW[3];
+        TransformedVertex vertices[3];      // attributes, divided by w
+        int minX, minY, maxX, maxY;
+        float inverseArea;
+    };
+
+    SoftwareFramebuffer framebuffer;
+    ParallelFor parallelFor;
+    int tilesX = 0, tilesY = 0;
+
+    std::vector<InputVertex> inputs;
+    std::vector<TransformedVertex> transformed;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<std::vector<std::uint32_t>>> bins; // [chunk][tile] -> triangle indices
+
+    static std::uint32_t packColor(const glm::vec4& color)
+    {
+        glm::vec4 c = glm::clamp(color, glm::vec4(0.0f), glm::vec4(1.0f)) * 255.0f + 0.5f;
+        return std::uint32_t(c.x) | (std::uint32_t(c.y) << 8) | (std::uint32_t(c.z) << 16) | (std::uint32_t(c.w) << 24);
+    }
+
+    static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void draw(const unsigned int* indices, size_t indexCount, const glm::mat4& model, const SoftwareMaterial& material)
+    {
+        stats.draws++;
+        const size_t triangleCount = indexCount / 3;
+        stats.trianglesSubmitted += triangleCount;
+
+        // vertices
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        glm::mat4 viewProjection, modelViewProjection;
+        multiplyMat4(projection, view, viewProjection);
+        multiplyMat4(viewProjection, model, modelViewProjection);
+        glm::mat3 normalTransform = normalMatrix(model);
+        transformed.resize(inputs.size());
+        parallelFor(inputs.size(), 4096, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                glm::vec4 position(inputs[i].position, 1.0f);
+                transformed[i].clip = modelViewProjection * position;
+                transformed[i].world = glm::vec3(model * position);
+                transformed[i].normal = normalTransform * inputs[i].normal;
+                transformed[i].uv = inputs[i].uv;
+            }
+        });
+        stats.vertexMilliseconds += millisecondsSince(start);
+
+        // setup and binning; every chunk has its own bins, so no locks, and chunks stay in order
+        start = std::chrono::high_resolution_clock::now();
+        const size_t grain = 1024;
+        const size_t chunks = (triangleCount + grain - 1) / grain;
+        const size_t tileCount = size_t(tilesX) * tilesY;
+        // near plane clipping can turn one triangle into two
+        triangles.resize(triangleCount * 2);
+        bins.resize(std::max(bins.size(), chunks));
+        std::vector<size_t> culled(chunks, 0), clipped(chunks, 0);
+        parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++)
+            {
+                std::vector<std::vector<std::uint32_t>>& chunkBins = bins[chunk];
+                chunkBins.resize(tileCount);
+                for (std::vector<std::uint32_t>& bin : chunkBins)
+                    bin.clear();
+                size_t last = std::min(triangleCount, (chunk + 1) * grain);
+                for (size_t t = chunk * grain; t < last; t++)
+                {
+                    const TransformedVertex* corners[3];
+                    for (int k = 0; k < 3; k++)
+                        corners[k] = &transformed[indices ? indices[t * 3 + k] : t * 3 + k];
+                    setupTriangle(corners, t, chunkBins, culled[chunk], clipped[chunk]);
+                }
+            }
+        });
+        for (size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            stats.trianglesCulled += culled[chunk];
+            stats.trianglesClipped += clipped[chunk];
+        }
+        stats.setupMilliseconds += millisecondsSince(start);
+
+        // raster, one tile per job
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<size_t> tested(tileCount, 0), shaded(tileCount, 0);
+        parallelFor(tileCount, 1, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; tile++)
+                rasterTile(tile, chunks, material, tested[tile], shaded[tile]);
+        });
+        for (size_t tile = 0; tile < tileCount; tile++)
+        {
+            stats.fragmentsTested += tested[tile];
+            stats.fragmentsShaded += shaded[tile];
+        }
+        stats.rasterMilliseconds += millisecondsSince(start);
+    }
+
+    static TransformedVertex lerpVertex(const TransformedVertex& a, const TransformedVertex& b, float t)
+    {
+        TransformedVertex v;
+        v.clip = glm::mix(a.clip, b.clip, t);
+        v.world = glm::mix(a.world, b.world, t);
+        v.normal = glm::mix(a.normal, b.normal, t);
+        v.uv = glm::mix(a.uv, b.uv, t);
+        return v;
+    }
+
+    // clip against the near plane (z >= -w), then set up the one or two resulting triangles
+    void setupTriangle(const TransformedVertex* corners[3], size_t index, std::vector<std::vector<std::uint32_t>>& chunkBins,
+                       size_t& culled, size_t& clipped)
+    {
+        float distance[3];
+        int inside = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            distance[k] = corners[k]->clip.z + corners[k]->clip.w;
+            inside += distance[k] >= 0.0f;
+        }
+        if (inside == 0)
+        {
+            culled++;
+            return;
+        }
+        if (inside == 3)
+        {
+            if (!setupClipped(*corners[0], *corners[1], *corners[2], triangles[index * 2], chunkBins, static_cast<std::uint32_t>(index * 2)))
+                culled++;
+            return;
+        }
+
+        clipped++;
+        TransformedVertex polygon[4];
+        int count = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            const TransformedVertex& a = *corners[k];
+            const TransformedVertex& b = *corners[(k + 1) % 3];
+            float da = distance[k], db = distance[(k + 1) % 3];
+            if (da >= 0.0f)
+                polygon[count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                polygon[count++] = lerpVertex(a, b, da / (da - db));
+        }
+        bool any = setupClipped(polygon[0], polygon[1], polygon[2], triangles[index * 2], chunkBins, static_cast<std::uint32_t>(index * 2));
+        if (count == 4)
+            any |= setupClipped(polygon[0], polygon[2], polygon[3], triangles[index * 2 + 1], chunkBins, static_cast<std::uint32_t>(index * 2 + 1));
+        if (!any)
+            culled++;
+    }
+
+    // project, cull and compute the edge equations; false if nothing of it can be visible
+    bool setupClipped(const TransformedVertex& v0, const TransformedVertex& v1, const TransformedVertex& v2, Triangle& triangle,
+                      std::vector<std::vector<std::uint32_t>>& chunkBins, std::uint32_t triangleIndex)
+    {
+        const TransformedVertex* v[3] = { &v0, &v1, &v2 };
+        float sx[3], sy[3];
+        for (int k = 0; k < 3; k++)
+        {
+            float invW = 1.0f / v[k]->clip.w;
+            sx[k] = (v[k]->clip.x * invW * 0.5f + 0.5f) * framebuffer.width;
+            sy[k] = (v[k]->clip.y * invW * 0.5f + 0.5f) * framebuffer.height;
+            triangle.z[k] = v[k]->clip.z * invW * 0.5f + 0.5f;
+            triangle.invW[k] = invW;
+            triangle.vertices[k].world = v[k]->world * invW;
+            triangle.vertices[k].normal = v[k]->normal * invW;
+            triangle.vertices[k].uv = v[k]->uv * invW;
+        }
+
+        float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+        if (area == 0.0f || (cullBackFaces && area < 0.0f))
+            return false;
+
+        float minX = std::min(sx[0], std::min(sx[1], sx[2])), maxX = std::max(sx[0], std::max(sx[1], sx[2]));
+        float minY = std::min(sy[0], std::min(sy[1], sy[2])), maxY = std::max(sy[0], std::max(sy[1], sy[2]));
+        triangle.minX = std::max(0, static_cast<int>(std::floor(minX)));
+        triangle.minY = std::max(0, static_cast<int>(std::floor(minY)));
+        triangle.maxX = std::min(framebuffer.width - 1, static_cast<int>(std::ceil(maxX)));
+        triangle.maxY = std::min(framebuffer.height - 1, static_cast<int>(std::ceil(maxY)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return false;
+
+        // edge k lies opposite vertex k; flip clockwise triangles so inside is always positive
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        for (int k = 0; k < 3; k++)
+        {
+            int a = (k + 1) % 3, b = (k + 2) % 3;
+            triangle.edgeA[k] = (sy[a] - sy[b]) * sign;
+            triangle.edgeB[k] = (sx[b] - sx[a]) * sign;
+            triangle.edgeC[k] = (sx[a] * sy[b] - sx[b] * sy[a]) * sign;
+            // top-left rule: pixels exactly on a shared edge belong to one triangle only
+            triangle.topLeft[k] = triangle.edgeA[k] > 0.0f || (triangle.edgeA[k] == 0.0f && triangle.edgeB[k] < 0.0f);
+        }
+        triangle.inverseArea = 1.0f / std::fabs(area);
+
+        for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++)
+            for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++)
+                chunkBins[size_t(ty) * tilesX + tx].push_back(triangleIndex);
+        return true;
+    }
+
+    void rasterTile(size_t tile, size_t chunks, const SoftwareMaterial& material, size_t& tested, size_t& shaded)
+    {
+        const int tileX = static_cast<int>(tile % tilesX) * TILE_SIZE;
+        const int tileY = static_cast<int>(tile / tilesX) * TILE_SIZE;
+        const int tileMaxX = std::min(tileX + TILE_SIZE, framebuffer.width) - 1;
+        const int tileMaxY = std::min(tileY + TILE_SIZE, framebuffer.height) - 1;
+
+        for (size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            for (std::uint32_t index : bins[chunk][tile])
+            {
+                const Triangle& triangle = triangles[index];
+                int x0 = std::max(triangle.minX, tileX), x1 = std::min(triangle.maxX, tileMaxX);
+                int y0 = std::max(triangle.minY, tileY), y1 = std::min(triangle.maxY, tileMaxY);
+                for (int y = y0; y <= y1; y++)
+                {
+                    for (int x = x0; x <= x1; x += 4)
+                    {
+                        float weights[3][4];
+                        int mask = coverage(triangle, x, y, weights);
+                        for (int i = 0; i < 4; i++)
+                            if ((mask & (1 << i)) && x + i <= x1)
+                            {
+                                tested++;
+                                if (shadeFragment(triangle, x + i, y, weights[0][i], weights[1][i], weights[2][i], material))
+                                    shaded++;
+                            }
+                    }
+                }
+            }
+        }
+    }
+
+    // edge functions at the centers of pixels x..x+3 of row y; returns a bit per covered pixel
+    static int coverage(const Triangle& triangle, int x, int y, float weights[3][4])
+    {
+        const float py = y + 0.5f;
+#ifdef SOFTWARE_RASTERIZER_SSE
+        const __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+        const __m128 zero = _mm_setzero_ps();
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int k = 0; k < 3; k++)
+        {
+            __m128 e = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[k]), px), _mm_set1_ps(triangle.edgeB[k] * py + triangle.edgeC[k]));
+            __m128 covered = triangle.topLeft[k] ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero);
+            inside = _mm_and_ps(inside, covered);
+            _mm_storeu_ps(weights[k], e);
+        }
+        return _mm_movemask_ps(inside);
+#else
+        int mask = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            bool covered = true;
+            for (int k = 0; k < 3; k++)
+            {
+                float e = triangle.edgeA[k] * (x + i + 0.5f) + (triangle.edgeB[k] * py + triangle.edgeC[k]);
+                weights[k][i] = e;
+                covered = covered && (triangle.topLeft[k] ? e >= 0.0f : e > 0.0f);
+            }
+            if (covered)
+                mask |= 1 << i;
+        }
+        return mask;
+#endif
+    }
+
+    bool shadeFragment(const Triangle& triangle, int x, int y, float e0, float e1, float e2, const SoftwareMaterial& material)
+    {
+        // barycentrics; the edge opposite vertex k weights vertex k
+        float b0 = e0 * triangle.inverseArea, b1 = e1 * triangle.inverseArea, b2 = e2 * triangle.inverseArea;
+        float z = b0 * triangle.z[0] + b1 * triangle.z[1] + b2 * triangle.z[2];
+        if (z < 0.0f || z > 1.0f)
+            return false; // outside the far plane (the near plane was clipped already)
+
+        size_t pixel = size_t(y) * framebuffer.width + x;
+        if (depthTest && !depthPasses(depthFunc, z, framebuffer.depth[pixel]))
+            return false;
+
+        // perspective correct attributes
+        float w = 1.0f / (b0 * triangle.invW[0] + b1 * triangle.invW[1] + b2 * triangle.invW[2]);
+        glm::vec2 uv = (triangle.vertices[0].uv * b0 + triangle.vertices[1].uv * b1 + triangle.vertices[2].uv * b2) * w;
+        glm::vec3 diffuseColor = material.diffuseMap ? glm::vec3(material.diffuseMap->Sample(uv)) : material.diffuse;
+
+        glm::vec3 result;
+        if (material.unlit)
+            result = diffuseColor;
+        else
+        {
+            glm::vec3 fragPos = (triangle.vertices[0].world * b0 + triangle.vertices[1].world * b1 + triangle.vertices[2].world * b2) * w;
+            glm::vec3 normal = glm::normalize((triangle.vertices[0].normal * b0 + triangle.vertices[1].normal * b1 + triangle.vertices[2].normal * b2) * w);
+            glm::vec3 specularColor = material.specularMap ? glm::vec3(material.specularMap->Sample(uv)) : material.specular;
+            glm::vec3 viewDir = glm::normalize(viewPos - fragPos);
+
+            result = glm::vec3(0.0f);
+            for (const DirLight& light : lights.dirLights)
+                result += calcDirLight(light, normal, viewDir, diffuseColor, specularColor, material.shininess);
+            for (const PointLight& light : lights.pointLights)
+                result += calcPointLight(light, normal, fragPos, viewDir, diffuseColor, specularColor, material.shininess);
+            for (const SpotLight& light : lights.spotLights)
+                result += calcSpotLight(light, normal, fragPos, viewDir, diffuseColor, specularColor, material.shininess);
+        }
+
+        if (depthTest && depthMask)
+            framebuffer.depth[pixel] = z;
+        framebuffer.color[pixel] = packColor(glm::vec4(result, 1.0f));
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,51 @@
+// Sampling a VirtualTexture (virtual_texture.h), and the output of its feedback pass.
+// VirtualTexture::Bind sets all of the uniforms below.
+#pragma once
+
+uniform usampler2D vtIndirection; // per page: cache slot x, slot y, level of the page it points at
+uniform sampler2D vtCache;
+uniform vec2 vtSize;              // the virtual texture's size in texels
+uniform vec4 vtPage;              // page size, border, slot size, cache size; in texels
+uniform int vtMaxLevel;           // the single-page level
+uniform int vtTextureID;
+uniform float vtFeedbackBias;     // log2 of how much smaller the feedback target is than the screen
+
+// the mip level the hardware would pick for this texture, from the UV derivatives
+int virtualLevel(vec2 uv, float bias)
+{
+    vec2 dx = dFdx(uv * vtSize), dy = dFdy(uv * vtSize);
+    float level = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + bias;
+    return clamp(int(floor(level)), 0, vtMaxLevel);
+}
+
+vec2 virtualLevelSize(int level)
+{
+    return max(floor(vtSize / exp2(float(level))), vec2(1.0));
+}
+
+ivec2 virtualPage(vec2 uv, int level)
+{
+    return min(ivec2(uv * virtualLevelSize(level) / vtPage.x), textureSize(vtIndirection, level) - 1);
+}
+
+vec4 sampleVirtual(vec2 uv)
+{
+    // the level before wrapping, or the derivatives jump where the texture repeats
+    int level = virtualLevel(uv, 0.0);
+    uv = fract(uv);
+    uvec4 entry = texelFetch(vtIndirection, virtualPage(uv, level), level);
+
+    // the entry may be for a coarser page than asked for, when the page itself isn't resident
+    vec2 texel = uv * virtualLevelSize(int(entry.b));
+    vec2 inPage = texel - floor(texel / vtPage.x) * vtPage.x;
+    vec2 cache = vec2(entry.rg) * vtPage.z + vtPage.y + inPage;
+    // the cache has no mips; the page's level already matches the footprint
+    return textureLod(vtCache, cache / vtPage.w, 0.0);
+}
+
+// what the feedback pass writes into its GL_RGBA8UI target
+uvec4 virtualFeedback(vec2 uv)
+{
+    int level = virtualLevel(uv, -vtFeedbackBias);
+    return uvec4(uvec2(virtualPage(fract(uv), level)), uint(level), uint(vtTextureID));
+}
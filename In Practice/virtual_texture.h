@@ -0,0 +1,735 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "asset_streaming.h"
+#include "job_system.h"
+#include "../Advanced OpenGL/gpu_memory.h"
+#include "../Advanced OpenGL/gpu_resources.h"
+#include "../Advanced OpenGL/state_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*  On-disk layout of a virtual texture: every mip level cut into square pages of pageSize texels,
+    each stored with a border of its neighbours' texels so bilinear filtering inside a page never
+    needs the page next to it.
+
+        "VTEX" version width height pageSize border levels  pages
+
+    Pages are (pageSize + 2 * border)^2 RGBA8 texels each, level 0 first, row by row within a
+    level, so a page's offset follows from its index. Level n has max(1, pages of level 0 >> n)
+    pages along each side; the last level is a single page for the whole texture. Width, height
+    and pageSize are powers of two. */
+static const std::uint32_t VIRTUAL_TEXTURE_HEADER_BYTES = 4 + 6 * sizeof(std::uint32_t);
+
+inline bool isPowerOfTwo(int value)
+{
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+// page table levels of a texture, down to the single page of the coarsest
+inline std::uint32_t virtualPageLevels(int width, int height, int pageSize)
+{
+    glm::ivec2 basePages(std::max(1, width / pageSize), std::max(1, height / pageSize));
+    std::uint32_t levels = 1;
+    while ((basePages.x | basePages.y) >> levels)
+        levels++;
+    return levels;
+}
+
+inline bool writeVirtualTexture(const std::string& path, const unsigned char* rgba, int width, int height,
+                                int pageSize = 128, int border = 1)
+{
+    if (!isPowerOfTwo(width) || !isPowerOfTwo(height) || !isPowerOfTwo(pageSize))
+    {
+        std::cout << "ERROR::VIRTUAL_TEXTURE::NOT_A_POWER_OF_TWO: " << width << "x" << height << " pages of " << pageSize << std::endl;
+        return false;
+    }
+    std::vector<glm::ivec2> sizes;
+    std::vector<std::vector<unsigned char>> mips = buildMipChain(rgba, width, height, sizes);
+
+    glm::ivec2 basePages(std::max(1, width / pageSize), std::max(1, height / pageSize));
+    std::uint32_t levels = virtualPageLevels(width, height, pageSize);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::VIRTUAL_TEXTURE::FAILED_TO_OPEN: " << path << std::endl;
+        return false;
+    }
+    std::uint32_t header[6] = { 1, std::uint32_t(width), std::uint32_t(height), std::uint32_t(pageSize), std::uint32_t(border), levels };
+    file.write("VTEX", 4);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    int slot = pageSize + 2 * border;
+    std::vector<unsigned char> page(size_t(slot) * slot * 4);
+    for (std::uint32_t level = 0; level < levels; level++)
+    {
+        const std::vector<unsigned char>& mip = mips[std::min<size_t>(level, mips.size() - 1)];
+        glm::ivec2 size = sizes[std::min<size_t>(level, sizes.size() - 1)];
+        glm::ivec2 pages(std::max(1, basePages.x >> level), std::max(1, basePages.y >> level));
+        for (int py = 0; py < pages.y; py++)
+            for (int px = 0; px < pages.x; px++)
+            {
+                // wrapped like GL_REPEAT, which also fills the rest of a page larger than its level
+                for (int y = 0; y < slot; y++)
+                    for (int x = 0; x < slot; x++)
+                    {
+                        int sx = ((px * pageSize + x - border) % size.x + size.x) % size.x;
+                        int sy = ((py * pageSize + y - border) % size.y + size.y) % size.y;
+                        std::memcpy(&page[(size_t(y) * slot + x) * 4], &mip[(size_t(sy) * size.x + sx) * 4], 4);
+                    }
+                file.write(reinterpret_cast<const char*>(page.data()), page.size());
+            }
+    }
+    return static_cast<bool>(file);
+}
+
+// physical cache pages per side so that a screen full of one texture fits twice over: pages
+// cut by the screen edges and the two levels around every mip transition both need room
+inline int virtualCachePages(int screenWidth, int screenHeight, int pageSize = 128)
+{
+    int pages = 2 * (screenWidth / pageSize + 2) * (screenHeight / pageSize + 2);
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(pages))));
+    return std::min(side, 256);
+}
+
+struct VirtualTextureSettings {
+    int cachePages = 16;         // physical cache pages per side, at most 256
+    int maxInFlightPages = 16;   // pages being read at once
+    int uploadsPerFrame = 8;     // pages copied into the cache per Update
+    unsigned int textureID = 1;  // what this texture writes into the feedback pass, 1 to 255
+};
+
+struct VirtualTextureStats {
+    std::uint64_t requests = 0;     // distinct pages asked for
+    std::uint64_t pagesLoaded = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t cacheFull = 0;    // pages dropped because every slot was in use this frame
+    std::uint64_t failures = 0;
+    int residentPages = 0;
+    int inFlightPages = 0;
+};
+
+/*  A texture that only keeps the parts on screen in GPU memory. The texture is cut into pages
+    per mip level (see writeVirtualTexture above); a fixed-size cache texture holds the pages that
+    are resident, and an indirection texture with one texel per page says where in the cache each
+    one is. The shader side is in virtual_texture.glsl: sampleVirtual picks the mip level from the
+    UV derivatives like the hardware would, looks the page up in the indirection texture and
+    samples the cache there.
+
+    Pages that aren't resident fall back to the finest resident page above them: the indirection
+    entry of a missing page points at its parent's (or grandparent's) page, and the single page of
+    the coarsest level is loaded in the constructor and never evicted, so every lookup hits
+    something. A missing page shows up blurry instead of black, until it arrives.
+
+    Which pages are needed comes from a feedback pass (VirtualTextureFeedback below), which draws
+    the scene small and writes the page every pixel would sample; or from RequestRegion, a CPU
+    estimate from a UV rectangle and its size on screen. Update then reads the requested pages on
+    the job system's worker threads, coarse levels first, and copies what arrived into the cache,
+    a few pages per frame. When the cache is full, the least recently requested page makes room.
+
+    GPU memory is the cache, cachePages^2 pages, whatever the size of the texture; see
+    virtualCachePages for a size that matches the screen. Pages are at most 256 per side at level
+    0 (32768 texels with 128 texel pages), the range of the feedback encoding. */
+class VirtualTexture {
+public:
+    VirtualTextureStats stats;
+    VirtualTextureSettings settings;
+
+    VirtualTexture(JobSystem& jobs, const std::string& path, const VirtualTextureSettings& settings = VirtualTextureSettings())
+        : settings(settings), jobs(jobs), path(path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        std::uint64_t fileSize = file ? static_cast<std::uint64_t>(file.tellg()) : 0;
+        file.seekg(0);
+        char magic[4] = {};
+        std::uint32_t header[6] = {};
+        file.read(magic, 4);
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!file || std::memcmp(magic, "VTEX", 4) != 0 || header[0] != 1)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return;
+        }
+        // the level count and sizes have to be the ones the page counts imply, and every page in the file
+        bool sizesValid = header[1] <= 65536 && header[2] <= 65536 && header[3] <= 4096 &&
+                          isPowerOfTwo(int(header[1])) && isPowerOfTwo(int(header[2])) && isPowerOfTwo(int(header[3])) &&
+                          header[4] < header[3] && header[1] / header[3] <= 256 && header[2] / header[3] <= 256;
+        if (!sizesValid || header[5] != virtualPageLevels(int(header[1]), int(header[2]), int(header[3])))
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE::INVALID_HEADER: " << path << std::endl;
+            return;
+        }
+        width = static_cast<int>(header[1]);
+        height = static_cast<int>(header[2]);
+        pageSize = static_cast<int>(header[3]);
+        border = static_cast<int>(header[4]);
+        slotSize = pageSize + 2 * border;
+        pageBytes = size_t(slotSize) * slotSize * 4;
+        if (this->settings.cachePages < 1 || this->settings.cachePages > 256)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE::CACHE_PAGES_OUT_OF_RANGE: " << this->settings.cachePages << std::endl;
+            this->settings.cachePages = std::min(std::max(this->settings.cachePages, 1), 256);
+        }
+
+        glm::ivec2 basePages(std::max(1, width / pageSize), std::max(1, height / pageSize));
+        int first = 0;
+        for (std::uint32_t level = 0; level < header[5]; level++)
+        {
+            glm::ivec2 count(std::max(1, basePages.x >> level), std::max(1, basePages.y >> level));
+            levelPages.push_back(count);
+            levelFirst.push_back(first);
+            first += count.x * count.y;
+        }
+        if (fileSize < VIRTUAL_TEXTURE_HEADER_BYTES + std::uint64_t(first) * pageBytes)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE::FILE_TRUNCATED: " << path << std::endl;
+            return;
+        }
+        pages.resize(first);
+        slots.assign(size_t(this->settings.cachePages) * this->settings.cachePages, -1);
+        for (int slot = static_cast<int>(slots.size()) - 1; slot >= 0; slot--)
+            freeSlots.push_back(slot);
+
+        int cacheTexels = this->settings.cachePages * slotSize;
+        cache = GpuTexture::Create();
+        glState().BindTexture(0, GL_TEXTURE_2D, cache.Name());
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, cacheTexels, cacheTexels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        gpuMemory().TrackTexture(cache.Name(), GL_RGBA8, cacheTexels, cacheTexels, 1, 1, GPU_MEMORY_TEXTURE, path + " (cache)", GPU_MEMORY_SITE);
+
+        // integer texels, looked up with texelFetch, so no filtering
+        indirection = GpuTexture::Create();
+        glState().BindTexture(0, GL_TEXTURE_2D, indirection.Name());
+        glTexStorage2D(GL_TEXTURE_2D, Levels(), GL_RGBA8UI, basePages.x, basePages.y);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gpuMemory().TrackTexture(indirection.Name(), GL_RGBA8UI, basePages.x, basePages.y, 1, Levels(), GPU_MEMORY_TEXTURE,
+                                 path + " (indirection)", GPU_MEMORY_SITE);
+
+        // the fallback for everything: read now, and never evicted
+        rootPage = first - 1;
+        Completed root = readPage(rootPage);
+        if (root.failed)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE::FILE_TRUNCATED: " << path << std::endl;
+            return;
+        }
+        uploadPage(root);
+        updateIndirection();
+        valid = true;
+    }
+
+    ~VirtualTexture()
+    {
+        // reads still running write into completed
+        jobs.Wait(reading);
+    }
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    bool Valid() const
+    {
+        return valid;
+    }
+
+    int Width() const
+    {
+        return width;
+    }
+
+    int Height() const
+    {
+        return height;
+    }
+
+    int Levels() const
+    {
+        return static_cast<int>(levelPages.size());
+    }
+
+    glm::ivec2 Pages(int level) const
+    {
+        return levelPages[level];
+    }
+
+    bool Resident(int level, int x, int y) const
+    {
+        return pages[pageIndex(level, x, y)].slot >= 0;
+    }
+
+    unsigned int CacheTexture() const
+    {
+        return cache.Name();
+    }
+
+    unsigned int IndirectionTexture() const
+    {
+        return indirection.Name();
+    }
+
+    // ask for a page (and the pages above it) to be made resident; cheap to call for the same page
+    // many times a frame, as the feedback readback does
+    void Request(int level, int x, int y)
+    {
+        if (!valid)
+            return;
+        level = std::min(std::max(level, 0), Levels() - 1);
+        for (; level < Levels(); level++, x >>= 1, y >>= 1)
+        {
+            int index = pageIndex(level, x, y);
+            Page& page = pages[index];
+            // the parents were marked along with it
+            if (page.lastRequested == frame)
+                break;
+            page.lastRequested = frame;
+            requested.push_back(index);
+            stats.requests++;
+        }
+    }
+
+    // the CPU estimate: a UV rectangle covering screenPixels pixels along its longer side, like
+    // the projected size StreamingManager works with. Asks for the level whose detail matches
+    void RequestRegion(const glm::vec2& uvMin, const glm::vec2& uvMax, float screenPixels)
+    {
+        if (!valid)
+            return;
+        float texels = std::max(std::abs(uvMax.x - uvMin.x) * width, std::abs(uvMax.y - uvMin.y) * height);
+        float ratio = texels / std::max(screenPixels, 1.0f);
+        int level = ratio > 1.0f ? static_cast<int>(std::floor(std::log2(ratio))) : 0;
+        level = std::min(level, Levels() - 1);
+
+        // pages at that level; the rectangle may repeat the texture
+        float pagesX = static_cast<float>(std::max(1, width >> level)) / pageSize;
+        float pagesY = static_cast<float>(std::max(1, height >> level)) / pageSize;
+        glm::ivec2 count = levelPages[level];
+        int firstX = static_cast<int>(std::floor(std::min(uvMin.x, uvMax.x) * pagesX));
+        int firstY = static_cast<int>(std::floor(std::min(uvMin.y, uvMax.y) * pagesY));
+        int lastX = std::min(static_cast<int>(std::floor(std::max(uvMin.x, uvMax.x) * pagesX)), firstX + count.x - 1);
+        int lastY = std::min(static_cast<int>(std::floor(std::max(uvMin.y, uvMax.y) * pagesY)), firstY + count.y - 1);
+        for (int y = firstY; y <= lastY; y++)
+            for (int x = firstX; x <= lastX; x++)
+                Request(level, (x % count.x + count.x) % count.x, (y % count.y + count.y) % count.y);
+    }
+
+    // once per frame on the GL thread, after the frame's requests: copy arrived pages into the
+    // cache, start reading newly requested ones and update the indirection texture
+    void Update()
+    {
+        if (!valid)
+            return;
+        upload();
+        read();
+        if (indirectionDirty)
+            updateIndirection();
+        requested.clear();
+        frame++;
+    }
+
+    // bind the indirection and cache textures to units firstUnit and firstUnit + 1 and set the
+    // uniforms of virtual_texture.glsl. feedbackBias is VirtualTextureFeedback::Bias() for the
+    // feedback pass, 0 otherwise
+    void Bind(unsigned int program, unsigned int firstUnit = 0, float feedbackBias = 0.0f)
+    {
+        glState().BindTexture(firstUnit, GL_TEXTURE_2D, indirection.Name());
+        glState().BindTexture(firstUnit + 1, GL_TEXTURE_2D, cache.Name());
+        glState().UseProgram(program);
+        glm::vec2 size(width, height);
+        glm::vec4 page(pageSize, border, slotSize, settings.cachePages * slotSize);
+        glUniform1i(glGetUniformLocation(program, "vtIndirection"), firstUnit);
+        glUniform1i(glGetUniformLocation(program, "vtCache"), firstUnit + 1);
+        glUniform2fv(glGetUniformLocation(program, "vtSize"), 1, &size[0]);
+        glUniform4fv(glGetUniformLocation(program, "vtPage"), 1, &page[0]);
+        glUniform1i(glGetUniformLocation(program, "vtMaxLevel"), Levels() - 1);
+        glUniform1i(glGetUniformLocation(program, "vtTextureID"), static_cast<int>(settings.textureID));
+        glUniform1f(glGetUniformLocation(program, "vtFeedbackBias"), feedbackBias);
+    }
+
+private:
+    struct Page {
+        int slot = -1;                  // where in the cache, -1 if not resident
+        std::uint32_t lastRequested = 0;
+        bool loading = false;
+    };
+
+    struct Completed {
+        int page;
+        std::vector<unsigned char> data;
+        bool failed;
+    };
+
+    JobSystem& jobs;
+    std::string path;
+    bool valid = false;
+    int width = 0, height = 0;
+    int pageSize = 1, border = 0, slotSize = 1;
+    size_t pageBytes = 0;
+
+    std::vector<glm::ivec2> levelPages;
+    std::vector<int> levelFirst;
+    std::vector<Page> pages;
+    std::vector<int> slots;           // page in each cache slot, -1 if free
+    std::vector<int> freeSlots;
+    int rootPage = 0;
+
+    // frame 0 is "never requested"
+    std::uint32_t frame = 1;
+    std::vector<int> requested;       // pages requested since the last Update
+    bool indirectionDirty = false;
+
+    GpuTexture cache;
+    GpuTexture indirection;
+
+    JobCounter reading;
+    std::mutex completedMutex;
+    std::vector<Completed> completed;
+    std::vector<Completed> pending;   // arrived but over this frame's upload count
+
+    int pageIndex(int level, int x, int y) const
+    {
+        glm::ivec2 count = levelPages[level];
+        x = std::min(std::max(x, 0), count.x - 1);
+        y = std::min(std::max(y, 0), count.y - 1);
+        return levelFirst[level] + y * count.x + x;
+    }
+
+    int pageLevel(int index) const
+    {
+        int level = 0;
+        while (level + 1 < Levels() && index >= levelFirst[level + 1])
+            level++;
+        return level;
+    }
+
+    Completed readPage(int index) const
+    {
+        Completed result;
+        result.page = index;
+        result.data.resize(pageBytes);
+        std::ifstream file(path, std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(VIRTUAL_TEXTURE_HEADER_BYTES + size_t(index) * pageBytes));
+        file.read(reinterpret_cast<char*>(result.data.data()), static_cast<std::streamsize>(pageBytes));
+        result.failed = !file;
+        return result;
+    }
+
+    void read()
+    {
+        std::vector<int> wanted;
+        for (int index : requested)
+            if (pages[index].slot < 0 && !pages[index].loading)
+                wanted.push_back(index);
+        // coarse pages first: they are the fallback for everything below them. Within a level the
+        // layout keeps the order the requests came in
+        std::stable_sort(wanted.begin(), wanted.end(), [this](int a, int b) { return pageLevel(a) > pageLevel(b); });
+
+        // no reads for pages that would find the cache full of this frame's pages anyway
+        int room = static_cast<int>(freeSlots.size());
+        for (int index : slots)
+            if (index >= 0 && index != rootPage && pages[index].lastRequested < frame)
+                room++;
+        room -= stats.inFlightPages + static_cast<int>(pending.size());
+
+        for (int index : wanted)
+        {
+            if (stats.inFlightPages >= settings.maxInFlightPages || room-- <= 0)
+                break;
+            pages[index].loading = true;
+            stats.inFlightPages++;
+            jobs.Run([this, index]() {
+                Completed result = readPage(index);
+                std::lock_guard<std::mutex> lock(completedMutex);
+                completed.push_back(std::move(result));
+            }, &reading);
+        }
+    }
+
+    void upload()
+    {
+        {
+            std::lock_guard<std::mutex> lock(completedMutex);
+            for (Completed& result : completed)
+                pending.push_back(std::move(result));
+            stats.inFlightPages -= static_cast<int>(completed.size());
+            completed.clear();
+        }
+        std::stable_sort(pending.begin(), pending.end(), [this](const Completed& a, const Completed& b) {
+            return pageLevel(a.page) > pageLevel(b.page);
+        });
+
+        size_t done = 0;
+        for (; done < pending.size() && done < static_cast<size_t>(settings.uploadsPerFrame); done++)
+        {
+            Completed& result = pending[done];
+            pages[result.page].loading = false;
+            if (result.failed)
+            {
+                std::cout << "ERROR::VIRTUAL_TEXTURE::READ_FAILED: " << path << " page " << result.page << std::endl;
+                stats.failures++;
+                continue;
+            }
+            uploadPage(result);
+        }
+        pending.erase(pending.begin(), pending.begin() + done);
+    }
+
+    // a free slot, or the one of the least recently requested page not requested this frame
+    int allocateSlot()
+    {
+        if (!freeSlots.empty())
+        {
+            int slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        int victim = -1;
+        std::uint32_t oldest = frame;
+        for (size_t slot = 0; slot < slots.size(); slot++)
+        {
+            int index = slots[slot];
+            if (index != rootPage && pages[index].lastRequested < oldest)
+            {
+                oldest = pages[index].lastRequested;
+                victim = static_cast<int>(slot);
+            }
+        }
+        if (victim >= 0)
+        {
+            pages[slots[victim]].slot = -1;
+            slots[victim] = -1;
+            stats.evictions++;
+            stats.residentPages--;
+        }
+        return victim;
+    }
+
+    void uploadPage(const Completed& result)
+    {
+        int slot = allocateSlot();
+        if (slot < 0)
+        {
+            // everything in the cache is on screen; it will be asked for again next frame
+            stats.cacheFull++;
+            return;
+        }
+        int x = slot % settings.cachePages, y = slot / settings.cachePages;
+        glState().BindTexture(0, GL_TEXTURE_2D, cache.Name());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x * slotSize, y * slotSize, slotSize, slotSize, GL_RGBA, GL_UNSIGNED_BYTE, result.data.data());
+        slots[slot] = result.page;
+        pages[result.page].slot = slot;
+        stats.pagesLoaded++;
+        stats.residentPages++;
+        indirectionDirty = true;
+    }
+
+    // every entry points at the cache slot of its page, or of the finest resident page above it:
+    // (slot x, slot y, level of that page, 255)
+    void updateIndirection()
+    {
+        std::vector<unsigned char> above, entries;
+        glState().BindTexture(0, GL_TEXTURE_2D, indirection.Name());
+        for (int level = Levels() - 1; level >= 0; level--)
+        {
+            glm::ivec2 count = levelPages[level];
+            entries.assign(size_t(count.x) * count.y * 4, 0);
+            for (int y = 0; y < count.y; y++)
+                for (int x = 0; x < count.x; x++)
+                {
+                    unsigned char* entry = &entries[(size_t(y) * count.x + x) * 4];
+                    int slot = pages[levelFirst[level] + y * count.x + x].slot;
+                    if (slot >= 0)
+                    {
+                        entry[0] = static_cast<unsigned char>(slot % settings.cachePages);
+                        entry[1] = static_cast<unsigned char>(slot / settings.cachePages);
+                        entry[2] = static_cast<unsigned char>(level);
+                        entry[3] = 255;
+                    }
+                    else if (level + 1 < Levels())
+                    {
+                        glm::ivec2 parentCount = levelPages[level + 1];
+                        int px = std::min(x >> 1, parentCount.x - 1), py = std::min(y >> 1, parentCount.y - 1);
+                        std::memcpy(entry, &above[(size_t(py) * parentCount.x + px) * 4], 4);
+                    }
+                }
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, count.x, count.y, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+            above.swap(entries);
+        }
+        indirectionDirty = false;
+    }
+};
+
+/*  The feedback pass: the scene drawn once more into a small integer target, with a shader that
+    writes virtualFeedback(uv) (virtual_texture.glsl) instead of a colour. Every pixel then holds
+    the page it would sample and the ID of its texture. The target is read back into a pixel
+    buffer and mapped a few frames later, when the GPU is done with it, so reading it never waits;
+    Collect turns the pixels into requests.
+
+    The target is scale times smaller than the screen along each side, which makes the UV
+    derivatives scale times larger; the shader subtracts Bias() from the level to make up for it. */
+class VirtualTextureFeedback {
+public:
+    static const unsigned int FRAMES = 3;
+
+    VirtualTextureFeedback(int screenWidth, int screenHeight, int scale = 8)
+        : scale(scale)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        Resize(screenWidth, screenHeight);
+    }
+
+    ~VirtualTextureFeedback()
+    {
+        for (GLsync& fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+
+    VirtualTextureFeedback(const VirtualTextureFeedback&) = delete;
+    VirtualTextureFeedback& operator=(const VirtualTextureFeedback&) = delete;
+
+    void Resize(int screenWidth, int screenHeight)
+    {
+        width = std::max(1, screenWidth / scale);
+        height = std::max(1, screenHeight / scale);
+        for (GLsync& fence : fences)
+            if (fence)
+            {
+                glDeleteSync(fence);
+                fence = 0;
+            }
+
+        color = GpuTexture::Create();
+        glState().BindTexture(0, GL_TEXTURE_2D, color.Name());
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8UI, width, height);
+        gpuMemory().TrackTexture(color.Name(), GL_RGBA8UI, width, height, 1, 1, GPU_MEMORY_RENDER_TARGET, "virtual texture feedback", GPU_MEMORY_SITE);
+        depth = GpuTexture::Create();
+        glState().BindTexture(0, GL_TEXTURE_2D, depth.Name());
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+        gpuMemory().TrackTexture(depth.Name(), GL_DEPTH_COMPONENT24, width, height, 1, 1, GPU_MEMORY_RENDER_TARGET, "virtual texture feedback", GPU_MEMORY_SITE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.Name(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.Name(), 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::VIRTUAL_TEXTURE::FEEDBACK_FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        GLsizeiptr bytes = GLsizeiptr(width) * height * 4;
+        for (GpuBuffer& buffer : readback)
+        {
+            buffer = GpuBuffer::Create();
+            glState().BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.Name());
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            gpuMemory().TrackBuffer(buffer.Name(), static_cast<size_t>(bytes), GPU_MEMORY_STREAMING, "virtual texture feedback", GPU_MEMORY_SITE);
+        }
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    float Bias() const
+    {
+        return std::log2(static_cast<float>(scale));
+    }
+
+    // bind and clear the target; draw the scene with the feedback shader after this
+    void Begin()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+        const GLuint none[4] = { 0, 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, 0, none);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // start reading the target back and go back to the default framebuffer (the viewport is left
+    // for the caller to restore)
+    void End()
+    {
+        if (fences[frame])
+        {
+            // not collected for FRAMES frames: the oldest readback is dropped
+            glDeleteSync(fences[frame]);
+            fences[frame] = 0;
+        }
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, readback[frame].Name());
+        glReadPixels(0, 0, width, height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        frame = (frame + 1) % FRAMES;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // hand the pages of every finished readback to the textures they belong to; call before
+    // their Update
+    void Collect(const std::vector<VirtualTexture*>& textures)
+    {
+        for (unsigned int i = 0; i < FRAMES; i++)
+        {
+            // frame is the next region End writes, so the oldest one
+            unsigned int region = (frame + i) % FRAMES;
+            GLsync& fence = fences[region];
+            if (!fence)
+                continue;
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+                continue;
+            glDeleteSync(fence);
+            fence = 0;
+            if (status == GL_WAIT_FAILED)
+            {
+                std::cout << "ERROR::VIRTUAL_TEXTURE::FEEDBACK_WAIT_FAILED" << std::endl;
+                continue;
+            }
+
+            glState().BindBuffer(GL_PIXEL_PACK_BUFFER, readback[region].Name());
+            const unsigned char* pixels = static_cast<const unsigned char*>(
+                glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(width) * height * 4, GL_MAP_READ_BIT));
+            if (pixels)
+            {
+                std::uint32_t last = 0;
+                for (size_t p = 0, n = size_t(width) * height; p < n; p++)
+                {
+                    const unsigned char* pixel = pixels + p * 4;
+                    std::uint32_t value;
+                    std::memcpy(&value, pixel, 4);
+                    // neighbouring pixels mostly want the same page
+                    if (pixel[3] == 0 || value == last)
+                        continue;
+                    last = value;
+                    for (VirtualTexture* texture : textures)
+                        if (texture->settings.textureID == pixel[3])
+                            texture->Request(pixel[2], pixel[0], pixel[1]);
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glState().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+private:
+    int scale;
+    int width = 1, height = 1;
+    unsigned int framebuffer = 0;
+    GpuTexture color;
+    GpuTexture depth;
+    GpuBuffer readback[FRAMES];
+    GLsync fences[FRAMES] = {};
+    unsigned int frame = 0;
+};
+#endif
@@ -0,0 +1,32 @@
+// Sampling the static lighting baked by light_baker.h. Include with
+//     #include "baked_lighting.glsl"
+// A baked value multiplies the diffuse color; the specular term stays per light because it
+// depends on the view, so add calcSpecular for the lights that should still shine.
+#pragma once
+
+// lightmap of a static mesh, addressed with the second set of texture coordinates
+// (Mesh::SetLightmapCoords puts them at attribute location 7)
+uniform sampler2D lightmap;
+
+// probe at the object's position for moving objects, from setProbeUniform
+uniform vec3 probeSH[9];
+
+vec3 sampleLightmap(vec2 lightmapCoords)
+{
+    return texture(lightmap, lightmapCoords).rgb;
+}
+
+// the same nine basis functions as shBasis in light_baker.h
+vec3 evaluateProbe(vec3 normal)
+{
+    vec3 result = probeSH[0] * 0.282095
+                + probeSH[1] * (0.488603 * normal.y)
+                + probeSH[2] * (0.488603 * normal.z)
+                + probeSH[3] * (0.488603 * normal.x)
+                + probeSH[4] * (1.092548 * normal.x * normal.y)
+                + probeSH[5] * (1.092548 * normal.y * normal.z)
+                + probeSH[6] * (0.315392 * (3.0 * normal.z * normal.z - 1.0))
+                + probeSH[7] * (1.092548 * normal.x * normal.z)
+                + probeSH[8] * (0.546274 * (normal.x * normal.x - normal.y * normal.y));
+    return max(result, vec3(0.0));
+}
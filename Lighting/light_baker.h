@@ -0,0 +1,963 @@
+#ifndef LIGHT_BAKER_H
+#define LIGHT_BAKER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "lighting.h"
+#include "../Advanced OpenGL/gpu_memory.h"
+#include "../Advanced OpenGL/state_cache.h"
+#include "../In Practice/parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*  Offline baking of static lighting. The lights of lighting_maps and multiple_lights never move
+    and neither do most walls and floors, yet the shaders work out the same ambient, diffuse and
+    attenuation terms for them every frame. The baker computes them once, with shadows and a
+    bounce of indirect light the shaders don't have, into:
+
+        lightmaps       one texture per mesh, addressed with a second set of texture coordinates
+                        laid out so that no two triangles share texels (Assimp's second UV
+                        channel, as exported by the modelling tool)
+        light probes    a grid of points storing the light arriving from every direction as nine
+                        spherical harmonic coefficients, for objects that move through the scene
+
+    A baked value is what multiplies the diffuse color in the shaders, the sum over all lights of
+    (ambient + diffuse * max(dot(normal, lightDir), 0) * shadow) * attenuation, plus the indirect
+    light. So at runtime: color = baked * diffuseColor + specular, where only the view-dependent
+    specular term is still calculated per light (baked_lighting.glsl).
+
+    Rays are traced through a bounding volume hierarchy over the world-space triangles of every
+    mesh. Texels and probes are independent of each other and are split over a ParallelFor; the
+    random numbers of a texel only depend on its position, so a bake gives the same result on any
+    number of threads. */
+
+struct LightBakeSettings {
+    int indirectSamples = 64;        // hemisphere rays per texel for the bounce; 0 bakes direct light only
+    int probeSamples = 256;          // sphere rays per probe
+    float bias = 1e-3f;              // ray origin offset along the normal, against self shadowing
+    int dilation = 4;                // texels to grow every chart by, so bilinear filtering doesn't fetch empty texels
+    glm::vec3 skyColor = glm::vec3(0.0f); // light from rays that hit nothing
+};
+
+struct LightBakeStats {
+    size_t texels = 0;
+    size_t probes = 0;
+    size_t rays = 0;
+    double buildSeconds = 0.0;
+    double bakeSeconds = 0.0;
+};
+
+// RGB float texture of baked light; row 0 at the bottom like a GL texture
+struct Lightmap {
+    int width = 0;
+    int height = 0;
+    std::vector<glm::vec3> texels;
+
+    // half floats are plenty for light values and keep the texture small
+    unsigned int Upload() const
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().BindTexture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, texels.data());
+        gpuMemory().TrackTexture(texture, GL_RGB16F, width, height, 1, 1, GPU_MEMORY_TEXTURE, "lightmap", GPU_MEMORY_SITE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    bool Save(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        const char magic[4] = { 'L', 'M', 'A', 'P' };
+        std::int32_t size[2] = { width, height };
+        file.write(magic, 4);
+        file.write(reinterpret_cast<const char*>(size), sizeof(size));
+        file.write(reinterpret_cast<const char*>(texels.data()), texels.size() * sizeof(glm::vec3));
+        if (!file)
+            std::cout << "ERROR::LIGHT_BAKER::FAILED_TO_WRITE: " << path << std::endl;
+        return static_cast<bool>(file);
+    }
+
+    bool Load(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        char magic[4] = {};
+        std::int32_t size[2] = {};
+        file.read(magic, 4);
+        file.read(reinterpret_cast<char*>(size), sizeof(size));
+        if (!file || std::string(magic, 4) != "LMAP" || size[0] <= 0 || size[1] <= 0)
+        {
+            std::cout << "ERROR::LIGHT_BAKER::NOT_A_LIGHTMAP: " << path << std::endl;
+            return false;
+        }
+        width = size[0];
+        height = size[1];
+        texels.resize(size_t(width) * height);
+        file.read(reinterpret_cast<char*>(texels.data()), texels.size() * sizeof(glm::vec3));
+        return static_cast<bool>(file);
+    }
+};
+
+// the first nine real spherical harmonics (bands 0 to 2)
+inline void shBasis(const glm::vec3& n, float basis[9])
+{
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * n.y;
+    basis[2] = 0.488603f * n.z;
+    basis[3] = 0.488603f * n.x;
+    basis[4] = 1.092548f * n.x * n.y;
+    basis[5] = 1.092548f * n.y * n.z;
+    basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+    basis[7] = 1.092548f * n.x * n.z;
+    basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+/*  Light arriving at a probe, already convolved with the cosine lobe: evaluating it for a normal
+    gives the baked value a surface with that normal would have at the probe's position. */
+struct LightProbe {
+    glm::vec3 coefficients[9];
+
+    glm::vec3 Evaluate(const glm::vec3& normal) const
+    {
+        float basis[9];
+        shBasis(normal, basis);
+        glm::vec3 result(0.0f);
+        for (int i = 0; i < 9; i++)
+            result += coefficients[i] * basis[i];
+        return glm::max(result, glm::vec3(0.0f));
+    }
+};
+
+// probes at the corners of a regular grid of cells spanning boundsMin to boundsMax
+struct LightProbeGrid {
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    int countX = 0, countY = 0, countZ = 0;
+    std::vector<LightProbe> probes;
+
+    void Resize(const glm::vec3& newMin, const glm::vec3& newMax, int x, int y, int z)
+    {
+        boundsMin = newMin;
+        boundsMax = newMax;
+        countX = std::max(x, 1);
+        countY = std::max(y, 1);
+        countZ = std::max(z, 1);
+        probes.assign(size_t(countX) * countY * countZ, LightProbe());
+    }
+
+    glm::vec3 Position(size_t index) const
+    {
+        int x = static_cast<int>(index % countX);
+        int y = static_cast<int>((index / countX) % countY);
+        int z = static_cast<int>(index / (size_t(countX) * countY));
+        return boundsMin + (boundsMax - boundsMin) * glm::vec3(step(x, countX), step(y, countY), step(z, countZ));
+    }
+
+    // trilinear blend of the eight surrounding probes; positions outside the grid use its border
+    LightProbe Sample(const glm::vec3& position) const
+    {
+        LightProbe result = {};
+        if (probes.empty())
+            return result;
+        glm::vec3 extent = boundsMax - boundsMin;
+        float cell[3] = {
+            extent.x > 0.0f ? (position.x - boundsMin.x) / extent.x * (countX - 1) : 0.0f,
+            extent.y > 0.0f ? (position.y - boundsMin.y) / extent.y * (countY - 1) : 0.0f,
+            extent.z > 0.0f ? (position.z - boundsMin.z) / extent.z * (countZ - 1) : 0.0f
+        };
+        int counts[3] = { countX, countY, countZ };
+        int base[3];
+        float t[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float c = std::min(std::max(cell[axis], 0.0f), float(counts[axis] - 1));
+            base[axis] = std::min(static_cast<int>(c), std::max(counts[axis] - 2, 0));
+            t[axis] = counts[axis] > 1 ? c - base[axis] : 0.0f;
+        }
+        for (int corner = 0; corner < 8; corner++)
+        {
+            int x = std::min(base[0] + (corner & 1), countX - 1);
+            int y = std::min(base[1] + ((corner >> 1) & 1), countY - 1);
+            int z = std::min(base[2] + ((corner >> 2) & 1), countZ - 1);
+            float weight = ((corner & 1) ? t[0] : 1.0f - t[0]) * (((corner >> 1) & 1) ? t[1] : 1.0f - t[1]) *
+                           (((corner >> 2) & 1) ? t[2] : 1.0f - t[2]);
+            const LightProbe& probe = probes[(size_t(z) * countY + y) * countX + x];
+            for (int i = 0; i < 9; i++)
+                result.coefficients[i] += probe.coefficients[i] * weight;
+        }
+        return result;
+    }
+
+    bool Save(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        const char magic[4] = { 'P', 'R', 'O', 'B' };
+        std::int32_t counts[3] = { countX, countY, countZ };
+        file.write(magic, 4);
+        file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+        file.write(reinterpret_cast<const char*>(&boundsMin), sizeof(glm::vec3));
+        file.write(reinterpret_cast<const char*>(&boundsMax), sizeof(glm::vec3));
+        file.write(reinterpret_cast<const char*>(probes.data()), probes.size() * sizeof(LightProbe));
+        if (!file)
+            std::cout << "ERROR::LIGHT_BAKER::FAILED_TO_WRITE: " << path << std::endl;
+        return static_cast<bool>(file);
+    }
+
+    bool Load(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        char magic[4] = {};
+        std::int32_t counts[3] = {};
+        file.read(magic, 4);
+        file.read(reinterpret_cast<char*>(counts), sizeof(counts));
+        if (!file || std::string(magic, 4) != "PROB" || counts[0] <= 0 || counts[1] <= 0 || counts[2] <= 0)
+        {
+            std::cout << "ERROR::LIGHT_BAKER::NOT_A_PROBE_GRID: " << path << std::endl;
+            return false;
+        }
+        glm::vec3 newMin, newMax;
+        file.read(reinterpret_cast<char*>(&newMin), sizeof(glm::vec3));
+        file.read(reinterpret_cast<char*>(&newMax), sizeof(glm::vec3));
+        Resize(newMin, newMax, counts[0], counts[1], counts[2]);
+        file.read(reinterpret_cast<char*>(probes.data()), probes.size() * sizeof(LightProbe));
+        return static_cast<bool>(file);
+    }
+
+private:
+    static float step(int i, int count)
+    {
+        return count > 1 ? float(i) / float(count - 1) : 0.5f;
+    }
+};
+
+// upload a probe (usually LightProbeGrid::Sample at the object's position) to baked_lighting.glsl
+inline void setProbeUniform(unsigned int program, const LightProbe& probe)
+{
+    glUniform3fv(glGetUniformLocation(program, "probeSH"), 9, &probe.coefficients[0].x);
+}
+
+struct BakeHit {
+    float distance;
+    std::uint32_t triangle;
+    float u, v; // barycentrics of the second and third corner
+};
+
+/*  Bounding volume hierarchy over triangles, split with the surface area heuristic evaluated at 8
+    bins per axis. Nodes are 32 bytes and siblings are stored next to each other, so a node only
+    needs the index of its first child; leaf triangles are stored in leaf order. */
+class TriangleBVH {
+public:
+    // three corners per triangle
+    void Build(const std::vector<glm::vec3>& corners)
+    {
+        const std::uint32_t count = static_cast<std::uint32_t>(corners.size() / 3);
+        order.resize(count);
+        std::vector<glm::vec3> centroids(count);
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            order[i] = i;
+            centroids[i] = (corners[i * 3] + corners[i * 3 + 1] + corners[i * 3 + 2]) / 3.0f;
+        }
+
+        nodes.clear();
+        nodes.reserve(count * 2 + 1);
+        nodes.push_back(Node());
+        nodes[0].leftFirst = 0;
+        nodes[0].count = count;
+        fitBounds(nodes[0], corners);
+        // node and its depth; the deepest one sizes the traversal stack
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> stack;
+        depth = 0;
+        if (count > 0)
+            stack.push_back({ 0, 0 });
+        while (!stack.empty())
+        {
+            std::pair<std::uint32_t, std::uint32_t> entry = stack.back();
+            stack.pop_back();
+            depth = std::max(depth, entry.second);
+            if (subdivide(entry.first, corners, centroids))
+            {
+                stack.push_back({ nodes[entry.first].leftFirst, entry.second + 1 });
+                stack.push_back({ nodes[entry.first].leftFirst + 1, entry.second + 1 });
+            }
+        }
+
+        // precompute the edges of every triangle in leaf order for the intersection test
+        vertex0.resize(count);
+        edge1.resize(count);
+        edge2.resize(count);
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            std::uint32_t t = order[i];
+            vertex0[i] = corners[t * 3];
+            edge1[i] = corners[t * 3 + 1] - corners[t * 3];
+            edge2[i] = corners[t * 3 + 2] - corners[t * 3];
+        }
+    }
+
+    size_t NodeCount() const
+    {
+        return nodes.size();
+    }
+
+    size_t Depth() const
+    {
+        return depth;
+    }
+
+    // closest hit closer than maxDistance
+    bool Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BakeHit& hit) const
+    {
+        hit.distance = maxDistance;
+        return traverse<false>(origin, direction, hit);
+    }
+
+    // any hit closer than maxDistance, for shadow rays
+    bool Occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+    {
+        BakeHit hit;
+        hit.distance = maxDistance;
+        return traverse<true>(origin, direction, hit);
+    }
+
+private:
+    struct Node {
+        glm::vec3 boundsMin;
+        std::uint32_t leftFirst; // first child for inner nodes, first triangle for leaves
+        glm::vec3 boundsMax;
+        std::uint32_t count;     // triangles in a leaf, 0 for inner nodes
+    };
+
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> order; // leaf order to original triangle index
+    std::uint32_t depth = 0;          // of the deepest leaf, the root being 0
+    std::vector<glm::vec3> vertex0, edge1, edge2;
+
+    static const int BINS = 8;
+
+    struct Bounds {
+        glm::vec3 boundsMin = glm::vec3(1e30f);
+        glm::vec3 boundsMax = glm::vec3(-1e30f);
+
+        void Grow(const glm::vec3& p)
+        {
+            boundsMin = glm::min(boundsMin, p);
+            boundsMax = glm::max(boundsMax, p);
+        }
+
+        void Grow(const Bounds& other)
+        {
+            boundsMin = glm::min(boundsMin, other.boundsMin);
+            boundsMax = glm::max(boundsMax, other.boundsMax);
+        }
+
+        float Area() const
+        {
+            glm::vec3 e = boundsMax - boundsMin;
+            return e.x < 0.0f ? 0.0f : e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+    };
+
+    void fitBounds(Node& node, const std::vector<glm::vec3>& corners) const
+    {
+        Bounds bounds;
+        for (std::uint32_t i = 0; i < node.count; i++)
+        {
+            std::uint32_t t = order[node.leftFirst + i];
+            bounds.Grow(corners[t * 3]);
+            bounds.Grow(corners[t * 3 + 1]);
+            bounds.Grow(corners[t * 3 + 2]);
+        }
+        node.boundsMin = bounds.boundsMin;
+        node.boundsMax = bounds.boundsMax;
+    }
+
+    // split a node in two if that is cheaper to trace than keeping it a leaf
+    bool subdivide(std::uint32_t index, const std::vector<glm::vec3>& corners, const std::vector<glm::vec3>& centroids)
+    {
+        Node node = nodes[index];
+        if (node.count <= 2)
+            return false;
+
+        Bounds centroidBounds;
+        for (std::uint32_t i = 0; i < node.count; i++)
+            centroidBounds.Grow(centroids[order[node.leftFirst + i]]);
+
+        int bestAxis = -1, bestSplit = 0;
+        float bestCost = 1e30f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float low = centroidBounds.boundsMin[axis], high = centroidBounds.boundsMax[axis];
+            if (high <= low)
+                continue;
+            Bounds bins[BINS];
+            std::uint32_t binCounts[BINS] = {};
+            float scale = BINS / (high - low);
+            for (std::uint32_t i = 0; i < node.count; i++)
+            {
+                std::uint32_t t = order[node.leftFirst + i];
+                int bin = std::min(BINS - 1, static_cast<int>((centroids[t][axis] - low) * scale));
+                binCounts[bin]++;
+                bins[bin].Grow(corners[t * 3]);
+                bins[bin].Grow(corners[t * 3 + 1]);
+                bins[bin].Grow(corners[t * 3 + 2]);
+            }
+            // sweep from both sides to get the area and count left and right of every split plane
+            float leftArea[BINS - 1], rightArea[BINS - 1];
+            std::uint32_t leftCount[BINS - 1], rightCount[BINS - 1];
+            Bounds left, right;
+            std::uint32_t leftSum = 0, rightSum = 0;
+            for (int i = 0; i < BINS - 1; i++)
+            {
+                leftSum += binCounts[i];
+                leftCount[i] = leftSum;
+                left.Grow(bins[i]);
+                leftArea[i] = left.Area();
+                rightSum += binCounts[BINS - 1 - i];
+                rightCount[BINS - 2 - i] = rightSum;
+                right.Grow(bins[BINS - 1 - i]);
+                rightArea[BINS - 2 - i] = right.Area();
+            }
+            for (int i = 0; i < BINS - 1; i++)
+            {
+                float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (leftCount[i] > 0 && rightCount[i] > 0 && cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i + 1;
+                }
+            }
+        }
+
+        Bounds nodeBounds;
+        nodeBounds.boundsMin = node.boundsMin;
+        nodeBounds.boundsMax = node.boundsMax;
+        if (bestAxis < 0 || bestCost >= node.count * nodeBounds.Area())
+            return false;
+
+        // partition the triangles in place around the chosen plane
+        float low = centroidBounds.boundsMin[bestAxis];
+        float scale = BINS / (centroidBounds.boundsMax[bestAxis] - low);
+        std::uint32_t* first = &order[node.leftFirst];
+        std::uint32_t* middle = std::partition(first, first + node.count, [&](std::uint32_t t) {
+            return std::min(BINS - 1, static_cast<int>((centroids[t][bestAxis] - low) * scale)) < bestSplit;
+        });
+        std::uint32_t leftCount = static_cast<std::uint32_t>(middle - first);
+
+        std::uint32_t leftChild = static_cast<std::uint32_t>(nodes.size());
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[leftChild].leftFirst = node.leftFirst;
+        nodes[leftChild].count = leftCount;
+        nodes[leftChild + 1].leftFirst = node.leftFirst + leftCount;
+        nodes[leftChild + 1].count = node.count - leftCount;
+        fitBounds(nodes[leftChild], corners);
+        fitBounds(nodes[leftChild + 1], corners);
+        nodes[index].leftFirst = leftChild;
+        nodes[index].count = 0;
+        return true;
+    }
+
+    // slab test; the distance to the box, or 1e30 when the ray misses it or it's farther than limit
+    static float boxDistance(const Node& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float limit)
+    {
+        glm::vec3 t0 = (node.boundsMin - origin) * inverseDirection;
+        glm::vec3 t1 = (node.boundsMax - origin) * inverseDirection;
+        glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+        float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(std::min(far.x, far.y), std::min(far.z, limit));
+        return enter <= exit ? enter : 1e30f;
+    }
+
+    template <bool ANY_HIT>
+    bool traverse(const glm::vec3& origin, const glm::vec3& direction, BakeHit& hit) const
+    {
+        if (order.empty())
+            return false;
+        const glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        bool found = false;
+        // at most one postponed sibling per level; unbalanced trees deeper than the fixed array use the heap
+        std::uint32_t fixedStack[64];
+        std::vector<std::uint32_t> deepStack;
+        std::uint32_t* stack = fixedStack;
+        if (depth > 64)
+        {
+            deepStack.resize(depth);
+            stack = deepStack.data();
+        }
+        int top = 0;
+        if (boxDistance(nodes[0], origin, inverseDirection, hit.distance) == 1e30f)
+            return false;
+        std::uint32_t current = 0;
+        for (;;)
+        {
+            const Node& node = nodes[current];
+            if (node.count > 0)
+            {
+                for (std::uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++)
+                {
+                    if (intersectTriangle(i, origin, direction, hit))
+                    {
+                        hit.triangle = order[i];
+                        found = true;
+                        if (ANY_HIT)
+                            return true;
+                    }
+                }
+            }
+            else
+            {
+                // visit the nearer child first; the farther one waits on the stack
+                std::uint32_t near = node.leftFirst, far = node.leftFirst + 1;
+                float nearDistance = boxDistance(nodes[near], origin, inverseDirection, hit.distance);
+                float farDistance = boxDistance(nodes[far], origin, inverseDirection, hit.distance);
+                if (farDistance < nearDistance)
+                {
+                    std::swap(near, far);
+                    std::swap(nearDistance, farDistance);
+                }
+                if (nearDistance != 1e30f)
+                {
+                    if (farDistance != 1e30f)
+                        stack[top++] = far;
+                    current = near;
+                    continue;
+                }
+            }
+            if (top == 0)
+                break;
+            current = stack[--top];
+        }
+        return found;
+    }
+
+    // Moller-Trumbore; updates hit when the triangle is closer than hit.distance
+    bool intersectTriangle(std::uint32_t i, const glm::vec3& origin, const glm::vec3& direction, BakeHit& hit) const
+    {
+        glm::vec3 p = glm::cross(direction, edge2[i]);
+        float determinant = glm::dot(edge1[i], p);
+        if (std::fabs(determinant) < 1e-12f)
+            return false;
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = origin - vertex0[i];
+        float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, edge1[i]);
+        float v = glm::dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        float distance = glm::dot(edge2[i], q) * inverse;
+        if (distance <= 0.0f || distance >= hit.distance)
+            return false;
+        hit.distance = distance;
+        hit.u = u;
+        hit.v = v;
+        return true;
+    }
+};
+
+class LightBaker {
+public:
+    LightBakeSettings settings;
+    std::vector<DirLight> dirLights;
+    std::vector<PointLight> pointLights;
+    std::vector<SpotLight> spotLights;
+    LightBakeStats stats;
+
+    /*  Add a static mesh: any vertex type with Position and Normal (Mesh's Vertex), its model
+        matrix and its lightmap coordinates, one per vertex. Meshes without lightmap coordinates
+        still cast shadows and bounce light but can't be baked to a lightmap. albedo is the
+        average diffuse color, used for the light the mesh reflects onto others. Returns the
+        mesh index for BakeLightmap. */
+    template <typename VertexType>
+    size_t AddMesh(const std::vector<VertexType>& vertices, const std::vector<unsigned int>& indices, const glm::mat4& model,
+                   const std::vector<glm::vec2>& lightmapCoords = std::vector<glm::vec2>(), const glm::vec3& albedo = glm::vec3(0.5f))
+    {
+        glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(model)));
+        MeshRange range;
+        range.firstTriangle = static_cast<std::uint32_t>(corners.size() / 3);
+        range.triangleCount = static_cast<std::uint32_t>(indices.size() / 3);
+        range.hasLightmapCoords = lightmapCoords.size() == vertices.size();
+        range.albedo = albedo;
+        for (size_t i = 0; i < range.triangleCount * 3; i++)
+        {
+            const VertexType& vertex = vertices[indices[i]];
+            corners.push_back(glm::vec3(model * glm::vec4(vertex.Position, 1.0f)));
+            normals.push_back(glm::normalize(normalTransform * vertex.Normal));
+            uvs.push_back(range.hasLightmapCoords ? lightmapCoords[indices[i]] : glm::vec2(0.0f));
+        }
+        triangleMesh.insert(triangleMesh.end(), range.triangleCount, static_cast<std::uint32_t>(meshes.size()));
+        meshes.push_back(range);
+        built = false;
+        return meshes.size() - 1;
+    }
+
+    // (re)build the ray tracing structure; called by the bake functions when meshes were added
+    void Build()
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        bvh.Build(corners);
+        built = true;
+        stats.buildSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    const TriangleBVH& BVH() const
+    {
+        return bvh;
+    }
+
+    Lightmap BakeLightmap(size_t mesh, int width, int height, const ParallelFor& parallelFor = serialFor)
+    {
+        Lightmap lightmap;
+        lightmap.width = width;
+        lightmap.height = height;
+        lightmap.texels.assign(size_t(width) * height, glm::vec3(0.0f));
+        if (mesh >= meshes.size() || !meshes[mesh].hasLightmapCoords)
+        {
+            std::cout << "ERROR::LIGHT_BAKER::MESH_HAS_NO_LIGHTMAP_COORDINATES: " << mesh << std::endl;
+            return lightmap;
+        }
+        if (!built)
+            Build();
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+        // find the surface point behind every texel center by rasterizing the mesh in lightmap space
+        std::vector<glm::vec3> positions(lightmap.texels.size()), texelNormals(lightmap.texels.size());
+        std::vector<unsigned char> covered(lightmap.texels.size(), 0);
+        const MeshRange& range = meshes[mesh];
+        for (std::uint32_t t = range.firstTriangle; t < range.firstTriangle + range.triangleCount; t++)
+            rasterizeTexels(t, width, height, positions, texelNormals, covered);
+
+        std::atomic<size_t> rays(0), texels(0);
+        parallelFor(size_t(height), 4, [&](size_t begin, size_t end) {
+            size_t localRays = 0, localTexels = 0;
+            for (size_t y = begin; y < end; y++)
+                for (size_t x = 0; x < size_t(width); x++)
+                {
+                    size_t i = y * width + x;
+                    if (!covered[i])
+                        continue;
+                    std::uint32_t seed = hash(static_cast<std::uint32_t>(i) * 9781u + static_cast<std::uint32_t>(mesh) * 6271u);
+                    lightmap.texels[i] = shade(positions[i], texelNormals[i], seed, localRays);
+                    localTexels++;
+                }
+            rays += localRays;
+            texels += localTexels;
+        });
+        dilate(lightmap, covered, settings.dilation);
+
+        stats.rays += rays;
+        stats.texels += texels;
+        stats.bakeSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        return lightmap;
+    }
+
+    void BakeProbes(LightProbeGrid& grid, const ParallelFor& parallelFor = serialFor)
+    {
+        if (!built)
+            Build();
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        // cosine lobe convolution per band, divided by pi to match the baked value's scale
+        const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+        const int samples = std::max(settings.probeSamples, 1);
+
+        std::atomic<size_t> rays(0);
+        parallelFor(grid.probes.size(), 1, [&](size_t begin, size_t end) {
+            size_t localRays = 0;
+            for (size_t p = begin; p < end; p++)
+            {
+                glm::vec3 position = grid.Position(p);
+                glm::vec3 radiance[9];
+                for (int i = 0; i < 9; i++)
+                    radiance[i] = glm::vec3(0.0f);
+                float basis[9];
+
+                // light reflected by the scene and the sky, from evenly spread directions
+                std::uint32_t seed = hash(static_cast<std::uint32_t>(p) * 7919u + 17u);
+                for (int s = 0; s < samples; s++)
+                {
+                    glm::vec3 direction = fibonacciSphere(s, samples, random(seed));
+                    shBasis(direction, basis);
+                    glm::vec3 incoming = traceRadiance(position, direction, localRays);
+                    for (int i = 0; i < 9; i++)
+                        radiance[i] += incoming * (basis[i] * 4.0f * glm::pi<float>() / samples);
+                }
+
+                // the lights themselves are points: project each visible one directly
+                for (const DirLight& light : dirLights)
+                {
+                    glm::vec3 lightDir = glm::normalize(-light.direction);
+                    addAmbient(radiance, light.ambient);
+                    localRays++;
+                    if (!bvh.Occluded(position, lightDir, 1e30f))
+                        addDirectional(radiance, lightDir, light.diffuse);
+                }
+                for (const PointLight& light : pointLights)
+                {
+                    glm::vec3 toLight = light.position - position;
+                    float distance = glm::length(toLight);
+                    float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, distance);
+                    addAmbient(radiance, light.ambient * attenuation);
+                    localRays++;
+                    if (distance > 0.0f && !bvh.Occluded(position, toLight / distance, distance))
+                        addDirectional(radiance, toLight / distance, light.diffuse * attenuation);
+                }
+                for (const SpotLight& light : spotLights)
+                {
+                    glm::vec3 toLight = light.position - position;
+                    float distance = glm::length(toLight);
+                    float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, distance);
+                    addAmbient(radiance, light.ambient * attenuation);
+                    if (distance <= 0.0f)
+                        continue;
+                    float intensity = calcSpotIntensity(toLight / distance, light.direction, light.cutOff, light.outerCutOff);
+                    localRays++;
+                    if (intensity > 0.0f && !bvh.Occluded(position, toLight / distance, distance))
+                        addDirectional(radiance, toLight / distance, light.diffuse * (attenuation * intensity));
+                }
+
+                for (int i = 0; i < 9; i++)
+                    grid.probes[p].coefficients[i] = radiance[i] * band[i];
+            }
+            rays += localRays;
+        });
+
+        stats.rays += rays;
+        stats.probes += grid.probes.size();
+        stats.bakeSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+private:
+    struct MeshRange {
+        std::uint32_t firstTriangle;
+        std::uint32_t triangleCount;
+        bool hasLightmapCoords;
+        glm::vec3 albedo;
+    };
+
+    std::vector<MeshRange> meshes;
+    std::vector<glm::vec3> corners;           // world space, three per triangle
+    std::vector<glm::vec3> normals;           // world space, three per triangle
+    std::vector<glm::vec2> uvs;               // lightmap coordinates, three per triangle
+    std::vector<std::uint32_t> triangleMesh;  // mesh of every triangle
+    TriangleBVH bvh;
+    bool built = false;
+
+    static std::uint32_t hash(std::uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // uniform in [0, 1)
+    static float random(std::uint32_t& state)
+    {
+        state = hash(state + 0x9e3779b9u);
+        return (state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // point s of count spread evenly over the sphere, turned by offset so probes don't share directions
+    static glm::vec3 fibonacciSphere(int s, int count, float offset)
+    {
+        float z = 1.0f - (2.0f * s + 1.0f) / count;
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float phi = 2.39996323f * s + offset * 2.0f * glm::pi<float>();
+        return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    // cosine weighted direction around normal
+    static glm::vec3 cosineHemisphere(const glm::vec3& normal, std::uint32_t& seed)
+    {
+        float u1 = random(seed), u2 = random(seed);
+        float r = std::sqrt(u1), phi = 2.0f * glm::pi<float>() * u2;
+        glm::vec3 tangent = std::fabs(normal.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        tangent = glm::normalize(glm::cross(tangent, normal));
+        glm::vec3 bitangent = glm::cross(normal, tangent);
+        return glm::normalize(tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * std::sqrt(std::max(0.0f, 1.0f - u1)));
+    }
+
+    static void addAmbient(glm::vec3 radiance[9], const glm::vec3& ambient)
+    {
+        // a constant that survives the band 0 convolution unchanged
+        radiance[0] += ambient / 0.282095f;
+    }
+
+    // a light from direction with the strength the shaders' diffuse term would give it
+    static void addDirectional(glm::vec3 radiance[9], const glm::vec3& direction, const glm::vec3& diffuse)
+    {
+        float basis[9];
+        shBasis(direction, basis);
+        for (int i = 0; i < 9; i++)
+            radiance[i] += diffuse * (basis[i] * glm::pi<float>());
+    }
+
+    // ambient and shadowed diffuse of every light at a surface point, as in lighting.h without the colors
+    glm::vec3 directLight(const glm::vec3& position, const glm::vec3& normal, size_t& rays) const
+    {
+        glm::vec3 origin = position + normal * settings.bias;
+        glm::vec3 result(0.0f);
+        for (const DirLight& light : dirLights)
+        {
+            glm::vec3 lightDir = glm::normalize(-light.direction);
+            float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+            result += light.ambient;
+            if (diff > 0.0f)
+            {
+                rays++;
+                if (!bvh.Occluded(origin, lightDir, 1e30f))
+                    result += light.diffuse * diff;
+            }
+        }
+        for (const PointLight& light : pointLights)
+        {
+            glm::vec3 toLight = light.position - origin;
+            float distance = glm::length(toLight);
+            float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, glm::length(light.position - position));
+            glm::vec3 lit = light.ambient;
+            float diff = distance > 0.0f ? std::max(glm::dot(normal, toLight / distance), 0.0f) : 0.0f;
+            if (diff > 0.0f)
+            {
+                rays++;
+                if (!bvh.Occluded(origin, toLight / distance, distance))
+                    lit += light.diffuse * diff;
+            }
+            result += lit * attenuation;
+        }
+        for (const SpotLight& light : spotLights)
+        {
+            glm::vec3 toLight = light.position - origin;
+            float distance = glm::length(toLight);
+            float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, glm::length(light.position - position));
+            glm::vec3 lit = light.ambient;
+            if (distance > 0.0f)
+            {
+                glm::vec3 lightDir = toLight / distance;
+                float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+                float intensity = calcSpotIntensity(lightDir, light.direction, light.cutOff, light.outerCutOff);
+                if (diff > 0.0f && intensity > 0.0f)
+                {
+                    rays++;
+                    if (!bvh.Occluded(origin, lightDir, distance))
+                        lit += light.diffuse * (diff * intensity);
+                }
+            }
+            result += lit * attenuation;
+        }
+        return result;
+    }
+
+    // light leaving the first surface along a ray: its direct light times its albedo, or the sky
+    glm::vec3 traceRadiance(const glm::vec3& origin, const glm::vec3& direction, size_t& rays) const
+    {
+        BakeHit hit;
+        rays++;
+        if (!bvh.Intersect(origin, direction, 1e30f, hit))
+            return settings.skyColor;
+        std::uint32_t t = hit.triangle;
+        float w = 1.0f - hit.u - hit.v;
+        glm::vec3 position = corners[t * 3] * w + corners[t * 3 + 1] * hit.u + corners[t * 3 + 2] * hit.v;
+        glm::vec3 normal = glm::normalize(normals[t * 3] * w + normals[t * 3 + 1] * hit.u + normals[t * 3 + 2] * hit.v);
+        // the back of a surface is lit like its front
+        if (glm::dot(normal, direction) > 0.0f)
+            normal = -normal;
+        return meshes[triangleMesh[t]].albedo * directLight(position, normal, rays);
+    }
+
+    // direct light plus one bounce, averaged over cosine weighted directions
+    glm::vec3 shade(const glm::vec3& position, const glm::vec3& normal, std::uint32_t seed, size_t& rays) const
+    {
+        glm::vec3 result = directLight(position, normal, rays);
+        if (settings.indirectSamples <= 0)
+            return result;
+        glm::vec3 origin = position + normal * settings.bias;
+        glm::vec3 indirect(0.0f);
+        for (int s = 0; s < settings.indirectSamples; s++)
+            indirect += traceRadiance(origin, cosineHemisphere(normal, seed), rays);
+        return result + indirect / float(settings.indirectSamples);
+    }
+
+    void rasterizeTexels(std::uint32_t t, int width, int height, std::vector<glm::vec3>& positions,
+                         std::vector<glm::vec3>& texelNormals, std::vector<unsigned char>& covered) const
+    {
+        glm::vec2 p[3];
+        for (int k = 0; k < 3; k++)
+            p[k] = uvs[t * 3 + k] * glm::vec2(float(width), float(height));
+        float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+        if (std::fabs(area) < 1e-12f)
+            return;
+        int minX = std::max(0, static_cast<int>(std::floor(std::min(p[0].x, std::min(p[1].x, p[2].x)))));
+        int minY = std::max(0, static_cast<int>(std::floor(std::min(p[0].y, std::min(p[1].y, p[2].y)))));
+        int maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max(p[0].x, std::max(p[1].x, p[2].x)))));
+        int maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max(p[0].y, std::max(p[1].y, p[2].y)))));
+        for (int y = minY; y <= maxY; y++)
+            for (int x = minX; x <= maxX; x++)
+            {
+                glm::vec2 c(x + 0.5f, y + 0.5f);
+                float b1 = ((c.x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (c.y - p[0].y)) / area;
+                float b2 = ((p[1].x - p[0].x) * (c.y - p[0].y) - (c.x - p[0].x) * (p[1].y - p[0].y)) / area;
+                float b0 = 1.0f - b1 - b2;
+                if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+                    continue;
+                size_t i = size_t(y) * width + x;
+                positions[i] = corners[t * 3] * b0 + corners[t * 3 + 1] * b1 + corners[t * 3 + 2] * b2;
+                texelNormals[i] = glm::normalize(normals[t * 3] * b0 + normals[t * 3 + 1] * b1 + normals[t * 3 + 2] * b2);
+                covered[i] = 1;
+            }
+    }
+
+    // fill empty texels next to charts with the average of their filled neighbours, one ring per pass
+    static void dilate(Lightmap& lightmap, std::vector<unsigned char>& covered, int passes)
+    {
+        const int width = lightmap.width, height = lightmap.height;
+        std::vector<unsigned char> next;
+        for (int pass = 0; pass < passes; pass++)
+        {
+            next = covered;
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                {
+                    size_t i = size_t(y) * width + x;
+                    if (covered[i])
+                        continue;
+                    glm::vec3 sum(0.0f);
+                    int count = 0;
+                    for (int dy = -1; dy <= 1; dy++)
+                        for (int dx = -1; dx <= 1; dx++)
+                        {
+                            int nx = x + dx, ny = y + dy;
+                            if (nx < 0 || ny < 0 || nx >= width || ny >= height || !covered[size_t(ny) * width + nx])
+                                continue;
+                            sum += lightmap.texels[size_t(ny) * width + nx];
+                            count++;
+                        }
+                    if (count > 0)
+                    {
+                        lightmap.texels[i] = sum / float(count);
+                        next[i] = 1;
+                    }
+                }
+            covered.swap(next);
+        }
+    }
+};
+#endif
@@ -218,3 +218,28 @@
 
 	
 	
+
+
+/*	Sharing Lighting Code
+
+	By now the attenuation formula and the spotlight intensity have been typed out in several
+	shaders. GLSL has no #include, so the shared versions live in lighting.glsl (calcAttenuation,
+	calcSpotIntensity, calcDirLight, calcPointLight, calcSpotLight) and glsl_preprocessor.h
+	pastes them in before the source is handed to the driver: */
+
+			#version 330 core
+			#include "lighting.glsl"
+
+			uniform SpotLight light;
+			...
+			vec3 color = calcSpotLight(light, norm, FragPos, viewDir, diffuseColor, specularColor, material.shininess);
+
+/*	The preprocessor also injects #defines after #version and emits #line directives, so an error
+	reported by the driver at "1(42)" can be turned back into "lighting.glsl:42" with TranslateLog.
+	Expanded sources are cached, and each one remembers the files it read: after editing
+	lighting.glsl, Invalidate("lighting.glsl") returns only the shaders that include it.
+
+			GLSLPreprocessor preprocessor;
+			preprocessor.AddIncludeDirectory("Lighting");
+			const ExpandedSource& fragment = preprocessor.Expand("light_casters.fs");
+*/
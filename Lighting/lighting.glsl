@@ -0,0 +1,99 @@
+// Shared Phong lighting functions for the lighting shaders. Include with
+//     #include "lighting.glsl"
+// The caller samples its material maps once per fragment and passes the colors in, so the
+// textures aren't sampled again for every light.
+#pragma once
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Fatt = 1.0 / (Kc + Kl * d + Kq * d^2)
+float calcAttenuation(float constant, float linear, float quadratic, float distance)
+{
+    return 1.0 / (constant + linear * distance + quadratic * (distance * distance));
+}
+
+// smooth-edged spotlight: 1.0 inside the inner cone, fading to 0.0 at the outer cone
+float calcSpotIntensity(vec3 lightDir, vec3 spotDirection, float cutOff, float outerCutOff)
+{
+    float theta = dot(lightDir, normalize(-spotDirection));
+    float epsilon = cutOff - outerCutOff;
+    return clamp((theta - outerCutOff) / epsilon, 0.0, 1.0);
+}
+
+float calcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir, float shininess)
+{
+    vec3 reflectDir = reflect(-lightDir, normal);
+    return pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+}
+
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = calcSpecular(lightDir, normal, viewDir, shininess);
+
+    vec3 ambient  = light.ambient  * diffuseColor;
+    vec3 diffuse  = light.diffuse  * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    return ambient + diffuse + specular;
+}
+
+vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = calcSpecular(lightDir, normal, viewDir, shininess);
+    float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, length(light.position - fragPos));
+
+    vec3 ambient  = light.ambient  * diffuseColor;
+    vec3 diffuse  = light.diffuse  * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = calcSpecular(lightDir, normal, viewDir, shininess);
+    float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, length(light.position - fragPos));
+    float intensity = calcSpotIntensity(lightDir, light.direction, light.cutOff, light.outerCutOff);
+
+    vec3 ambient  = light.ambient  * diffuseColor;
+    vec3 diffuse  = light.diffuse  * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + (diffuse + specular) * intensity) * attenuation;
+}
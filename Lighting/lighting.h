@@ -0,0 +1,109 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// C++ version of lighting.glsl for code that shades on the CPU (the software rasterizer, light
+// baking). The structs and functions mirror the GLSL ones one to one, so a change to one file
+// has to be made in the other as well.
+
+struct DirLight {
+    glm::vec3 direction;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+struct PointLight {
+    glm::vec3 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+struct SpotLight {
+    glm::vec3 position;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+// Fatt = 1.0 / (Kc + Kl * d + Kq * d^2)
+inline float calcAttenuation(float constant, float linear, float quadratic, float distance)
+{
+    return 1.0f / (constant + linear * distance + quadratic * (distance * distance));
+}
+
+// smooth-edged spotlight: 1.0 inside the inner cone, fading to 0.0 at the outer cone
+inline float calcSpotIntensity(const glm::vec3& lightDir, const glm::vec3& spotDirection, float cutOff, float outerCutOff)
+{
+    float theta = glm::dot(lightDir, glm::normalize(-spotDirection));
+    float epsilon = cutOff - outerCutOff;
+    return std::min(std::max((theta - outerCutOff) / epsilon, 0.0f), 1.0f);
+}
+
+inline float calcSpecular(const glm::vec3& lightDir, const glm::vec3& normal, const glm::vec3& viewDir, float shininess)
+{
+    glm::vec3 reflectDir = glm::reflect(-lightDir, normal);
+    return std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), shininess);
+}
+
+inline glm::vec3 calcDirLight(const DirLight& light, const glm::vec3& normal, const glm::vec3& viewDir,
+                              const glm::vec3& diffuseColor, const glm::vec3& specularColor, float shininess)
+{
+    glm::vec3 lightDir = glm::normalize(-light.direction);
+    float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+    float spec = calcSpecular(lightDir, normal, viewDir, shininess);
+
+    glm::vec3 ambient  = light.ambient  * diffuseColor;
+    glm::vec3 diffuse  = light.diffuse  * diff * diffuseColor;
+    glm::vec3 specular = light.specular * spec * specularColor;
+    return ambient + diffuse + specular;
+}
+
+inline glm::vec3 calcPointLight(const PointLight& light, const glm::vec3& normal, const glm::vec3& fragPos, const glm::vec3& viewDir,
+                                const glm::vec3& diffuseColor, const glm::vec3& specularColor, float shininess)
+{
+    glm::vec3 lightDir = glm::normalize(light.position - fragPos);
+    float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+    float spec = calcSpecular(lightDir, normal, viewDir, shininess);
+    float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, glm::length(light.position - fragPos));
+
+    glm::vec3 ambient  = light.ambient  * diffuseColor;
+    glm::vec3 diffuse  = light.diffuse  * diff * diffuseColor;
+    glm::vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+inline glm::vec3 calcSpotLight(const SpotLight& light, const glm::vec3& normal, const glm::vec3& fragPos, const glm::vec3& viewDir,
+                               const glm::vec3& diffuseColor, const glm::vec3& specularColor, float shininess)
+{
+    glm::vec3 lightDir = glm::normalize(light.position - fragPos);
+    float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+    float spec = calcSpecular(lightDir, normal, viewDir, shininess);
+    float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, glm::length(light.position - fragPos));
+    float intensity = calcSpotIntensity(lightDir, light.direction, light.cutOff, light.outerCutOff);
+
+    glm::vec3 ambient  = light.ambient  * diffuseColor;
+    glm::vec3 diffuse  = light.diffuse  * diff * diffuseColor;
+    glm::vec3 specular = light.specular * spec * specularColor;
+    return (ambient + (diffuse + specular) * intensity) * attenuation;
+}
+#endif
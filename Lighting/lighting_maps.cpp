@@ -77,6 +77,200 @@
 			vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
 			fragColor = vec4(ambient + diffuse + specular, 1.0);
 
+/*	Binding Textures Once
+
+	The render loop below binds diffuseMap to GL_TEXTURE0 and specularMap to GL_TEXTURE1 every
+	frame, and an object with different maps would need its own binds before its draw. Those binds
+	are also what keeps objects with different materials from being drawn in one call.
+
+	material_textures.h uploads every material's maps once. Textures of the same size are stacked
+	into a GL_TEXTURE_2D_ARRAY (or, with ARB_bindless_texture, made resident and referenced by a
+	64-bit handle) and each material stores where its maps are in a shader storage buffer. The
+	shader only needs a material ID: */
+
+			#include "material_textures.glsl"
+
+			uniform int materialID;
+			...
+			vec3 diffuseColor  = vec3(sampleDiffuse(materialID, TexCoords));
+			vec3 specularColor = vec3(sampleSpecular(materialID, TexCoords));
+
+//	And on the C++ side:
+
+			MaterialTextures materialTextures;
+			MaterialTextureRef diffuse  = materialTextures.LoadTexture("container2.png");
+			MaterialTextureRef specular = materialTextures.LoadTexture("container2_specular.png");
+			unsigned int container = materialTextures.AddMaterial(diffuse, specular, 64.0f);
+			materialTextures.Upload();
+			...
+			// once per frame instead of per object
+			materialTextures.Bind(lightingShader.ID);
+			lightingShader.setInt("materialID", container);
+
+/*	Simulation and Rendering on Separate Threads
+
+	The render loop below measures deltaTime with glfwGetTime() and moves the camera by that much.
+	Whenever a frame takes long to render, the next deltaTime is large and the camera jumps; the
+	simulation can never run faster or more evenly than the GPU lets it.
+
+	frame_pipeline.h moves the simulation to its own thread, stepping at a fixed rate. Each step
+	writes a FramePacket (camera state, object transforms, visible objects) into a triple buffer,
+	so neither thread ever waits for the other. GLFW still has to be polled on the window thread,
+	which forwards the input: */
+
+			FramePipeline pipeline(1.0 / 120.0, [&](double step, const SimulationInput& input, FramePacket& packet) {
+				if (input.forward)
+					camera.ProcessKeyboard(FORWARD, (float)step);
+				...
+				camera.ProcessMouseMovement(input.mouseX, input.mouseY);
+				camera.Update();
+				packet.camera = { camera.Position, camera.Orientation, camera.Zoom };
+				packet.transforms.assign(objects.begin(), objects.end());
+			});
+			pipeline.Start();
+
+			while (!glfwWindowShouldClose(window))
+			{
+				glfwPollEvents();
+				pipeline.SetKeys(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS, ...);
+				pipeline.Acquire();
+				CameraState view = pipeline.InterpolatedCamera();
+				lightingShader.setMat4("view", view.ViewMatrix());
+				lightingShader.setMat4("model", pipeline.Model(0));
+				...
+			}
+			pipeline.Stop();
+
+/*	The camera now lives on the simulation thread, so mouse_callback calls pipeline.AddMouse
+	instead of camera.ProcessMouseMovement. Since steps arrive at their own rate, each packet also
+	carries the state of the step before it, and the renderer blends the two by how much time has
+	passed since the packet was published, never across packets it skipped.
+	That keeps motion smooth at any frame rate, at the cost of one step of latency. */
+
+/*	Baking Static Light
+
+	The light and the container don't move, yet the fragment shader works out the same ambient and
+	diffuse terms for every fragment every frame. light_baker.h computes them once, offline, with
+	shadows and light bounced off other surfaces, which the shader can't afford to do: */
+
+			LightBaker baker;
+			baker.pointLights.push_back(pointLight);
+			size_t floor = baker.AddMesh(floorMesh.vertices, floorMesh.indices, model, floorLightmapCoords);
+			baker.AddMesh(container.vertices, container.indices, containerModel);
+			baker.BakeLightmap(floor, 512, 512, jobs.Parallel()).Save("floor.lmap");
+
+			LightProbeGrid probes;
+			probes.Resize(glm::vec3(-10.0f, 0.0f, -10.0f), glm::vec3(10.0f, 4.0f, 10.0f), 9, 3, 9);
+			baker.BakeProbes(probes, jobs.Parallel());
+			probes.Save("scene.prob");
+
+/*	A lightmap needs a second set of texture coordinates in which no two triangles overlap; the
+	modelling tool exports them as a second UV channel and Mesh::SetLightmapCoords passes them to
+	the vertex shader. The fragment shader then only adds the specular highlight to the baked value:
+
+		#include "baked_lighting.glsl"
+		...
+		vec3 baked = sampleLightmap(LightmapCoords);  // or evaluateProbe(norm) for moving objects
+		vec3 result = baked * diffuseColor + light.specular * calcSpecular(lightDir, norm, viewDir, material.shininess) * specularColor;
+
+	Moving objects take the probe closest to them, blended from the grid with probes.Sample and
+	set with setProbeUniform. */
+
+/*	Replaying the Same Camera Path
+
+	Frame times are only worth comparing when both runs look at the same thing, and a camera
+	steered by hand never moves the same way twice. input_capture.h sits between GLFW and our
+	callbacks: it can record the key, cursor and scroll events of a session to a file, and play
+	them back later on a fixed timestep instead of glfwGetTime(). The callbacks are installed
+	through it, the render loop takes its deltaTime from it and processInput asks it for keys: */
+
+			inputCapture().Attach(window, mouse_callback, scroll_callback);
+			if (recording)
+				inputCapture().Record("camera_path.input");
+			else if (replaying)
+				inputCapture().Replay("camera_path.input", 1.0 / 60.0);
+
+			while (!glfwWindowShouldClose(window) && !inputCapture().Finished())
+			{
+				deltaTime = inputCapture().BeginFrame();
+				...
+			}
+			inputCapture().Stop();
+			inputCapture().WriteFrameTimes("frame_times.csv");
+
+/*	During a replay every frame simulates exactly 1/60th of a second no matter how long it took,
+	so the camera passes the same points on every machine, and the frame times it measured
+	(Summarize gives the mean, median, 95th and 99th percentile) are a fair A/B comparison. */
+
+/*	Reloading Shaders and Textures
+
+	Changing a shader or one of the container textures means restarting the program and loading
+	everything again. hot_reload.h watches the files instead (inotify on Linux) and rebuilds only
+	what a change affects: the preprocessor knows which shaders include an edited file, so editing
+	lighting.glsl recompiles just the programs built from it. New programs are swapped in between
+	frames, and only once they have linked; one with errors leaves the old version running. Changed
+	images are decoded on the job system's workers and uploaded into the same texture names: */
+
+			HotReload hotReload(preprocessor, programCache, jobs);
+			hotReload.WatchProgram(lightingShader.ID, { { GL_VERTEX_SHADER, "4.2.lighting_maps.vs" },
+			                                            { GL_FRAGMENT_SHADER, "4.2.lighting_maps.fs" } },
+				[&](unsigned int) {
+					// uniforms set once at startup are gone with the old program
+					lightingShader.use();
+					lightingShader.setInt("material.diffuse", 0);
+					lightingShader.setInt("material.specular", 1);
+				});
+			hotReload.WatchTexture(diffuseMap, FileSystem::getPath("resources/textures/container2.png"));
+			hotReload.WatchTexture(specularMap, FileSystem::getPath("resources/textures/container2_specular.png"));
+
+			while (!glfwWindowShouldClose(window))
+			{
+				hotReload.Update();
+				...
+			}
+
+/*	Textures Larger Than Memory
+
+	loadTexture keeps every mip of a texture on the GPU, whether one texel of it is on screen or
+	all of them. For a terrain or a big atlas that stops fitting long before it stops being useful.
+	virtual_texture.h cuts such a texture into 128x128 pages per mip level, offline: */
+
+			unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 4);
+			writeVirtualTexture("terrain.vtex", data, width, height);
+
+/*	At run time only the pages that are on screen are in GPU memory, in a cache texture of a fixed
+	size, with a small indirection texture that says which page is where. The shader includes
+	virtual_texture.glsl and calls sampleVirtual(TexCoords) instead of texture(material.diffuse,
+	TexCoords). To find out which pages are needed the scene is drawn a second time, eight times
+	smaller, with a shader that writes virtualFeedback(TexCoords); a few frames later those pixels
+	have been read back and become requests: */
+
+			JobSystem jobs;
+			VirtualTextureSettings settings;
+			settings.cachePages = virtualCachePages(SCR_WIDTH, SCR_HEIGHT);
+			VirtualTexture terrain(jobs, "terrain.vtex", settings);
+			VirtualTextureFeedback feedback(SCR_WIDTH, SCR_HEIGHT);
+
+			while (!glfwWindowShouldClose(window))
+			{
+				feedback.Begin();
+				terrain.Bind(feedbackShader.ID, 0, feedback.Bias());
+				drawScene(feedbackShader);
+				feedback.End();
+				glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+
+				feedback.Collect({ &terrain });
+				terrain.Update(); // read requested pages, upload the ones that arrived
+
+				terrain.Bind(lightingShader.ID);
+				drawScene(lightingShader);
+				...
+			}
+
+/*	A page that hasn't arrived yet is drawn from the closest coarser page that has, so a fast turn
+	shows a blurry patch for a few frames rather than a hole. The memory used is the cache, about
+	twice what one screen full of texels needs, whatever the size of the texture. */
+
 // Full learnOpenGL source code:
 
 #include <glad/glad.h>
@@ -90,6 +284,9 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 
+#include "../Advanced OpenGL/gpu_memory.h"
+#include "../In Practice/input_capture.h"
+
 #include <iostream>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -110,7 +307,6 @@ bool firstMouse = true;
 
 // timing
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
 
 // lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
@@ -139,8 +335,8 @@ int main()
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+    // input goes through the capture layer so a session can be recorded and replayed
+    inputCapture().Attach(window, mouse_callback, scroll_callback);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -215,6 +411,7 @@ int main()
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    gpuMemory().TrackBuffer(VBO, sizeof(vertices), GPU_MEMORY_VERTEX, "cube", GPU_MEMORY_SITE);
 
     glBindVertexArray(cubeVAO);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -252,9 +449,7 @@ int main()
     {
         // per-frame time logic
         // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        deltaTime = inputCapture().BeginFrame();
 
         // input
         // -----
@@ -323,7 +518,13 @@ int main()
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &lightCubeVAO);
+    gpuMemory().Release(GPU_RESOURCE_BUFFER, VBO);
     glDeleteBuffers(1, &VBO);
+    gpuMemory().Release(GPU_RESOURCE_TEXTURE, diffuseMap);
+    gpuMemory().Release(GPU_RESOURCE_TEXTURE, specularMap);
+    glDeleteTextures(1, &diffuseMap);
+    glDeleteTextures(1, &specularMap);
+    gpuMemory().Report(std::cout);
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -338,13 +539,13 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (inputCapture().GetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (inputCapture().GetKey(window, GLFW_KEY_S) == GLFW_PRESS)
         camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (inputCapture().GetKey(window, GLFW_KEY_A) == GLFW_PRESS)
         camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (inputCapture().GetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
@@ -409,6 +610,7 @@ unsigned int loadTexture(char const * path)
         glBindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        gpuMemory().TrackTexture(textureID, format, width, height, 1, fullMipLevels(width, height), GPU_MEMORY_TEXTURE, path, GPU_MEMORY_SITE);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -139,3 +139,124 @@ lightingShader.setFloat("pointLights[0].constant", 1.0f);
 			
 
 
+/*	Shader Permutations
+
+	NR_POINT_LIGHTS is fixed at 4, so every fragment loops over four point lights even when only
+	one of them reaches the object, and the spotlight and specular map code runs whether or not
+	the material uses them. Instead of one shader that handles every case at runtime we can
+	compile a variant per case. The shader declares the feature keys it reacts to, and leaves the
+	values to be injected as #defines right after #version: */
+
+#version 330 core
+#pragma feature NR_DIR_LIGHTS
+#pragma feature NR_POINT_LIGHTS
+#pragma feature NR_SPOT_LIGHTS
+#pragma feature HAS_SPECULAR_MAP
+#include "lighting.glsl"
+
+#if NR_POINT_LIGHTS > 0
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+#endif
+
+void main() {
+	vec3 norm = normalize(Normal);
+	vec3 viewDir = normalize(viewPos - fragPos);
+	vec3 diffuseColor = vec3(texture(material.diffuse, TexCoords));
+#ifdef HAS_SPECULAR_MAP
+	vec3 specularColor = vec3(texture(material.specular, TexCoords));
+#else
+	vec3 specularColor = material.specularColor;
+#endif
+	vec3 result = vec3(0.0);
+
+#if NR_DIR_LIGHTS > 0
+	result += calcDirLight(dirLight, norm, viewDir, diffuseColor, specularColor, material.shininess);
+#endif
+#if NR_POINT_LIGHTS > 0
+	for (int i = 0; i < NR_POINT_LIGHTS; i++)
+		result += calcPointLight(pointLights[i], norm, fragPos, viewDir, diffuseColor, specularColor, material.shininess);
+#endif
+#if NR_SPOT_LIGHTS > 0
+	result += calcSpotLight(spotLight, norm, fragPos, viewDir, diffuseColor, specularColor, material.shininess);
+#endif
+
+	fragColor = vec4(result, 1.0);
+}
+
+/*	The light functions are the shared ones from lighting.glsl; they take the material colors,
+	so the specular map is sampled once per fragment and only in the variants that have one.
+
+	On the C++ side shader_permutations.h builds and caches the variants. Each draw fills in
+	the smallest ShaderFeatures that covers it (the lights that actually reach the object, and
+	meshFeatures for the specular map and bone weights of the mesh) and selects that program:
+
+		ShaderPermutations lighting(programCache, "multiple_lights", {
+			{ GL_VERTEX_SHADER, vertexSource },
+			{ GL_FRAGMENT_SHADER, fragmentSource }
+		});
+
+		ShaderFeatures features = meshFeatures(mesh);
+		features.pointLights = nearbyPointLights;
+		glUseProgram(lighting.Select(features));
+
+	Known combinations can be compiled ahead of time with lighting.Prewarm({...}). Where the
+	driver supports KHR_parallel_shader_compile these compiles run on the driver's own threads,
+	and calling lighting.Poll() once per frame collects the ones that have finished. */
+
+/*	Using Every Core
+
+	With more objects and lights the CPU side of a frame grows too: updating transforms, culling
+	against the frustum, deciding which lights reach which object and building the list of draws.
+	The render loop does all of it on one thread, one step after the other. None of it calls GL,
+	so it can run on other cores while the context thread keeps to submission.
+
+	job_system.h starts one worker per core. Work is split into jobs, and a JobCounter tracks when
+	a group of jobs is done, either to wait for it or to start the next stage after it: */
+
+		JobSystem jobs;
+		...
+		JobCounter transformsDone, visibleDone;
+		jobs.Run([&]() { hierarchy.Update(jobs.Parallel()); }, &transformsDone);
+		jobs.RunAfter(transformsDone, [&]() { cullScene(camera.GetFrustum()); }, &visibleDone);
+		jobs.Run([&]() { animateLights(deltaTime); }, &visibleDone);
+		jobs.Wait(visibleDone);
+		// only GL from here on
+		for (const Object& object : visibleObjects)
+			drawObject(object);
+
+/*	The thread waiting in Wait runs queued jobs itself instead of sleeping. ParallelFor splits a
+	range of items into chunks of a given size, and Parallel() wraps it for code that takes a
+	ParallelFor, like TransformHierarchy::Update. Each thread takes its newest job first and
+	steals the oldest job from another thread once its own queue is empty, which keeps all cores
+	busy when some jobs take much longer than others. */
+
+/*	Measuring Each Pass
+
+	deltaTime tells how long a whole frame took, but not where the time went. profiler.h measures
+	named scopes instead, on the CPU with PROFILE_SCOPE on any thread and on the GPU with
+	PROFILE_GPU_SCOPE around the GL calls of a pass: */
+
+		profiler().BeginFrame();
+		{
+			PROFILE_SCOPE("Cull");
+			cullScene(camera.GetFrustum());
+		}
+		{
+			PROFILE_GPU_SCOPE("Lighting");
+			for (const Object& object : visibleObjects)
+				drawObject(object);
+		}
+		{
+			PROFILE_GPU_SCOPE("Light cubes");
+			for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
+				drawLightCube(pointLightPositions[i]);
+		}
+		profiler().EndFrame();
+
+		for (const ProfileTotal& total : profiler().Totals())
+			std::cout << total.name << ": " << total.cpuMilliseconds << " ms CPU, " << total.gpuMilliseconds << " ms GPU" << std::endl;
+
+/*	GPU results arrive a few frames late, because reading them earlier would make the CPU wait for
+	the GPU to catch up. Between StartCapture and StopCapture every event is kept, and the capture
+	can be saved with WriteChromeTrace and opened in chrome://tracing to see the threads and the
+	GPU next to each other, frame by frame. Without a GL context only the CPU scopes are recorded. */
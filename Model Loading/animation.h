@@ -0,0 +1,268 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "matrix_simd.h"
+#include "../In Practice/parallel_for.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// local transform of one joint
+struct JointPose {
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    glm::mat4 Matrix() const
+    {
+        glm::mat3 r = glm::mat3_cast(rotation);
+        return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f), glm::vec4(r[1] * scale.y, 0.0f),
+                         glm::vec4(r[2] * scale.z, 0.0f), glm::vec4(translation, 1.0f));
+    }
+};
+
+/*  The joints of a skinned mesh. Joint i is what m_BoneIDs refers to in Vertex. Parents must come
+    before their children (Assimp's node order already does), so a pose is evaluated in one
+    forward pass. */
+struct Skeleton {
+    std::vector<std::string> names;
+    std::vector<int> parents;                 // -1 for the root
+    std::vector<glm::mat4> inverseBindMatrices;
+    std::vector<JointPose> bindPose;          // used for joints a clip doesn't animate
+
+    int AddJoint(const std::string& name, int parent, const glm::mat4& inverseBind, const JointPose& pose = JointPose())
+    {
+        names.push_back(name);
+        parents.push_back(parent);
+        inverseBindMatrices.push_back(inverseBind);
+        bindPose.push_back(pose);
+        return static_cast<int>(names.size()) - 1;
+    }
+
+    size_t JointCount() const
+    {
+        return parents.size();
+    }
+};
+
+// keyframes of one joint; each channel has its own key times, in seconds
+struct JointTrack {
+    std::vector<float> positionTimes;
+    std::vector<glm::vec3> positions;
+    std::vector<float> rotationTimes;
+    std::vector<glm::quat> rotations;
+    std::vector<float> scaleTimes;
+    std::vector<glm::vec3> scales;
+
+    bool Empty() const
+    {
+        return positions.empty() && rotations.empty() && scales.empty();
+    }
+};
+
+struct AnimationClip {
+    std::string name;
+    float duration = 0.0f;           // seconds
+    std::vector<JointTrack> tracks;  // one per skeleton joint, empty for joints it doesn't move
+};
+
+/*  Samples one clip for one playing instance. Playback moves forward a little every frame, so the
+    key used last time is almost always still the right one or the next one; the sampler remembers
+    it per channel and only falls back to a binary search after a jump or a loop. The clip itself
+    is shared and never written. */
+class ClipSampler {
+public:
+    explicit ClipSampler(const AnimationClip* clip = nullptr)
+    {
+        SetClip(clip);
+    }
+
+    void SetClip(const AnimationClip* newClip)
+    {
+        clip = newClip;
+        cachedKeys.assign(clip ? clip->tracks.size() * 3 : 0, 0);
+    }
+
+    const AnimationClip* Clip() const
+    {
+        return clip;
+    }
+
+    // local pose at time seconds (looping); joints without a track keep the skeleton's bind pose
+    void Sample(float time, const Skeleton& skeleton, std::vector<JointPose>& pose)
+    {
+        pose.resize(skeleton.JointCount());
+        if (!clip || clip->duration <= 0.0f)
+        {
+            std::copy(skeleton.bindPose.begin(), skeleton.bindPose.end(), pose.begin());
+            return;
+        }
+        time = std::fmod(time, clip->duration);
+        if (time < 0.0f)
+            time += clip->duration;
+
+        for (size_t joint = 0; joint < pose.size(); joint++)
+        {
+            pose[joint] = skeleton.bindPose[joint];
+            if (joint >= clip->tracks.size() || clip->tracks[joint].Empty())
+                continue;
+            const JointTrack& track = clip->tracks[joint];
+            std::uint32_t* cache = &cachedKeys[joint * 3];
+
+            if (!track.positions.empty())
+            {
+                float t;
+                std::uint32_t key = findKey(track.positionTimes, time, cache[0], t);
+                pose[joint].translation = glm::mix(track.positions[key], track.positions[std::min<size_t>(key + 1, track.positions.size() - 1)], t);
+            }
+            if (!track.rotations.empty())
+            {
+                float t;
+                std::uint32_t key = findKey(track.rotationTimes, time, cache[1], t);
+                pose[joint].rotation = glm::normalize(glm::slerp(track.rotations[key], track.rotations[std::min<size_t>(key + 1, track.rotations.size() - 1)], t));
+            }
+            if (!track.scales.empty())
+            {
+                float t;
+                std::uint32_t key = findKey(track.scaleTimes, time, cache[2], t);
+                pose[joint].scale = glm::mix(track.scales[key], track.scales[std::min<size_t>(key + 1, track.scales.size() - 1)], t);
+            }
+        }
+    }
+
+private:
+    const AnimationClip* clip = nullptr;
+    std::vector<std::uint32_t> cachedKeys; // last key per joint and channel
+
+    // index of the key at or before time and the blend factor towards the next one
+    static std::uint32_t findKey(const std::vector<float>& times, float time, std::uint32_t& cached, float& t)
+    {
+        const std::uint32_t last = static_cast<std::uint32_t>(times.size()) - 1;
+        std::uint32_t key = cached;
+        if (key > last || times[key] > time)
+            key = lookup(times, time);
+        else if (key < last && times[key + 1] <= time)
+        {
+            // usually just the next key
+            key++;
+            if (key < last && times[key + 1] <= time)
+                key = lookup(times, time);
+        }
+        cached = key;
+
+        if (key == last)
+        {
+            t = 0.0f;
+            return key;
+        }
+        float span = times[key + 1] - times[key];
+        t = span > 0.0f ? std::min(std::max((time - times[key]) / span, 0.0f), 1.0f) : 0.0f;
+        return key;
+    }
+
+    static std::uint32_t lookup(const std::vector<float>& times, float time)
+    {
+        std::vector<float>::const_iterator next = std::upper_bound(times.begin(), times.end(), time);
+        return next == times.begin() ? 0 : static_cast<std::uint32_t>(next - times.begin() - 1);
+    }
+};
+
+// local poses to model space (parents first), then to skinning matrices: model * inverse bind
+inline void computeSkinningPalette(const Skeleton& skeleton, const std::vector<JointPose>& pose,
+                                   std::vector<glm::mat4>& modelSpace, glm::mat4* palette)
+{
+    const size_t count = skeleton.JointCount();
+    modelSpace.resize(count);
+    for (size_t joint = 0; joint < count; joint++)
+    {
+        glm::mat4 local = pose[joint].Matrix();
+        int parent = skeleton.parents[joint];
+        if (parent < 0)
+            modelSpace[joint] = local;
+        else
+            multiplyMat4(modelSpace[parent], local, modelSpace[joint]);
+        multiplyMat4(modelSpace[joint], skeleton.inverseBindMatrices[joint], palette[joint]);
+    }
+}
+
+/*  Plays clips on many instances of one skeleton. Every instance has its own sampler and time,
+    and Update evaluates them in parallel into one contiguous array of skinning matrices (instance
+    i starts at i * JointCount()), ready for skinVertices or for upload as a GPU palette. */
+class SkeletonAnimator {
+public:
+    std::vector<glm::mat4> palettes;
+
+    explicit SkeletonAnimator(const Skeleton& skeleton)
+        : skeleton(skeleton)
+    {
+    }
+
+    size_t AddInstance(const AnimationClip* clip, float startTime = 0.0f, float speed = 1.0f)
+    {
+        Instance instance;
+        instance.sampler.SetClip(clip);
+        instance.time = startTime;
+        instance.speed = speed;
+        instances.push_back(instance);
+        palettes.resize(instances.size() * skeleton.JointCount());
+        return instances.size() - 1;
+    }
+
+    void Play(size_t instance, const AnimationClip* clip, float startTime = 0.0f)
+    {
+        instances[instance].sampler.SetClip(clip);
+        instances[instance].time = startTime;
+    }
+
+    size_t InstanceCount() const
+    {
+        return instances.size();
+    }
+
+    size_t JointCount() const
+    {
+        return skeleton.JointCount();
+    }
+
+    const glm::mat4* Palette(size_t instance) const
+    {
+        return &palettes[instance * skeleton.JointCount()];
+    }
+
+    void Update(float deltaTime, const ParallelFor& parallelFor = serialFor, size_t grain = 16)
+    {
+        parallelFor(instances.size(), grain, [this, deltaTime](size_t begin, size_t end) {
+            // scratch per chunk; the pose buffers are reused for every instance in it
+            std::vector<JointPose> pose;
+            std::vector<glm::mat4> modelSpace;
+            for (size_t i = begin; i < end; i++)
+            {
+                Instance& instance = instances[i];
+                instance.time += deltaTime * instance.speed;
+                // keep the time small so float precision doesn't run out on long sessions
+                const AnimationClip* clip = instance.sampler.Clip();
+                if (clip && clip->duration > 0.0f)
+                    instance.time = std::fmod(instance.time, clip->duration);
+                instance.sampler.Sample(instance.time, skeleton, pose);
+                computeSkinningPalette(skeleton, pose, modelSpace, &palettes[i * skeleton.JointCount()]);
+            }
+        });
+    }
+
+private:
+    struct Instance {
+        ClipSampler sampler;
+        float time = 0.0f;
+        float speed = 1.0f;
+    };
+
+    const Skeleton& skeleton;
+    std::vector<Instance> instances;
+};
+#endif
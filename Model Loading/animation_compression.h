@@ -0,0 +1,653 @@
+#ifndef ANIMATION_COMPRESSION_H
+#define ANIMATION_COMPRESSION_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "animation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*  Compressed animation clips, stored in a binary container that can be memory mapped and sampled
+    in place.
+
+    A clip is resampled at a fixed rate and cut into segments of ANIMATION_SEGMENT_FRAMES frames.
+    Inside a segment every channel (rotation, translation, scale of every joint) keeps only the
+    frames that can't be rebuilt by interpolating their neighbours within the error bound; the
+    first and last frame of a segment are always kept, so each segment decodes on its own. The
+    channels of a segment are stored one after the other in joint order, which means sampling a
+    pose reads one contiguous block front to back, and streaming a long clip only ever needs the
+    segment currently playing.
+
+    Rotations are stored as the three smallest quaternion components, 15 bits each, with the index
+    of the dropped largest one in the two spare bits (6 bytes instead of 16). Translations and
+    scales are 16 bits per component inside a per-joint range. The file layout is little endian:
+
+        ClipFileHeader
+        uint8  channels[jointCount]           CHANNEL_* bits, padded to 4 bytes
+        float  ranges[jointCount][12]         translation min/extent, scale min/extent
+        uint32 segmentOffsets[segmentCount + 1]
+        segment data: per joint and present channel:
+            uint8  keyCount, uint8 frames[keyCount], uint16 values[keyCount][3]
+*/
+
+#define ANIMATION_SEGMENT_FRAMES 32
+
+enum ClipChannel {
+    CHANNEL_ROTATION    = 1 << 0,
+    CHANNEL_TRANSLATION = 1 << 1,
+    CHANNEL_SCALE       = 1 << 2
+};
+
+struct ClipFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t jointCount;
+    std::uint32_t frameCount;
+    float sampleRate;
+    float duration;
+    std::uint32_t segmentFrames;
+    std::uint32_t segmentCount;
+    std::uint32_t channelsOffset;
+    std::uint32_t rangesOffset;
+    std::uint32_t segmentsOffset;
+    std::uint32_t size;
+};
+
+const std::uint32_t CLIP_FILE_VERSION = 1;
+
+struct CompressionSettings {
+    float sampleRate = 30.0f;
+    float translationError = 0.0005f; // model units
+    float rotationError = 0.0005f;    // radians
+    float scaleError = 0.0005f;
+};
+
+// smallest-three quaternion packing
+inline void packQuaternion(glm::quat q, std::uint16_t out[3])
+{
+    float components[4] = { q.x, q.y, q.z, q.w };
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+        if (std::fabs(components[i]) > std::fabs(components[largest]))
+            largest = i;
+    // q and -q are the same rotation, so the dropped component can always be positive
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+    int n = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i == largest)
+            continue;
+        // the other three are within +-1/sqrt(2)
+        float v = components[i] * sign * 0.70710678f * 2.0f;
+        v = std::min(std::max((v + 1.0f) * 0.5f, 0.0f), 1.0f);
+        out[n++] = static_cast<std::uint16_t>(std::lround(v * 32767.0f));
+    }
+    out[0] |= static_cast<std::uint16_t>((largest & 1) << 15);
+    out[1] |= static_cast<std::uint16_t>((largest >> 1) << 15);
+}
+
+inline glm::quat unpackQuaternion(const std::uint16_t in[3])
+{
+    int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+    float a = (float(in[0] & 0x7FFF) / 32767.0f * 2.0f - 1.0f) * 0.70710678f;
+    float b = (float(in[1] & 0x7FFF) / 32767.0f * 2.0f - 1.0f) * 0.70710678f;
+    float c = (float(in[2] & 0x7FFF) / 32767.0f * 2.0f - 1.0f) * 0.70710678f;
+    float d = std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c));
+    switch (largest)
+    {
+    case 0: return glm::quat(c, d, a, b); // glm::quat takes w first
+    case 1: return glm::quat(c, a, d, b);
+    case 2: return glm::quat(c, a, b, d);
+    default: return glm::quat(d, a, b, c);
+    }
+}
+
+inline void packVector(const glm::vec3& v, const float* minimum, const float* extent, std::uint16_t out[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        float normalized = extent[i] > 0.0f ? (v[i] - minimum[i]) / extent[i] : 0.0f;
+        out[i] = static_cast<std::uint16_t>(std::lround(std::min(std::max(normalized, 0.0f), 1.0f) * 65535.0f));
+    }
+}
+
+inline glm::vec3 unpackVector(const std::uint16_t in[3], const float* minimum, const float* extent)
+{
+    return glm::vec3(minimum[0] + extent[0] * (in[0] / 65535.0f), minimum[1] + extent[1] * (in[1] / 65535.0f),
+                     minimum[2] + extent[2] * (in[2] / 65535.0f));
+}
+
+// interpolation used by both the key reduction and the decoder, so the error bound holds for playback
+inline glm::quat nlerpShortest(const glm::quat& a, glm::quat b, float t)
+{
+    if (glm::dot(a, b) < 0.0f)
+        b = -b;
+    glm::quat q(a.w + (b.w - a.w) * t, a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+    return glm::normalize(q);
+}
+
+// angle of the rotation between a and b; acos of the dot product has no precision left near zero
+inline float rotationDifference(const glm::quat& a, const glm::quat& b)
+{
+    glm::quat d = glm::conjugate(a) * b;
+    return 2.0f * std::atan2(glm::length(glm::vec3(d.x, d.y, d.z)), std::fabs(d.w));
+}
+
+// decode two quantized vectors and blend them; four lanes at a time where SSE is available
+inline glm::vec3 lerpQuantized(const std::uint16_t a[3], const std::uint16_t b[3], const float* minimum, const float* extent, float t)
+{
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 toUnit = _mm_set1_ps(1.0f / 65535.0f);
+    __m128 qa = _mm_cvtepi32_ps(_mm_setr_epi32(a[0], a[1], a[2], 0));
+    __m128 qb = _mm_cvtepi32_ps(_mm_setr_epi32(b[0], b[1], b[2], 0));
+    // blend in quantized space, then map into the range once
+    __m128 q = _mm_add_ps(qa, _mm_mul_ps(_mm_sub_ps(qb, qa), _mm_set1_ps(t)));
+    __m128 v = _mm_add_ps(_mm_setr_ps(minimum[0], minimum[1], minimum[2], 0.0f),
+                          _mm_mul_ps(_mm_mul_ps(q, toUnit), _mm_setr_ps(extent[0], extent[1], extent[2], 0.0f)));
+    float result[4];
+    _mm_storeu_ps(result, v);
+    return glm::vec3(result[0], result[1], result[2]);
+#else
+    return glm::mix(unpackVector(a, minimum, extent), unpackVector(b, minimum, extent), t);
+#endif
+}
+
+namespace detail {
+
+// frames of one channel worth keeping: greedily extend each span while every frame it covers, decoded the way the
+// sampler will (quantized keys, then interpolated), stays within the bound. The candidate end key is checked too, so
+// a key whose own quantization error is too large can't end a span; worst returns the largest error among the kept
+// keys, which is over the bound only where quantization alone can't meet it
+template <typename Value, typename Decode, typename Interpolate, typename Difference>
+std::vector<std::uint32_t> reduceKeys(const std::vector<Value>& original, std::uint32_t first, std::uint32_t last, float bound,
+                                      Decode decode, Interpolate interpolate, Difference difference, float& worst)
+{
+    std::vector<std::uint32_t> kept(1, first);
+    worst = std::max(worst, difference(decode(original[first]), original[first]));
+    std::uint32_t start = first;
+    while (start < last)
+    {
+        std::uint32_t end = start + 1;
+        while (end < last)
+        {
+            std::uint32_t candidate = end + 1;
+            Value a = decode(original[start]), b = decode(original[candidate]);
+            bool fits = true;
+            for (std::uint32_t k = start + 1; k <= candidate && fits; k++)
+            {
+                float t = float(k - start) / float(candidate - start);
+                fits = difference(interpolate(a, b, t), original[k]) <= bound;
+            }
+            if (!fits)
+                break;
+            end = candidate;
+        }
+        kept.push_back(end);
+        worst = std::max(worst, difference(decode(original[end]), original[end]));
+        start = end;
+    }
+    return kept;
+}
+
+template <typename T>
+void append(std::vector<std::uint8_t>& bytes, const T& value)
+{
+    const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&value);
+    bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+inline void pad4(std::vector<std::uint8_t>& bytes)
+{
+    while (bytes.size() % 4)
+        bytes.push_back(0);
+}
+
+} // namespace detail
+
+// resample, quantize and reduce a clip; returns the complete file contents
+inline std::vector<std::uint8_t> compressClip(const AnimationClip& clip, const Skeleton& skeleton, const CompressionSettings& settings = CompressionSettings())
+{
+    const std::uint32_t jointCount = static_cast<std::uint32_t>(skeleton.JointCount());
+    const std::uint32_t frameCount = std::max(2u, static_cast<std::uint32_t>(std::ceil(clip.duration * settings.sampleRate)) + 1);
+    const std::uint32_t segmentCount = (frameCount - 1 + ANIMATION_SEGMENT_FRAMES - 1) / ANIMATION_SEGMENT_FRAMES;
+    // the decoder assumes evenly spaced frames, so the rate is nudged up until the last frame lands exactly on the end
+    const float sampleRate = clip.duration > 0.0f ? float(frameCount - 1) / clip.duration : settings.sampleRate;
+
+    // resample every joint at that rate
+    std::vector<std::vector<JointPose>> frames(frameCount);
+    ClipSampler sampler(&clip);
+    for (std::uint32_t f = 0; f < frameCount; f++)
+    {
+        float time = std::min(clip.duration, f / sampleRate);
+        // fmod in Sample would wrap the final frame back to the start
+        sampler.Sample(f + 1 == frameCount ? std::nextafter(clip.duration, 0.0f) : time, skeleton, frames[f]);
+    }
+
+    std::vector<std::uint8_t> channels(jointCount, 0);
+    std::vector<float> ranges(jointCount * 12, 0.0f);
+    for (std::uint32_t j = 0; j < jointCount; j++)
+    {
+        const JointTrack* track = j < clip.tracks.size() ? &clip.tracks[j] : nullptr;
+        if (track && !track->rotations.empty())
+            channels[j] |= CHANNEL_ROTATION;
+        if (track && !track->positions.empty())
+            channels[j] |= CHANNEL_TRANSLATION;
+        if (track && !track->scales.empty())
+            channels[j] |= CHANNEL_SCALE;
+
+        glm::vec3 tMin(1e30f), tMax(-1e30f), sMin(1e30f), sMax(-1e30f);
+        for (std::uint32_t f = 0; f < frameCount; f++)
+        {
+            tMin = glm::min(tMin, frames[f][j].translation);
+            tMax = glm::max(tMax, frames[f][j].translation);
+            sMin = glm::min(sMin, frames[f][j].scale);
+            sMax = glm::max(sMax, frames[f][j].scale);
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            ranges[j * 12 + i] = tMin[i];
+            ranges[j * 12 + 3 + i] = tMax[i] - tMin[i];
+            ranges[j * 12 + 6 + i] = sMin[i];
+            ranges[j * 12 + 9 + i] = sMax[i] - sMin[i];
+        }
+    }
+
+    ClipFileHeader header;
+    std::memcpy(header.magic, "ANIM", 4);
+    header.version = CLIP_FILE_VERSION;
+    header.jointCount = jointCount;
+    header.frameCount = frameCount;
+    header.sampleRate = sampleRate;
+    header.duration = clip.duration;
+    header.segmentFrames = ANIMATION_SEGMENT_FRAMES;
+    header.segmentCount = segmentCount;
+
+    std::vector<std::uint8_t> bytes(sizeof(ClipFileHeader));
+    header.channelsOffset = static_cast<std::uint32_t>(bytes.size());
+    bytes.insert(bytes.end(), channels.begin(), channels.end());
+    detail::pad4(bytes);
+    header.rangesOffset = static_cast<std::uint32_t>(bytes.size());
+    for (float value : ranges)
+        detail::append(bytes, value);
+    header.segmentsOffset = static_cast<std::uint32_t>(bytes.size());
+    bytes.resize(bytes.size() + (segmentCount + 1) * sizeof(std::uint32_t));
+
+    std::vector<std::uint32_t> segmentOffsets;
+    std::vector<glm::quat> rotations(frameCount);
+    std::vector<glm::vec3> vectors(frameCount);
+    float worstError[3] = { 0.0f, 0.0f, 0.0f };
+    for (std::uint32_t s = 0; s < segmentCount; s++)
+    {
+        segmentOffsets.push_back(static_cast<std::uint32_t>(bytes.size()));
+        const std::uint32_t first = s * ANIMATION_SEGMENT_FRAMES;
+        const std::uint32_t last = std::min(first + ANIMATION_SEGMENT_FRAMES, frameCount - 1);
+
+        for (std::uint32_t j = 0; j < jointCount; j++)
+        {
+            const float* range = &ranges[j * 12];
+            for (int channel = 0; channel < 3; channel++)
+            {
+                if (!(channels[j] & (1 << channel)))
+                    continue;
+
+                std::vector<std::uint32_t> kept;
+                std::vector<std::uint16_t> packed;
+                if (channel == 0)
+                {
+                    for (std::uint32_t f = first; f <= last; f++)
+                        rotations[f] = frames[f][j].rotation;
+                    kept = detail::reduceKeys(rotations, first, last, settings.rotationError,
+                        [](const glm::quat& q) { std::uint16_t p[3]; packQuaternion(q, p); return unpackQuaternion(p); },
+                        nlerpShortest, rotationDifference, worstError[0]);
+                    for (std::uint32_t f : kept)
+                    {
+                        std::uint16_t p[3];
+                        packQuaternion(rotations[f], p);
+                        packed.insert(packed.end(), p, p + 3);
+                    }
+                }
+                else
+                {
+                    const float* minimum = channel == 1 ? range : range + 6;
+                    const float* extent = minimum + 3;
+                    for (std::uint32_t f = first; f <= last; f++)
+                        vectors[f] = channel == 1 ? frames[f][j].translation : frames[f][j].scale;
+                    kept = detail::reduceKeys(vectors, first, last, channel == 1 ? settings.translationError : settings.scaleError,
+                        [minimum, extent](const glm::vec3& v) { std::uint16_t p[3]; packVector(v, minimum, extent, p); return unpackVector(p, minimum, extent); },
+                        [](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); },
+                        [](const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b); }, worstError[channel]);
+                    for (std::uint32_t f : kept)
+                    {
+                        std::uint16_t p[3];
+                        packVector(vectors[f], minimum, extent, p);
+                        packed.insert(packed.end(), p, p + 3);
+                    }
+                }
+
+                bytes.push_back(static_cast<std::uint8_t>(kept.size()));
+                for (std::uint32_t f : kept)
+                    bytes.push_back(static_cast<std::uint8_t>(f - first));
+                for (std::uint16_t value : packed)
+                    detail::append(bytes, value);
+            }
+        }
+    }
+    segmentOffsets.push_back(static_cast<std::uint32_t>(bytes.size()));
+    const float bounds[3] = { settings.rotationError, settings.translationError, settings.scaleError };
+    const char* names[3] = { "rotation", "translation", "scale" };
+    for (int channel = 0; channel < 3; channel++)
+        if (worstError[channel] > bounds[channel])
+            std::cout << "ERROR::ANIMATION: " << names[channel] << " keys quantize with up to " << worstError[channel]
+                      << " error, over the bound of " << bounds[channel] << "; the clip's range is too large for 16 bits" << std::endl;
+    std::memcpy(&bytes[header.segmentsOffset], segmentOffsets.data(), segmentOffsets.size() * sizeof(std::uint32_t));
+
+    header.size = static_cast<std::uint32_t>(bytes.size());
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+inline bool saveClip(const std::string& path, const std::vector<std::uint8_t>& bytes)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return static_cast<bool>(file);
+}
+
+// read-only view of a file; mapped where the platform allows it, read into memory otherwise
+class MappedFile {
+public:
+    MappedFile() {}
+    explicit MappedFile(const std::string& path)
+    {
+        Open(path);
+    }
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path)
+    {
+        Close();
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = reinterpret_cast<const std::uint8_t*>(contents.data());
+        size = contents.size();
+        return true;
+#else
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            return false;
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+        {
+            close(descriptor);
+            return false;
+        }
+        void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        close(descriptor);
+        if (mapping == MAP_FAILED)
+            return false;
+        data = static_cast<const std::uint8_t*>(mapping);
+        size = static_cast<size_t>(info.st_size);
+        return true;
+#endif
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        contents.clear();
+#else
+        if (data)
+            munmap(const_cast<std::uint8_t*>(data), size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const std::uint8_t* Data() const
+    {
+        return data;
+    }
+
+    size_t Size() const
+    {
+        return size;
+    }
+
+private:
+    const std::uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    std::string contents;
+#endif
+};
+
+/*  Samples a compressed clip directly from its bytes (a MappedFile or the vector compressClip
+    returned), which have to stay alive as long as the view is used. Sample has the same meaning
+    as ClipSampler::Sample: looping time in seconds, bind pose for joints and channels the clip
+    doesn't animate. */
+class CompressedClip {
+public:
+    // check the header and keep a pointer to the data; false if it isn't a valid clip file
+    bool Load(const std::uint8_t* bytes, size_t byteSize)
+    {
+        data = nullptr;
+        if (!bytes || byteSize < sizeof(ClipFileHeader))
+            return false;
+        std::memcpy(&header, bytes, sizeof(header));
+        if (std::memcmp(header.magic, "ANIM", 4) != 0 || header.version != CLIP_FILE_VERSION || header.size > byteSize ||
+            header.segmentCount == 0 || header.frameCount < 2 ||
+            header.segmentsOffset + (header.segmentCount + 1) * sizeof(std::uint32_t) > byteSize)
+        {
+            std::cout << "ERROR::ANIMATION: not a compressed clip or wrong version" << std::endl;
+            return false;
+        }
+        // Sample trusts every offset and count, so a damaged file must not get past here
+        if (header.segmentFrames == 0 || !std::isfinite(header.sampleRate) || header.sampleRate < 0.0f ||
+            !std::isfinite(header.duration) || !validTables() || !validSegments(bytes))
+        {
+            std::cout << "ERROR::ANIMATION: clip offsets or counts don't fit the file" << std::endl;
+            return false;
+        }
+        data = bytes;
+        return true;
+    }
+
+    bool Valid() const
+    {
+        return data != nullptr;
+    }
+
+    float Duration() const
+    {
+        return header.duration;
+    }
+
+    size_t ByteSize() const
+    {
+        return header.size;
+    }
+
+    void Sample(float time, const Skeleton& skeleton, std::vector<JointPose>& pose) const
+    {
+        pose.assign(skeleton.bindPose.begin(), skeleton.bindPose.end());
+        if (!data || header.duration <= 0.0f)
+            return;
+
+        time = std::fmod(time, header.duration);
+        if (time < 0.0f)
+            time += header.duration;
+        float frame = std::min(time * header.sampleRate, float(header.frameCount - 1));
+        std::uint32_t segment = std::min(static_cast<std::uint32_t>(frame) / header.segmentFrames, header.segmentCount - 1);
+        float local = frame - float(segment * header.segmentFrames);
+
+        const std::uint8_t* channels = data + header.channelsOffset;
+        const float* ranges = reinterpret_cast<const float*>(data + header.rangesOffset);
+        std::uint32_t offset;
+        std::memcpy(&offset, data + header.segmentsOffset + segment * sizeof(std::uint32_t), sizeof(offset));
+        const std::uint8_t* cursor = data + offset;
+
+        const std::uint32_t joints = std::min<std::uint32_t>(header.jointCount, static_cast<std::uint32_t>(pose.size()));
+        for (std::uint32_t j = 0; j < header.jointCount; j++)
+        {
+            for (int channel = 0; channel < 3; channel++)
+            {
+                if (!(channels[j] & (1 << channel)))
+                    continue;
+                std::uint32_t count = *cursor++;
+                const std::uint8_t* keyFrames = cursor;
+                const std::uint8_t* values = cursor + count;
+                cursor = values + count * 3 * sizeof(std::uint16_t);
+                if (j >= joints)
+                    continue;
+
+                // the two kept frames around local; segments are short, a scan beats a search
+                std::uint32_t key = 0;
+                while (key + 2 < count && keyFrames[key + 1] <= local)
+                    key++;
+                std::uint32_t next = std::min(key + 1, count - 1);
+                float span = float(keyFrames[next]) - float(keyFrames[key]);
+                float t = span > 0.0f ? std::min(std::max((local - keyFrames[key]) / span, 0.0f), 1.0f) : 0.0f;
+
+                std::uint16_t a[3], b[3];
+                std::memcpy(a, values + key * 6, sizeof(a));
+                std::memcpy(b, values + next * 6, sizeof(b));
+                const float* range = ranges + j * 12;
+                if (channel == 0)
+                    pose[j].rotation = nlerpShortest(unpackQuaternion(a), unpackQuaternion(b), t);
+                else if (channel == 1)
+                    pose[j].translation = lerpQuantized(a, b, range, range + 3, t);
+                else
+                    pose[j].scale = lerpQuantized(a, b, range + 6, range + 9, t);
+            }
+        }
+    }
+
+private:
+    ClipFileHeader header;
+    const std::uint8_t* data = nullptr;
+
+    // one channel mask byte and twelve range floats per joint, then the segment offset table
+    bool validTables() const
+    {
+        const std::uint64_t end = header.size;
+        const std::uint64_t tableEnd = std::uint64_t(header.segmentsOffset) + (std::uint64_t(header.segmentCount) + 1) * sizeof(std::uint32_t);
+        return header.channelsOffset >= sizeof(ClipFileHeader) && std::uint64_t(header.channelsOffset) + header.jointCount <= end &&
+               header.rangesOffset % alignof(float) == 0 &&
+               std::uint64_t(header.rangesOffset) + std::uint64_t(header.jointCount) * 12 * sizeof(float) <= end &&
+               tableEnd <= end;
+    }
+
+    // walk every segment the way Sample does and make sure each one ends where the next begins
+    bool validSegments(const std::uint8_t* bytes) const
+    {
+        const std::uint8_t* channels = bytes + header.channelsOffset;
+        const std::uint64_t tableEnd = std::uint64_t(header.segmentsOffset) + (std::uint64_t(header.segmentCount) + 1) * sizeof(std::uint32_t);
+        std::uint32_t begin;
+        std::memcpy(&begin, bytes + header.segmentsOffset, sizeof(begin));
+        if (begin < tableEnd)
+            return false;
+        for (std::uint32_t s = 0; s < header.segmentCount; s++)
+        {
+            std::uint32_t end;
+            std::memcpy(&end, bytes + header.segmentsOffset + (s + 1) * sizeof(std::uint32_t), sizeof(end));
+            if (end < begin || end > header.size)
+                return false;
+            std::uint64_t cursor = begin;
+            for (std::uint32_t j = 0; j < header.jointCount; j++)
+            {
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    if (!(channels[j] & (1 << channel)))
+                        continue;
+                    if (cursor >= end)
+                        return false;
+                    // Sample reads the key after the one it lands on, so every channel needs one
+                    std::uint32_t count = bytes[cursor];
+                    cursor += 1 + count + count * 3 * sizeof(std::uint16_t);
+                    if (count == 0 || cursor > end)
+                        return false;
+                }
+            }
+            begin = end;
+        }
+        return true;
+    }
+};
+
+struct CompressionReport {
+    size_t sourceBytes = 0;     // float keys and key times of the source clip
+    size_t compressedBytes = 0;
+    float maxTranslationError = 0.0f;
+    float maxRotationError = 0.0f; // radians
+    float maxScaleError = 0.0f;
+    double posesPerSecond = 0.0;
+};
+
+// compare a compressed clip against its source at many points in time and time the decoder
+inline CompressionReport measureCompression(const AnimationClip& clip, const Skeleton& skeleton, const CompressedClip& compressed,
+                                            int samples = 1000, int decodeIterations = 10000)
+{
+    CompressionReport report;
+    for (const JointTrack& track : clip.tracks)
+        report.sourceBytes += (track.positionTimes.size() + track.rotationTimes.size() + track.scaleTimes.size()) * sizeof(float) +
+                              track.positions.size() * sizeof(glm::vec3) + track.rotations.size() * sizeof(glm::quat) +
+                              track.scales.size() * sizeof(glm::vec3);
+    report.compressedBytes = compressed.ByteSize();
+
+    ClipSampler sampler(&clip);
+    std::vector<JointPose> expected, decoded;
+    for (int i = 0; i < samples; i++)
+    {
+        // stay just inside the clip; the sampler and the decoder both loop at the end
+        float time = clip.duration * (float(i) / float(samples));
+        sampler.Sample(time, skeleton, expected);
+        compressed.Sample(time, skeleton, decoded);
+        for (size_t j = 0; j < expected.size(); j++)
+        {
+            report.maxTranslationError = std::max(report.maxTranslationError, glm::length(expected[j].translation - decoded[j].translation));
+            report.maxRotationError = std::max(report.maxRotationError, rotationDifference(expected[j].rotation, decoded[j].rotation));
+            report.maxScaleError = std::max(report.maxScaleError, glm::length(expected[j].scale - decoded[j].scale));
+        }
+    }
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < decodeIterations; i++)
+        compressed.Sample(clip.duration * (float(i % 997) / 997.0f), skeleton, decoded);
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    report.posesPerSecond = seconds > 0.0 ? decodeIterations / seconds : 0.0;
+    return report;
+}
+#endif
@@ -0,0 +1,88 @@
+#ifndef MATRIX_SIMD_H
+#define MATRIX_SIMD_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Column-major 4x4 matrix products on raw float pointers (glm::mat4 is 16 contiguous floats).
+// Built with -mavx2 -mfma (or /arch:AVX2) two columns are computed per 256-bit register; otherwise
+// SSE does one column per register, and anything else falls back to plain C++.
+
+// out = a * b; out may not alias a or b
+inline void multiplyMat4(const float* a, const float* b, float* out)
+{
+#if defined(__AVX__)
+    // every column of a, duplicated into both 128-bit halves
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 0));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+    for (int column = 0; column < 16; column += 8)
+    {
+        // columns j and j+1 of b; permute splats element k within each half
+        __m256 bj = _mm256_loadu_ps(b + column);
+#if defined(__FMA__)
+        __m256 result = _mm256_mul_ps(a0, _mm256_permute_ps(bj, 0x00));
+        result = _mm256_fmadd_ps(a1, _mm256_permute_ps(bj, 0x55), result);
+        result = _mm256_fmadd_ps(a2, _mm256_permute_ps(bj, 0xAA), result);
+        result = _mm256_fmadd_ps(a3, _mm256_permute_ps(bj, 0xFF), result);
+#else
+        __m256 result = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(a0, _mm256_permute_ps(bj, 0x00)), _mm256_mul_ps(a1, _mm256_permute_ps(bj, 0x55))),
+            _mm256_add_ps(_mm256_mul_ps(a2, _mm256_permute_ps(bj, 0xAA)), _mm256_mul_ps(a3, _mm256_permute_ps(bj, 0xFF))));
+#endif
+        _mm256_storeu_ps(out + column, result);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128 a0 = _mm_loadu_ps(a + 0);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    for (int column = 0; column < 16; column += 4)
+    {
+        __m128 bj = _mm_loadu_ps(b + column);
+        __m128 result = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a0, _mm_shuffle_ps(bj, bj, 0x00)), _mm_mul_ps(a1, _mm_shuffle_ps(bj, bj, 0x55))),
+            _mm_add_ps(_mm_mul_ps(a2, _mm_shuffle_ps(bj, bj, 0xAA)), _mm_mul_ps(a3, _mm_shuffle_ps(bj, bj, 0xFF))));
+        _mm_storeu_ps(out + column, result);
+    }
+#else
+    for (int column = 0; column < 4; column++)
+        for (int row = 0; row < 4; row++)
+            out[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+                                    a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+#endif
+}
+
+inline void multiplyMat4(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+    multiplyMat4(&a[0][0], &b[0][0], &out[0][0]);
+}
+
+// out[i] = a[i] * b[i] for count matrices
+inline void multiplyMat4Batch(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        multiplyMat4(&a[i][0][0], &b[i][0][0], &out[i][0][0]);
+}
+
+// inverse transpose of the upper 3x3, for transforming normals; the columns of the cofactor
+// matrix are cross products of the other two columns, so no full inverse is needed
+inline glm::mat3 normalMatrix(const glm::mat4& model)
+{
+    glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+    glm::vec3 n0 = glm::cross(c1, c2);
+    glm::vec3 n1 = glm::cross(c2, c0);
+    glm::vec3 n2 = glm::cross(c0, c1);
+    float determinant = glm::dot(c0, n0);
+    float inverse = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+    return glm::mat3(n0 * inverse, n1 * inverse, n2 * inverse);
+}
+#endif
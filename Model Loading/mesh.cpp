@@ -119,3 +119,276 @@ class Mesh {
 	
 	
 	
+/*	Redundant State
+
+	Draw always leaves things the way it found them: it unbinds the VAO after drawing and switches
+	back to GL_TEXTURE0, and it binds every texture again even when the previous mesh used the same
+	ones. The next draw then undoes all of it. With many meshes a large share of the GL calls in a
+	frame change nothing.
+
+	state_cache.h keeps a copy of the current program, vertex array, buffer bindings, textures per
+	unit and depth/blend state, and drops any call that would set a value that is already current.
+	The final version of Draw binds through it and no longer resets anything afterwards: */
+
+		glState().BindTexture(i, GL_TEXTURE_2D, textures[i].id);
+		...
+		glState().BindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+
+/*	The render loop does the same for programs, and can read how many calls were issued and how
+	many were dropped each frame:
+
+		glState().BeginFrame();
+		glState().UseProgram(lightingShader.ID);
+		...
+		std::cout << glState().frame.issued << " issued, " << glState().frame.filtered << " filtered\n";
+
+	Since nothing is reset any more, code that binds state directly with GL has to call
+	glState().Invalidate() afterwards, and an index buffer must never be bound while a mesh's VAO
+	is still current. */
+
+/*	Recording Instead of Drawing
+
+	Draw issues GL the moment it is called, so objects are drawn in whatever order the scene is
+	walked. Two meshes with the same shader and textures may end up far apart with other state in
+	between, and a close wall may be drawn after everything behind it has already been shaded.
+
+	draw_commands.h splits drawing into recording and submitting. Packet returns everything Draw
+	would have done as plain data, and any thread can add it to a DrawList together with a 64 bit
+	sort key. The key holds the pass, program, material, texture set and depth: */
+
+		DrawList& list = queue.List(chunk);
+		float distance = glm::length(camera.Position - objectPosition);
+		list.Add(opaqueKey(0, shader.ID, mesh.materialID, 0, quantizeDepth(distance, camera.FarPlane)),
+		         mesh.Packet(shader.ID, model));
+
+/*	Once every worker is done, the GL thread sorts and submits:
+
+		queue.Sort(jobs.Parallel());
+		DrawStats stats = queue.Submit();
+		queue.Clear();
+
+	Sort merges the lists with a radix sort, split over threads, so draws sharing a program,
+	material and textures end up next to each other, nearest first. Submit only changes state
+	between draws that differ, and transparentKey puts depth first and reversed for geometry that
+	must be blended back to front. */
+
+/*	Using the Bone Weights
+
+	Every Vertex carries up to MAX_BONE_INFLUENCE bone IDs and weights, and setupMesh feeds them to
+	attribute locations 5 and 6, but so far nothing moves the bones. animation.h adds a Skeleton
+	(joints in parent-first order with their inverse bind matrices), AnimationClips with keyframes
+	per joint, and a SkeletonAnimator that plays clips on many instances at once. Update samples
+	every instance and writes one skinning matrix per joint: */
+
+		SkeletonAnimator crowd(skeleton);
+		for (int i = 0; i < 1000; i++)
+			crowd.AddInstance(&walk, i * 0.37f);
+		...
+		crowd.Update(deltaTime, jobs.Parallel());
+
+/*	Then the vertices can be skinned either on the CPU, straight into a streaming vertex buffer,
+
+		RingAllocation skinned = skinToBuffer(vertexStream, mesh.vertices, crowd.Palette(i), jobs.Parallel());
+
+	or on the GPU, by uploading all palettes and blending in the vertex shader with skinning.glsl:
+
+		uploadPalettes(paletteStream, crowd.palettes);
+		...
+		#include "skinning.glsl"
+		gl_Position = projection * view * model * skinMatrix() * vec4(aPos, 1.0);
+
+	benchmarkSkinning(vertices, bones, iterations) reports how many vertices per second the CPU
+	path manages on the current machine. */
+
+/*	Storing Clips Compactly
+
+	An AnimationClip keeps a float time and a full vec3 or quat for every key, around 50 bytes per
+	joint per frame. animation_compression.h resamples a clip at a fixed rate, drops every frame
+	that interpolating its neighbours reproduces within an error bound, and quantizes what is left
+	(rotations to 6 bytes with the smallest-three trick, translations and scales to 16 bits per
+	component). The result is a file that is mapped and sampled in place: */
+
+		CompressionSettings settings;
+		settings.rotationError = 0.001f; // radians
+		saveClip("walk.anim", compressClip(walk, skeleton, settings));
+		...
+		MappedFile file("walk.anim");
+		CompressedClip compressed;
+		compressed.Load(file.Data(), file.Size());
+		compressed.Sample(time, skeleton, pose);
+
+/*	measureCompression compares a compressed clip with its source and reports the largest error
+	per channel, both sizes and how many poses per second the decoder manages. */
+
+/*	Keeping Track of GPU Memory
+
+	GL doesn't say how much memory a buffer or texture takes, or which part of the program it
+	belongs to. gpu_memory.h keeps that record: setupMesh, the material textures, the streaming
+	ring buffers and the lightmaps report every allocation with its size, an owner tag and the
+	line that made it, and report again before deleting it: */
+
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+		gpuMemory().TrackBuffer(VBO, vertices.size() * sizeof(Vertex), GPU_MEMORY_VERTEX, "mesh", GPU_MEMORY_SITE);
+
+/*	gpuMemory().Report(std::cout) prints the totals per category and per owner with their peaks.
+	Anything still tracked when the program exits is listed as a leak. With a budget set, EnforceBudget
+	frees least recently used resources that were registered with SetEvictable until the total
+	fits again. */
+
+/*	Who Deletes the Buffers
+
+	The mesh above creates a vertex array and two buffers and never deletes them, and copying a
+	Mesh would leave two meshes holding the same names. gpu_resources.h gives every GL object a
+	single owner instead: GpuBuffer, GpuTexture and GpuVertexArray can be moved but not copied, and
+	destroying one frees its object. Mesh keeps its objects in them, so a Mesh is moved too: */
+
+		vector<Mesh> meshes;
+		meshes.push_back(Mesh(vertices, indices, textures));
+
+/*	Freeing doesn't mean calling glDeleteBuffers straight away; the GPU may not have run the draws
+	of the last frame yet. Destroyed objects are collected per frame behind a fence and deleted
+	together once the GPU is past that frame: */
+
+		while (!glfwWindowShouldClose(window))
+		{
+			gpuResources().Collect();  // delete what the GPU has finished with
+			...
+			gpuResources().EndFrame(); // fence this frame's destroyed objects
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+		gpuResources().Flush();
+		glfwTerminate();
+
+/*	The pool hands out handles with a generation number, so an old handle to an object that has
+	been destroyed resolves to 0 instead of to whatever object was created in its place. */
+
+/*	Measuring It
+
+	Every change above was made to save CPU time, so each needs a number before and after.
+	benchmark.h is a small runner in the style of Google Benchmark, and hot_path_benchmarks.h times
+	Mesh setup and Draw, texture decoding, uniform lookups by name, the camera update, batched
+	matrix products and frustum culling over 1k, 100k and 1M objects. null_gl.h stands in for the
+	driver, so none of it needs a window: */
+
+		int main(int argc, char** argv)
+		{
+			loadNullGL(); // instead of glfwInit and gladLoadGLLoader
+
+			BenchmarkAssets assets;
+			assets.texturePath = FileSystem::getPath("resources/textures/container2.png");
+			assets.vertexShaderPath = "1.model_loading.vs";
+			assets.fragmentShaderPath = "1.model_loading.fs";
+
+			BenchmarkRunner runner;
+			runner.ParseArguments(argc, argv);
+			registerHotPathBenchmarks(runner, assets);
+			return runner.Run();
+		}
+
+/*	Run it with --benchmark_out=baseline.json once to keep a baseline, and in the build with
+	--benchmark_baseline=baseline.json: anything more than 10% slower (--benchmark_tolerance) is
+	printed as a regression and the program exits with 1, which fails the build step. */
+
+/*	Streaming Assets In
+
+	Loading every texture and mesh at full detail before the first frame makes the start slow and
+	puts all of it in GPU memory, including what is far away or behind the camera. asset_streaming.h
+	loads them while the program runs instead, most visible first. The assets are converted once
+	into files that can be read one level at a time: */
+
+		writeStreamingTexture("container2.stex", data, width, height); // data from stbi_load, RGBA
+		writeStreamingMesh("rock.smsh", lods, 300.0f); // LOD 0 is worth its detail from 300 pixels up
+
+/*	and the StreamingManager is told where each one is. Update looks at the camera every frame,
+	works out how large each asset is on screen, reads the level that matches on a worker thread
+	and uploads it within a per-frame budget: */
+
+		JobSystem jobs;
+		StreamingManager streaming(jobs);
+		int crate = streaming.AddTexture("container2.stex", glm::vec3(0.0f), 0.87f);
+		int rock = streaming.AddMesh("rock.smsh", glm::vec3(10.0f, 0.0f, -4.0f), 1.5f);
+
+		while (!glfwWindowShouldClose(window))
+		{
+			camera.Update();
+			streaming.Update(camera.Position, camera.GetFrustum());
+			...
+			glBindTexture(GL_TEXTURE_2D, streaming.GetTexture(crate));
+			if (Mesh* mesh = streaming.GetMesh(rock))
+				mesh->Draw(shader);
+		}
+
+/*	Everything starts at its coarsest level, which is only a few bytes, and sharpens over the next
+	frames. Once the streamed assets would take more than settings.memoryBudget, the ones that
+	matter least are moved back to coarser mips and LODs. */
+
+/*	Not Drawing the Back Half
+
+	Mesh::Draw hands the GPU every triangle, and for a closed model about half of them face away
+	from the camera. The GPU throws those away only after their vertices have been shaded. We can
+	throw most of them away before that, in groups: meshlets.h splits the mesh into meshlets of at
+	most 64 vertices and 124 triangles, each a small connected patch with a bounding sphere and a
+	cone around its triangles' normals. The triangles are reordered so that every meshlet is one
+	run of the index buffer, and the mesh is built from that order: */
+
+		MeshletSet meshlets = buildMeshlets(vertices, indices);
+		Mesh mesh(vertices, meshlets.indices, textures);
+
+/*	Every frame MeshletCuller tests the spheres against the frustum and the cones against the
+	direction from the camera (eight meshlets at a time with AVX, chunks in parallel), and merges
+	runs of visible meshlets into indirect draw commands: */
+
+		StreamRingBuffer indirectRing(GL_DRAW_INDIRECT_BUFFER, 64 * 1024);
+		MeshletCuller culler;
+
+		while (!glfwWindowShouldClose(window))
+		{
+			indirectRing.BeginFrame();
+			// the tests run in the mesh's own space
+			glm::mat4 model = glm::mat4(1.0f);
+			Frustum frustum(projection * view * model);
+			glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(camera.Position, 1.0f));
+
+			culler.Cull(meshlets, frustum, eye);
+			drawMeshlets(mesh, shader, indirectRing, culler); // one glMultiDrawElementsIndirect
+			...
+			indirectRing.EndFrame();
+		}
+
+/*	A meshlet is culled only if all of its triangles face away, so the GPU still gets a few
+	backfaces along the silhouette, but on a sphere seen from outside the draw shrinks to about
+	45% of its triangles. The meshlet_cull benchmark measures the CPU side. */
+
+/*	Smaller Files
+
+	A Vertex is 88 bytes, so a model of a few hundred thousand vertices is tens of megabytes on
+	disk, and most of those bytes say nearly the same thing as the vertex before them. The codec in
+	mesh_compression.h stores, lane by lane, the difference to the previous vertex with its bytes
+	split into planes, and packs each group of 16 bytes into 0, 2, 4 or 8 bits apiece. Nothing is
+	lost; a decoded mesh is bit for bit the one that was saved. Compressing is done once, offline: */
+
+		std::vector<std::uint8_t> bytes = compressMesh(vertices, meshlets.indices);
+		saveCompressedMesh("rock.mesh", bytes);
+
+/*	Loading maps the file and decodes. Since the decoder only ever writes its output front to back,
+	it can write straight into a mapped buffer instead of going through a vector and glBufferData: */
+
+		MappedFile file;
+		CompressedMesh compressed;
+		if (file.Open("rock.mesh") && compressed.Load(file.Data(), file.Size()))
+		{
+			glState().BindBuffer(GL_ARRAY_BUFFER, VBO);
+			glBufferData(GL_ARRAY_BUFFER, compressed.VertexCount() * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+			Vertex* mapped = static_cast<Vertex*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, compressed.VertexCount() * sizeof(Vertex),
+			                                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			compressed.DecodeVertices(mapped);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			// the same for the indices with GL_ELEMENT_ARRAY_BUFFER and DecodeIndices
+		}
+
+/*	or, for a Mesh, compressed.Decode(vertices, indices) fills the two vectors. Meshes that are
+	smooth and whose indices are in meshlet order come out about three times smaller, and with SSE2
+	the decoder turns out a couple of gigabytes a second. measureMeshCompression reports both for
+	a mesh of your own. */
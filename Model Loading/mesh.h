@@ -8,6 +8,12 @@
 
 #include <learnopengl/shader.h>
 
+#include "../Advanced OpenGL/state_cache.h"
+#include "../Advanced OpenGL/draw_commands.h"
+#include "../Advanced OpenGL/gpu_memory.h"
+#include "../Advanced OpenGL/gpu_resources.h"
+
+#include <iostream>
 #include <string>
 #include <vector>
 using namespace std;
@@ -43,7 +49,10 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    // name of the vertex array owned by the mesh, for binding; 0 once the mesh was moved from
+    unsigned int VAO = 0;
+    // when set, the textures live in a MaterialTextures set and the shader looks them up by this ID
+    int materialID = -1;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -56,9 +65,105 @@ public:
         setupMesh();
     }
 
+    // the GL objects belong to one mesh only: a copy would delete them twice, so meshes are moved.
+    // They are freed when the mesh is destroyed, once the GPU has finished the frame (gpu_resources.h).
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    Mesh(Mesh&& other) noexcept
+        : vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)),
+          VAO(other.VAO), materialID(other.materialID), vertexArray(std::move(other.vertexArray)),
+          vertexBuffer(std::move(other.vertexBuffer)), indexBuffer(std::move(other.indexBuffer)),
+          lightmapBuffer(std::move(other.lightmapBuffer))
+    {
+        other.VAO = 0;
+    }
+
+    Mesh& operator=(Mesh&& other) noexcept
+    {
+        if (this != &other)
+        {
+            vertices = std::move(other.vertices);
+            indices = std::move(other.indices);
+            textures = std::move(other.textures);
+            VAO = other.VAO;
+            materialID = other.materialID;
+            vertexArray = std::move(other.vertexArray);
+            vertexBuffer = std::move(other.vertexBuffer);
+            indexBuffer = std::move(other.indexBuffer);
+            lightmapBuffer = std::move(other.lightmapBuffer);
+            other.VAO = 0;
+        }
+        return *this;
+    }
+
     // render the mesh
     void Draw(Shader &shader) 
     {
+        bindTextures(shader);
+        // draw mesh; the VAO stays bound so the next draw of this mesh doesn't rebind it
+        glState().BindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+    }
+
+    // render parts of the index buffer: drawCount DrawElementsIndirectCommands at offset in buffer,
+    // such as the ranges a MeshletCuller leaves visible (meshlets.h)
+    void DrawIndirect(Shader &shader, unsigned int buffer, GLintptr offset, GLsizei drawCount)
+    {
+        bindTextures(shader);
+        glState().BindVertexArray(VAO);
+        glState().BindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(offset), drawCount, 0);
+    }
+
+    // the same draw as a packet, to be recorded into a DrawList and submitted sorted (draw_commands.h);
+    // meshes without a materialID need their textures registered as a texture set
+    DrawPacket Packet(unsigned int program, const glm::mat4& model, unsigned int textureSet = 0) const
+    {
+        DrawPacket packet;
+        packet.program = program;
+        packet.vertexArray = VAO;
+        packet.material = materialID;
+        packet.textureSet = materialID >= 0 ? 0 : textureSet;
+        packet.count = static_cast<GLsizei>(indices.size());
+        packet.model = model;
+        return packet;
+    }
+
+    // second set of texture coordinates for a baked lightmap (light_baker.h), one per vertex, in
+    // their own buffer at attribute location 7 so meshes without a lightmap don't grow
+    void SetLightmapCoords(const vector<glm::vec2>& coords)
+    {
+        if (coords.size() != vertices.size())
+        {
+            std::cout << "ERROR::MESH::LIGHTMAP_COORDS_COUNT_MISMATCH: " << coords.size() << " for " << vertices.size() << " vertices" << std::endl;
+            return;
+        }
+        if (!lightmapBuffer)
+            lightmapBuffer = GpuBuffer::Create();
+        glState().BindVertexArray(VAO);
+        glState().BindBuffer(GL_ARRAY_BUFFER, lightmapBuffer.Name());
+        glBufferData(GL_ARRAY_BUFFER, coords.size() * sizeof(glm::vec2), coords.data(), GL_STATIC_DRAW);
+        gpuMemory().TrackBuffer(lightmapBuffer.Name(), coords.size() * sizeof(glm::vec2), GPU_MEMORY_VERTEX, "mesh lightmap coords", GPU_MEMORY_SITE);
+        glEnableVertexAttribArray(7);
+        glVertexAttribPointer(7, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glState().BindVertexArray(0);
+    }
+
+private:
+    // render data 
+    GpuVertexArray vertexArray;
+    GpuBuffer vertexBuffer, indexBuffer, lightmapBuffer;
+
+    void bindTextures(Shader &shader)
+    {
+        if (materialID >= 0)
+        {
+            // nothing to bind: the material's textures are already resident
+            glUniform1i(glGetUniformLocation(shader.ID, "materialID"), materialID);
+            return;
+        }
+
         // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
@@ -66,7 +171,6 @@ public:
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -81,41 +185,32 @@ public:
 
             // now set the sampler to the correct texture unit
             glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // and finally bind the texture; the state cache skips units that already hold it
+            glState().BindTexture(i, GL_TEXTURE_2D, textures[i].id);
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
         // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        vertexArray = GpuVertexArray::Create();
+        vertexBuffer = GpuBuffer::Create();
+        indexBuffer = GpuBuffer::Create();
+        VAO = vertexArray.Name();
 
-        glBindVertexArray(VAO);
+        glState().BindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glState().BindBuffer(GL_ARRAY_BUFFER, vertexBuffer.Name());
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        gpuMemory().TrackBuffer(vertexBuffer.Name(), vertices.size() * sizeof(Vertex), GPU_MEMORY_VERTEX, "mesh", GPU_MEMORY_SITE);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glState().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.Name());
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        gpuMemory().TrackBuffer(indexBuffer.Name(), indices.size() * sizeof(unsigned int), GPU_MEMORY_INDEX, "mesh", GPU_MEMORY_SITE);
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -140,7 +235,8 @@ private:
 		// weights
 		glEnableVertexAttribArray(6);
 		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        // unbind so later index buffer binds can't end up in this VAO
+        glState().BindVertexArray(0);
     }
 };
 #endif
@@ -0,0 +1,437 @@
+#ifndef MESH_COMPRESSION_H
+#define MESH_COMPRESSION_H
+
+#include "mesh.h"
+#include "animation_compression.h" // MappedFile
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+/*  Lossless compression of a mesh's vertices and indices for storage on disk, decoded fast
+    enough to go straight into a mapped GPU buffer.
+
+    Both streams are treated as elements of 32-bit lanes: a Vertex is 22 lanes (14 floats, the 4
+    bone IDs and 4 weights; sizeof(Vertex) is 88), an index is one. Every lane goes through the
+    same filters:
+
+    - delta: each value minus the same lane of the element before, on the bit pattern, so equal
+      or nearby values become small numbers (this is exact for floats too, it's integer math);
+    - zigzag: small negative differences become small positive numbers (0, -1, 1, -2 -> 0, 1, 2, 3);
+    - byte transpose: the four bytes of a lane are split into four planes, so the mostly zero
+      high bytes end up next to each other.
+
+    The entropy stage then packs each plane in groups of 16 bytes at the smallest of 0, 2, 4 or 8
+    bits per byte that holds the whole group, with the widths in a 2-bit header per group. All
+    zero groups, which are most high-byte planes and every unused bone lane, cost only their
+    header. Fixed widths decode without branches per byte: with SSE2 a group is one load, a few
+    shifts and unpacks, and the planes are put back together and summed up sixteen values at a
+    time.
+
+    Elements are coded in blocks of MESH_CODEC_BLOCK, lane by lane within a block, so the decoder
+    works on a few kilobytes at a time and writes its output front to back; that's what makes a
+    write-combined mapping a fine destination. The file layout is little endian:
+
+        MeshFileHeader
+        vertex stream   per block, per lane, per plane: uint8 widths[4], packed groups
+        index stream    the same, with one lane
+*/
+
+#define MESH_CODEC_BLOCK 256
+#define MESH_CODEC_GROUP 16
+
+struct MeshFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t vertexSize;   // sizeof(Vertex) when written; a different layout can't be decoded
+    std::uint32_t vertexCount;
+    std::uint32_t indexCount;
+    std::uint32_t vertexBytes;  // compressed sizes of the two streams
+    std::uint32_t indexBytes;
+};
+
+const std::uint32_t MESH_FILE_VERSION = 1;
+
+namespace detail {
+
+inline std::uint32_t zigzag(std::uint32_t difference)
+{
+    return (difference << 1) ^ (0u - (difference >> 31));
+}
+
+inline std::uint32_t unzigzag(std::uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+// 0, 2, 4 or 8 bits per byte as width codes 0 to 3
+inline unsigned int groupWidth(const std::uint8_t* group)
+{
+    std::uint8_t largest = 0;
+    for (int i = 0; i < MESH_CODEC_GROUP; i++)
+        largest = std::max(largest, group[i]);
+    return largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+}
+
+inline void encodePlane(const std::uint8_t* plane, std::vector<std::uint8_t>& out)
+{
+    const int groups = MESH_CODEC_BLOCK / MESH_CODEC_GROUP;
+    size_t header = out.size();
+    out.resize(out.size() + groups / 4, 0);
+    for (int g = 0; g < groups; g++)
+    {
+        const std::uint8_t* group = plane + g * MESH_CODEC_GROUP;
+        unsigned int width = groupWidth(group);
+        out[header + g / 4] |= static_cast<std::uint8_t>(width << ((g % 4) * 2));
+        if (width == 1)
+            for (int i = 0; i < MESH_CODEC_GROUP; i += 4)
+                out.push_back(static_cast<std::uint8_t>(group[i] << 6 | group[i + 1] << 4 | group[i + 2] << 2 | group[i + 3]));
+        else if (width == 2)
+            for (int i = 0; i < MESH_CODEC_GROUP; i += 2)
+                out.push_back(static_cast<std::uint8_t>(group[i] << 4 | group[i + 1]));
+        else if (width == 3)
+            out.insert(out.end(), group, group + MESH_CODEC_GROUP);
+    }
+}
+
+// unpack one plane of a block; returns the bytes read, 0 if the data ends early
+inline size_t decodePlane(const std::uint8_t* data, size_t size, std::uint8_t* plane)
+{
+    const int groups = MESH_CODEC_BLOCK / MESH_CODEC_GROUP;
+    static const size_t groupBytes[4] = { 0, MESH_CODEC_GROUP / 4, MESH_CODEC_GROUP / 2, MESH_CODEC_GROUP };
+    if (size < groups / 4)
+        return 0;
+    const std::uint8_t* header = data;
+    size_t read = groups / 4;
+    for (int g = 0; g < groups; g++)
+    {
+        unsigned int width = (header[g / 4] >> ((g % 4) * 2)) & 3;
+        if (read + groupBytes[width] > size)
+            return 0;
+        const std::uint8_t* in = data + read;
+        std::uint8_t* group = plane + g * MESH_CODEC_GROUP;
+        read += groupBytes[width];
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128i values;
+        if (width == 0)
+            values = _mm_setzero_si128();
+        else if (width == 1)
+        {
+            std::int32_t packed;
+            std::memcpy(&packed, in, sizeof(packed));
+            __m128i bytes = _mm_cvtsi32_si128(packed);
+            const __m128i mask = _mm_set1_epi8(3);
+            // the shifts are 16 bits wide; the mask drops what moved over from the neighbouring byte
+            __m128i a = _mm_and_si128(_mm_srli_epi16(bytes, 6), mask);
+            __m128i b = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+            __m128i c = _mm_and_si128(_mm_srli_epi16(bytes, 2), mask);
+            __m128i d = _mm_and_si128(bytes, mask);
+            values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+        }
+        else if (width == 2)
+        {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+            const __m128i mask = _mm_set1_epi8(15);
+            values = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask), _mm_and_si128(bytes, mask));
+        }
+        else
+            values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(group), values);
+#else
+        if (width == 0)
+            std::memset(group, 0, MESH_CODEC_GROUP);
+        else if (width == 1)
+            for (int i = 0; i < MESH_CODEC_GROUP; i++)
+                group[i] = (in[i / 4] >> (6 - (i % 4) * 2)) & 3;
+        else if (width == 2)
+            for (int i = 0; i < MESH_CODEC_GROUP; i++)
+                group[i] = (in[i / 2] >> (i % 2 ? 0 : 4)) & 15;
+        else
+            std::memcpy(group, in, MESH_CODEC_GROUP);
+#endif
+    }
+    return read;
+}
+
+// planes back to values, undo zigzag and delta; previous is the lane's last value before the block
+inline void decodeLane(const std::uint8_t* planes, std::uint32_t* values, std::uint32_t& previous)
+{
+    const std::uint8_t* p0 = planes;
+    const std::uint8_t* p1 = planes + MESH_CODEC_BLOCK;
+    const std::uint8_t* p2 = planes + MESH_CODEC_BLOCK * 2;
+    const std::uint8_t* p3 = planes + MESH_CODEC_BLOCK * 3;
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128i running = _mm_set1_epi32(static_cast<int>(previous));
+    const __m128i one = _mm_set1_epi32(1);
+    for (int i = 0; i < MESH_CODEC_BLOCK; i += 16)
+    {
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + i));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + i));
+        __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p2 + i));
+        __m128i b3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p3 + i));
+        __m128i low01 = _mm_unpacklo_epi8(b0, b1), high01 = _mm_unpackhi_epi8(b0, b1);
+        __m128i low23 = _mm_unpacklo_epi8(b2, b3), high23 = _mm_unpackhi_epi8(b2, b3);
+        __m128i quads[4] = { _mm_unpacklo_epi16(low01, low23), _mm_unpackhi_epi16(low01, low23),
+                             _mm_unpacklo_epi16(high01, high23), _mm_unpackhi_epi16(high01, high23) };
+        for (__m128i& x : quads)
+        {
+            x = _mm_xor_si128(_mm_srli_epi32(x, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(x, one)));
+            // prefix sum of four differences, on top of the last value so far
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, running);
+            running = _mm_shuffle_epi32(x, 0xFF);
+        }
+        for (int q = 0; q < 4; q++)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i + q * 4), quads[q]);
+    }
+    previous = static_cast<std::uint32_t>(_mm_cvtsi128_si32(running));
+#else
+    for (int i = 0; i < MESH_CODEC_BLOCK; i++)
+    {
+        std::uint32_t value = std::uint32_t(p0[i]) | std::uint32_t(p1[i]) << 8 | std::uint32_t(p2[i]) << 16 | std::uint32_t(p3[i]) << 24;
+        previous += unzigzag(value);
+        values[i] = previous;
+    }
+#endif
+}
+
+} // namespace detail
+
+// append count elements of lanes 32-bit values (element after element) to out
+inline void encodeMeshStream(const std::uint32_t* values, size_t count, size_t lanes, std::vector<std::uint8_t>& out)
+{
+    std::vector<std::uint32_t> previous(lanes, 0);
+    std::vector<std::uint8_t> planes(MESH_CODEC_BLOCK * 4);
+    for (size_t first = 0; first < count; first += MESH_CODEC_BLOCK)
+    {
+        size_t n = std::min<size_t>(MESH_CODEC_BLOCK, count - first);
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            // the tail of the last block is coded as zero differences
+            std::fill(planes.begin(), planes.end(), 0);
+            for (size_t i = 0; i < n; i++)
+            {
+                std::uint32_t value = values[(first + i) * lanes + lane];
+                std::uint32_t coded = detail::zigzag(value - previous[lane]);
+                previous[lane] = value;
+                for (int byte = 0; byte < 4; byte++)
+                    planes[byte * MESH_CODEC_BLOCK + i] = static_cast<std::uint8_t>(coded >> (byte * 8));
+            }
+            for (int byte = 0; byte < 4; byte++)
+                detail::encodePlane(&planes[byte * MESH_CODEC_BLOCK], out);
+        }
+    }
+}
+
+/*  Decode count elements of lanes values into out, which only gets written, front to back, one
+    block at a time: it can be a mapped buffer. Returns the bytes of data used, 0 if the stream is
+    damaged or too short. */
+inline size_t decodeMeshStream(const std::uint8_t* data, size_t size, size_t count, size_t lanes, std::uint32_t* out)
+{
+    std::vector<std::uint32_t> previous(lanes, 0);
+    std::vector<std::uint8_t> planes(MESH_CODEC_BLOCK * 4);
+    // one block of every lane, then interleaved into elements
+    std::vector<std::uint32_t> block(MESH_CODEC_BLOCK * lanes);
+    size_t read = 0;
+    for (size_t first = 0; first < count; first += MESH_CODEC_BLOCK)
+    {
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            for (int byte = 0; byte < 4; byte++)
+            {
+                size_t used = detail::decodePlane(data + read, size - read, &planes[byte * MESH_CODEC_BLOCK]);
+                if (!used)
+                    return 0;
+                read += used;
+            }
+            detail::decodeLane(planes.data(), &block[lane * MESH_CODEC_BLOCK], previous[lane]);
+        }
+        size_t n = std::min<size_t>(MESH_CODEC_BLOCK, count - first);
+        std::uint32_t* element = out + first * lanes;
+        if (lanes == 1)
+            std::memcpy(element, block.data(), n * sizeof(std::uint32_t));
+        else
+            for (size_t i = 0; i < n; i++, element += lanes)
+                for (size_t lane = 0; lane < lanes; lane++)
+                    element[lane] = block[lane * MESH_CODEC_BLOCK + i];
+    }
+    return read;
+}
+
+// the complete file contents for a mesh
+inline std::vector<std::uint8_t> compressMesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices)
+{
+    static_assert(sizeof(Vertex) % sizeof(std::uint32_t) == 0, "Vertex must be made of 32-bit values");
+    std::vector<std::uint8_t> bytes(sizeof(MeshFileHeader));
+    const size_t lanes = sizeof(Vertex) / sizeof(std::uint32_t);
+    // Vertex is plain floats and ints, so its bytes are its lanes
+    std::vector<std::uint32_t> words(vertices.size() * lanes);
+    if (!vertices.empty())
+        std::memcpy(words.data(), vertices.data(), vertices.size() * sizeof(Vertex));
+    encodeMeshStream(words.data(), vertices.size(), lanes, bytes);
+    size_t vertexBytes = bytes.size() - sizeof(MeshFileHeader);
+    encodeMeshStream(indices.data(), indices.size(), 1, bytes);
+
+    MeshFileHeader header;
+    std::memcpy(header.magic, "MESH", 4);
+    header.version = MESH_FILE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.vertexCount = static_cast<std::uint32_t>(vertices.size());
+    header.indexCount = static_cast<std::uint32_t>(indices.size());
+    header.vertexBytes = static_cast<std::uint32_t>(vertexBytes);
+    header.indexBytes = static_cast<std::uint32_t>(bytes.size() - sizeof(MeshFileHeader) - vertexBytes);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+inline bool saveCompressedMesh(const std::string& path, const std::vector<std::uint8_t>& bytes)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return static_cast<bool>(file);
+}
+
+/*  Reads a compressed mesh from its bytes (a MappedFile or what compressMesh returned), which
+    have to stay alive while it is used. DecodeVertices and DecodeIndices fill any memory large
+    enough, vectors for a Mesh or a buffer mapped with GL_MAP_WRITE_BIT. */
+class CompressedMesh {
+public:
+    // check the header and keep a pointer to the data; false if it isn't a mesh file this build can read
+    bool Load(const std::uint8_t* bytes, size_t byteSize)
+    {
+        data = nullptr;
+        if (!bytes || byteSize < sizeof(MeshFileHeader))
+            return false;
+        std::memcpy(&header, bytes, sizeof(header));
+        if (std::memcmp(header.magic, "MESH", 4) != 0 || header.version != MESH_FILE_VERSION ||
+            sizeof(MeshFileHeader) + size_t(header.vertexBytes) + header.indexBytes > byteSize)
+        {
+            std::cout << "ERROR::MESH_COMPRESSION: not a compressed mesh or wrong version" << std::endl;
+            return false;
+        }
+        if (header.vertexSize != sizeof(Vertex))
+        {
+            std::cout << "ERROR::MESH_COMPRESSION: written with a " << header.vertexSize << " byte Vertex, this build has "
+                      << sizeof(Vertex) << std::endl;
+            return false;
+        }
+        // every block codes at least the width headers of its planes; a header that asks for more
+        // elements than its streams could hold is damaged, and mustn't size the decode buffers
+        if (header.vertexBytes < minimumStreamBytes(header.vertexCount, sizeof(Vertex) / sizeof(std::uint32_t)) ||
+            header.indexBytes < minimumStreamBytes(header.indexCount, 1))
+        {
+            std::cout << "ERROR::MESH_COMPRESSION: counts don't fit the stream sizes" << std::endl;
+            return false;
+        }
+        data = bytes;
+        return true;
+    }
+
+    bool Valid() const
+    {
+        return data != nullptr;
+    }
+
+    size_t VertexCount() const
+    {
+        return header.vertexCount;
+    }
+
+    size_t IndexCount() const
+    {
+        return header.indexCount;
+    }
+
+    size_t ByteSize() const
+    {
+        return sizeof(MeshFileHeader) + header.vertexBytes + header.indexBytes;
+    }
+
+    bool DecodeVertices(Vertex* out) const
+    {
+        if (!data)
+            return false;
+        size_t used = decodeMeshStream(data + sizeof(MeshFileHeader), header.vertexBytes, header.vertexCount,
+                                       sizeof(Vertex) / sizeof(std::uint32_t), reinterpret_cast<std::uint32_t*>(out));
+        return check(used || header.vertexCount == 0);
+    }
+
+    bool DecodeIndices(unsigned int* out) const
+    {
+        if (!data)
+            return false;
+        size_t used = decodeMeshStream(data + sizeof(MeshFileHeader) + header.vertexBytes, header.indexBytes, header.indexCount, 1, out);
+        return check(used || header.indexCount == 0);
+    }
+
+    // both streams into the vectors a Mesh is built from
+    bool Decode(vector<Vertex>& vertices, vector<unsigned int>& indices) const
+    {
+        vertices.resize(VertexCount());
+        indices.resize(IndexCount());
+        return DecodeVertices(vertices.data()) && DecodeIndices(indices.data());
+    }
+
+private:
+    MeshFileHeader header = {};
+    const std::uint8_t* data = nullptr;
+
+    static std::uint64_t minimumStreamBytes(std::uint64_t count, std::uint64_t lanes)
+    {
+        const std::uint64_t headerBytes = MESH_CODEC_BLOCK / MESH_CODEC_GROUP / 4;
+        return (count + MESH_CODEC_BLOCK - 1) / MESH_CODEC_BLOCK * lanes * 4 * headerBytes;
+    }
+
+    static bool check(bool ok)
+    {
+        if (!ok)
+            std::cout << "ERROR::MESH_COMPRESSION: stream is damaged or truncated" << std::endl;
+        return ok;
+    }
+};
+
+struct MeshCompressionReport {
+    size_t sourceBytes = 0;       // raw Vertex and index data
+    size_t compressedBytes = 0;
+    bool exact = false;           // decoded data is bit for bit the source
+    double decodeBytesPerSecond = 0.0; // of decoded output
+};
+
+// compress, check the round trip and time the decoder
+inline MeshCompressionReport measureMeshCompression(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+                                                    int decodeIterations = 20)
+{
+    MeshCompressionReport report;
+    report.sourceBytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+    std::vector<std::uint8_t> bytes = compressMesh(vertices, indices);
+    report.compressedBytes = bytes.size();
+
+    CompressedMesh compressed;
+    vector<Vertex> decodedVertices;
+    vector<unsigned int> decodedIndices;
+    if (!compressed.Load(bytes.data(), bytes.size()) || !compressed.Decode(decodedVertices, decodedIndices))
+        return report;
+    report.exact = decodedIndices == indices && decodedVertices.size() == vertices.size() &&
+                   (vertices.empty() || std::memcmp(decodedVertices.data(), vertices.data(), vertices.size() * sizeof(Vertex)) == 0);
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < decodeIterations; i++)
+    {
+        compressed.DecodeVertices(decodedVertices.data());
+        compressed.DecodeIndices(decodedIndices.data());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    report.decodeBytesPerSecond = seconds > 0.0 ? report.sourceBytes * double(decodeIterations) / seconds : 0.0;
+    return report;
+}
+#endif
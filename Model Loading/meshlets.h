@@ -0,0 +1,426 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "../Getting Started/frustum.h"
+#include "../Advanced OpenGL/ring_buffer.h"
+#include "../In Practice/parallel_for.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// the limits mesh shaders are usually built around; 124 triangles keep 3 * 124 local indices
+// plus the counts within 384 bytes
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// a run of triangles in MeshletSet::indices
+struct Meshlet {
+    unsigned int firstIndex;
+    unsigned int triangleCount;
+    unsigned int vertexCount;
+};
+
+// what glMultiDrawElementsIndirect reads per draw
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/*  Culling data of every meshlet, one array per component so eight meshlets fill one AVX
+    register per component. The arrays are padded to a multiple of eight with meshlets no test
+    can pass.
+
+    The normal cone holds every triangle normal of the meshlet within the angle whose sine is
+    cutoff around axis. A meshlet whose triangles don't face a common way gets a zero axis and a
+    cutoff of 1, which never culls. */
+struct MeshletBounds {
+    vector<float> centerX, centerY, centerZ, radius;
+    vector<float> axisX, axisY, axisZ, cutoff;
+};
+
+struct MeshletSet {
+    vector<Meshlet> meshlets;
+    MeshletBounds bounds;
+    // the mesh's triangles reordered meshlet by meshlet; build the Mesh with these
+    vector<unsigned int> indices;
+};
+
+inline void computeMeshletBounds(const vector<Vertex>& vertices, const unsigned int* indices, const Meshlet& meshlet,
+                                 MeshletBounds& bounds)
+{
+    // sphere around the box of the triangles' corners
+    glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+    for (unsigned int i = 0; i < meshlet.triangleCount * 3; i++)
+    {
+        const glm::vec3& position = vertices[indices[i]].Position;
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+    }
+    glm::vec3 center = (low + high) * 0.5f;
+    float radius = 0.0f;
+    for (unsigned int i = 0; i < meshlet.triangleCount * 3; i++)
+        radius = std::max(radius, glm::length(vertices[indices[i]].Position - center));
+
+    // the cone: average of the face normals (counter-clockwise is front, as glFrontFace's default),
+    // opened up to the one furthest from it
+    vector<glm::vec3> normals;
+    glm::vec3 sum(0.0f);
+    for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+    {
+        const glm::vec3& a = vertices[indices[t * 3]].Position;
+        const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+        const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue; // degenerate, it faces nowhere
+        normals.push_back(normal / length);
+        sum += normals.back();
+    }
+    glm::vec3 axis(0.0f);
+    float cutoff = 1.0f;
+    float sumLength = glm::length(sum);
+    if (sumLength > 0.0f)
+    {
+        axis = sum / sumLength;
+        float minimumDot = 1.0f;
+        for (const glm::vec3& normal : normals)
+            minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+        // a cone wider than a hemisphere has no direction it can be seen only from behind
+        if (minimumDot > 0.0f)
+            cutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+        else
+            axis = glm::vec3(0.0f);
+    }
+
+    bounds.centerX.push_back(center.x);
+    bounds.centerY.push_back(center.y);
+    bounds.centerZ.push_back(center.z);
+    bounds.radius.push_back(radius);
+    bounds.axisX.push_back(axis.x);
+    bounds.axisY.push_back(axis.y);
+    bounds.axisZ.push_back(axis.z);
+    bounds.cutoff.push_back(cutoff);
+}
+
+/*  Splits a mesh into meshlets of at most maxVertices distinct vertices and maxTriangles
+    triangles. Meshlets are grown greedily: the next triangle is the one, among those sharing a
+    vertex with the meshlet so far, that adds the fewest new vertices; when none is left, the
+    first unused triangle in index order is taken instead. That keeps meshlets connected patches
+    where the mesh allows, which is what makes a bounding sphere small and a normal cone narrow.
+
+    Triangles keep their winding and vertex indices, only their order changes, so drawing all of
+    the returned indices draws the same mesh. */
+inline MeshletSet buildMeshlets(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+                                unsigned int maxVertices = MESHLET_MAX_VERTICES, unsigned int maxTriangles = MESHLET_MAX_TRIANGLES)
+{
+    MeshletSet set;
+    size_t triangleCount = indices.size() / 3;
+    set.indices.reserve(triangleCount * 3);
+    maxVertices = std::max(maxVertices, 3u);
+    maxTriangles = std::max(maxTriangles, 1u);
+
+    // triangles around each vertex
+    vector<unsigned int> adjacencyOffsets(vertices.size() + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacencyOffsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertices.size(); v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    vector<unsigned int> adjacency(triangleCount * 3);
+    vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+    vector<bool> used(triangleCount, false);
+    // meshlet number + 1 of the last meshlet that took each vertex
+    vector<unsigned int> taken(vertices.size(), 0);
+    vector<unsigned int> meshletVertices;
+    Meshlet current = { 0, 0, 0 };
+    size_t seed = 0;
+
+    auto newVertices = [&](size_t triangle) {
+        unsigned int count = 0;
+        for (unsigned int corner = 0; corner < 3; corner++)
+            count += taken[indices[triangle * 3 + corner]] != set.meshlets.size() + 1;
+        return count;
+    };
+    auto flush = [&]() {
+        if (current.triangleCount == 0)
+            return;
+        current.vertexCount = static_cast<unsigned int>(meshletVertices.size());
+        set.meshlets.push_back(current);
+        computeMeshletBounds(vertices, &set.indices[current.firstIndex], current, set.bounds);
+        current.firstIndex = static_cast<unsigned int>(set.indices.size());
+        current.triangleCount = 0;
+        meshletVertices.clear();
+    };
+
+    for (size_t added = 0; added < triangleCount; added++)
+    {
+        // the neighbour that adds the fewest vertices, lowest index on ties
+        size_t best = triangleCount;
+        unsigned int bestNew = 4;
+        for (unsigned int vertex : meshletVertices)
+        {
+            for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1] && bestNew > 0; a++)
+            {
+                unsigned int triangle = adjacency[a];
+                if (used[triangle])
+                    continue;
+                unsigned int count = newVertices(triangle);
+                if (count < bestNew || (count == bestNew && triangle < best))
+                {
+                    best = triangle;
+                    bestNew = count;
+                }
+            }
+            if (bestNew == 0)
+                break;
+        }
+        if (best == triangleCount)
+        {
+            while (used[seed])
+                seed++;
+            best = seed;
+            bestNew = newVertices(best);
+        }
+
+        if (meshletVertices.size() + bestNew > maxVertices || current.triangleCount + 1 > maxTriangles)
+        {
+            // full; the triangle starts the next meshlet, next to this one
+            flush();
+        }
+        used[best] = true;
+        for (unsigned int corner = 0; corner < 3; corner++)
+        {
+            unsigned int vertex = indices[best * 3 + corner];
+            if (taken[vertex] != set.meshlets.size() + 1)
+            {
+                taken[vertex] = static_cast<unsigned int>(set.meshlets.size() + 1);
+                meshletVertices.push_back(vertex);
+            }
+            set.indices.push_back(vertex);
+        }
+        current.triangleCount++;
+    }
+    flush();
+
+    // padding no frustum test passes
+    MeshletBounds& bounds = set.bounds;
+    while (bounds.radius.size() % 8)
+    {
+        bounds.centerX.push_back(0.0f);
+        bounds.centerY.push_back(0.0f);
+        bounds.centerZ.push_back(0.0f);
+        bounds.radius.push_back(-FLT_MAX);
+        bounds.axisX.push_back(0.0f);
+        bounds.axisY.push_back(0.0f);
+        bounds.axisZ.push_back(0.0f);
+        bounds.cutoff.push_back(1.0f);
+    }
+    return set;
+}
+
+// what happened to a meshlet in MeshletCuller::Cull
+enum MeshletVisibility : unsigned char {
+    MESHLET_OUTSIDE_FRUSTUM = 0,
+    MESHLET_VISIBLE = 1,
+    MESHLET_BACKFACING = 2
+};
+
+struct MeshletCullStats {
+    size_t meshlets = 0;
+    size_t outsideFrustum = 0;
+    size_t backfacing = 0;
+    size_t visibleTriangles = 0;
+    size_t ranges = 0;      // indirect draws after merging neighbouring visible meshlets
+};
+
+/*  Per-frame culling of a MeshletSet on the CPU. Every meshlet's bounding sphere is tested
+    against the frustum planes and its normal cone against the direction from the camera: a
+    meshlet seen only from behind its cone has nothing but backfaces, which is about half of a
+    closed mesh. With AVX eight meshlets are tested at once.
+
+    The survivors become indirect draw commands. Meshlets are contiguous in the index buffer, so
+    a run of visible meshlets is merged into one command; culling a closed mesh leaves a handful
+    of ranges rather than one draw per meshlet. Chunks of meshlets are culled and emitted in
+    parallel through the ParallelFor; the commands come out in meshlet order either way.
+
+    The frustum and camera position are in the mesh's own space: build the frustum from
+    projection * view * model and transform the camera by the inverse model matrix. */
+class MeshletCuller {
+public:
+    vector<DrawElementsIndirectCommand> commands;
+
+    MeshletCullStats Cull(const MeshletSet& set, const Frustum& frustum, const glm::vec3& cameraPosition,
+                          const ParallelFor& parallelFor = serialFor, size_t grain = 4096)
+    {
+        const size_t count = set.meshlets.size();
+        const size_t padded = set.bounds.radius.size();
+        visibility.resize(padded);
+        commands.clear();
+        MeshletCullStats stats;
+        stats.meshlets = count;
+        if (count == 0)
+            return stats;
+
+        // chunks start on a multiple of eight for the SIMD loop
+        grain = std::max<size_t>((grain + 7) / 8 * 8, 8);
+        const size_t chunks = (count + grain - 1) / grain;
+        chunkStats.assign(chunks, MeshletCullStats());
+        chunkOffsets.assign(chunks + 1, 0);
+
+        parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++)
+                test(set.bounds, frustum, cameraPosition, chunk * grain, std::min(padded, (chunk + 1) * grain));
+        });
+
+        // a range starts at a visible meshlet after an invisible one; every chunk counts its starts
+        parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++)
+            {
+                MeshletCullStats& counted = chunkStats[chunk];
+                size_t last = std::min(count, (chunk + 1) * grain);
+                for (size_t i = chunk * grain; i < last; i++)
+                {
+                    if (visibility[i] == MESHLET_VISIBLE)
+                    {
+                        counted.visibleTriangles += set.meshlets[i].triangleCount;
+                        counted.ranges += i == 0 || visibility[i - 1] != MESHLET_VISIBLE;
+                    }
+                    else if (visibility[i] == MESHLET_BACKFACING)
+                        counted.backfacing++;
+                    else
+                        counted.outsideFrustum++;
+                }
+            }
+        });
+        for (size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            chunkOffsets[chunk + 1] = chunkOffsets[chunk] + chunkStats[chunk].ranges;
+            stats.outsideFrustum += chunkStats[chunk].outsideFrustum;
+            stats.backfacing += chunkStats[chunk].backfacing;
+            stats.visibleTriangles += chunkStats[chunk].visibleTriangles;
+        }
+        stats.ranges = chunkOffsets[chunks];
+        commands.resize(stats.ranges);
+
+        // every start writes its range, following it into the next chunk if it has to
+        parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++)
+            {
+                size_t out = chunkOffsets[chunk];
+                size_t last = std::min(count, (chunk + 1) * grain);
+                for (size_t i = chunk * grain; i < last; i++)
+                {
+                    if (visibility[i] != MESHLET_VISIBLE || (i > 0 && visibility[i - 1] == MESHLET_VISIBLE))
+                        continue;
+                    size_t stop = i;
+                    unsigned int triangles = 0;
+                    while (stop < count && visibility[stop] == MESHLET_VISIBLE)
+                        triangles += set.meshlets[stop++].triangleCount;
+                    commands[out++] = { triangles * 3, 1, set.meshlets[i].firstIndex, 0, 0 };
+                }
+            }
+        });
+        return stats;
+    }
+
+    MeshletVisibility Visibility(size_t meshlet) const
+    {
+        return static_cast<MeshletVisibility>(visibility[meshlet]);
+    }
+
+private:
+    vector<unsigned char> visibility;
+    vector<MeshletCullStats> chunkStats;
+    vector<size_t> chunkOffsets;
+
+    void test(const MeshletBounds& bounds, const Frustum& frustum, const glm::vec3& camera, size_t begin, size_t end)
+    {
+        size_t i = begin;
+#if defined(__AVX__)
+        const __m256 cameraX = _mm256_set1_ps(camera.x);
+        const __m256 cameraY = _mm256_set1_ps(camera.y);
+        const __m256 cameraZ = _mm256_set1_ps(camera.z);
+        const __m256 zero = _mm256_setzero_ps();
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(&bounds.centerX[i]);
+            __m256 y = _mm256_loadu_ps(&bounds.centerY[i]);
+            __m256 z = _mm256_loadu_ps(&bounds.centerZ[i]);
+            __m256 radius = _mm256_loadu_ps(&bounds.radius[i]);
+            __m256 negativeRadius = _mm256_sub_ps(zero, radius);
+
+            // inside (or crossing) every plane
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (const glm::vec4& plane : frustum.planes)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(y, _mm256_set1_ps(plane.y)));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(z, _mm256_set1_ps(plane.z)));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+            }
+
+            // dot(center - camera, axis) >= cutoff * |center - camera| + radius: all backfacing
+            __m256 toX = _mm256_sub_ps(x, cameraX);
+            __m256 toY = _mm256_sub_ps(y, cameraY);
+            __m256 toZ = _mm256_sub_ps(z, cameraZ);
+            __m256 along = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toX, _mm256_loadu_ps(&bounds.axisX[i])),
+                                                       _mm256_mul_ps(toY, _mm256_loadu_ps(&bounds.axisY[i]))),
+                                         _mm256_mul_ps(toZ, _mm256_loadu_ps(&bounds.axisZ[i])));
+            __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toX, toX), _mm256_mul_ps(toY, toY)),
+                                                           _mm256_mul_ps(toZ, toZ)));
+            __m256 limit = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&bounds.cutoff[i]), distance), radius);
+            __m256 backfacing = _mm256_cmp_ps(along, limit, _CMP_GE_OQ);
+
+            int insideMask = _mm256_movemask_ps(inside);
+            int backfacingMask = _mm256_movemask_ps(backfacing);
+            for (int lane = 0; lane < 8; lane++)
+                visibility[i + lane] = !((insideMask >> lane) & 1) ? MESHLET_OUTSIDE_FRUSTUM
+                                     : ((backfacingMask >> lane) & 1) ? MESHLET_BACKFACING : MESHLET_VISIBLE;
+        }
+#endif
+        for (; i < end; i++)
+        {
+            glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+            if (!frustum.IntersectsSphere(center, bounds.radius[i]))
+            {
+                visibility[i] = MESHLET_OUTSIDE_FRUSTUM;
+                continue;
+            }
+            glm::vec3 to = center - camera;
+            glm::vec3 axis(bounds.axisX[i], bounds.axisY[i], bounds.axisZ[i]);
+            bool backfacing = glm::dot(to, axis) >= bounds.cutoff[i] * glm::length(to) + bounds.radius[i];
+            visibility[i] = backfacing ? MESHLET_BACKFACING : MESHLET_VISIBLE;
+        }
+    }
+};
+
+// upload this frame's commands into a GL_DRAW_INDIRECT_BUFFER ring and draw them with the mesh
+// (built from MeshletSet::indices) and its textures
+inline void drawMeshlets(Mesh& mesh, Shader& shader, StreamRingBuffer& indirectRing, const MeshletCuller& culler)
+{
+    if (culler.commands.empty())
+        return;
+    RingAllocation allocation = indirectRing.Write(culler.commands, sizeof(GLuint));
+    if (!allocation.Valid())
+        return;
+    mesh.DrawIndirect(shader, allocation.buffer, allocation.offset, static_cast<GLsizei>(culler.commands.size()));
+}
+#endif
@@ -0,0 +1,34 @@
+// GPU linear blend skinning for meshes set up by Mesh::setupMesh (bone IDs at location 5, weights
+// at location 6). The skinning matrices come from uploadPalettes in skinning.h; with instancing,
+// instance i uses the jointCount matrices starting at i * jointCount.
+#pragma once
+
+#ifndef SKINNING_PALETTE_BINDING
+#define SKINNING_PALETTE_BINDING 2
+#endif
+#define MAX_BONE_INFLUENCE 4
+
+layout (location = 5) in ivec4 boneIds;
+layout (location = 6) in vec4 weights;
+
+layout (std430, binding = SKINNING_PALETTE_BINDING) readonly buffer SkinningPalette {
+    mat4 palette[];
+};
+
+uniform int jointCount;
+
+// blended skinning matrix of this vertex; identity when it has no influences
+mat4 skinMatrix()
+{
+    int first = gl_InstanceID * jointCount;
+    mat4 skin = mat4(0.0);
+    float total = 0.0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        if (boneIds[i] < 0 || weights[i] == 0.0)
+            continue;
+        skin += palette[first + boneIds[i]] * weights[i];
+        total += weights[i];
+    }
+    return total > 0.0 ? skin : mat4(1.0);
+}
@@ -0,0 +1,187 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "animation.h"
+#include "../Advanced OpenGL/ring_buffer.h"
+#include "../In Practice/parallel_for.h"
+
+#include <chrono>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// shader storage binding of the skinning matrices for GPU skinning (skinning.glsl)
+#define SKINNING_PALETTE_BINDING 2
+
+// what the CPU skinning path writes per vertex; the rest of Vertex doesn't change when animated
+struct SkinnedVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+};
+
+/*  Linear blend skinning: every vertex is moved by the weighted sum of up to MAX_BONE_INFLUENCE
+    skinning matrices, picked by m_BoneIDs and weighted by m_Weights. Influences with a negative
+    bone ID or zero weight are ignored and a vertex without any keeps its bind position. Normals
+    use the blended upper 3x3 and are renormalized, which is exact for rotations and uniform
+    scale.
+
+    With AVX the four weighted matrices are summed eight floats (two columns) at a time with FMA,
+    and the position and normal are transformed with the blended columns still in registers;
+    otherwise the same math runs on glm. */
+inline void skinVertices(const Vertex* vertices, size_t count, const glm::mat4* palette, SkinnedVertex* out)
+{
+    for (size_t v = 0; v < count; v++)
+    {
+        const Vertex& vertex = vertices[v];
+#if defined(__AVX__)
+        __m256 columns01 = _mm256_setzero_ps();
+        __m256 columns23 = _mm256_setzero_ps();
+        bool skinned = false;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            if (vertex.m_BoneIDs[i] < 0 || vertex.m_Weights[i] == 0.0f)
+                continue;
+            const float* bone = &palette[vertex.m_BoneIDs[i]][0][0];
+            __m256 weight = _mm256_set1_ps(vertex.m_Weights[i]);
+#if defined(__FMA__)
+            columns01 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(bone), columns01);
+            columns23 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(bone + 8), columns23);
+#else
+            columns01 = _mm256_add_ps(columns01, _mm256_mul_ps(weight, _mm256_loadu_ps(bone)));
+            columns23 = _mm256_add_ps(columns23, _mm256_mul_ps(weight, _mm256_loadu_ps(bone + 8)));
+#endif
+            skinned = true;
+        }
+        if (!skinned)
+        {
+            out[v].Position = vertex.Position;
+            out[v].Normal = vertex.Normal;
+            continue;
+        }
+
+        // column0 * x + column1 * y in one register, column2 * z + column3 * w in the other
+        const glm::vec3& p = vertex.Position;
+        const glm::vec3& n = vertex.Normal;
+        __m256 position = _mm256_add_ps(_mm256_mul_ps(columns01, _mm256_setr_ps(p.x, p.x, p.x, p.x, p.y, p.y, p.y, p.y)),
+                                        _mm256_mul_ps(columns23, _mm256_setr_ps(p.z, p.z, p.z, p.z, 1.0f, 1.0f, 1.0f, 1.0f)));
+        __m256 normal = _mm256_add_ps(_mm256_mul_ps(columns01, _mm256_setr_ps(n.x, n.x, n.x, n.x, n.y, n.y, n.y, n.y)),
+                                      _mm256_mul_ps(columns23, _mm256_setr_ps(n.z, n.z, n.z, n.z, 0.0f, 0.0f, 0.0f, 0.0f)));
+        __m128 p4 = _mm_add_ps(_mm256_castps256_ps128(position), _mm256_extractf128_ps(position, 1));
+        __m128 n4 = _mm_add_ps(_mm256_castps256_ps128(normal), _mm256_extractf128_ps(normal, 1));
+        // normalize n: the dot product lands in every lane; one Newton step refines the estimate
+        __m128 lengthSquared = _mm_max_ps(_mm_dp_ps(n4, n4, 0x7F), _mm_set1_ps(1e-20f));
+        __m128 inverse = _mm_rsqrt_ps(lengthSquared);
+        inverse = _mm_mul_ps(inverse, _mm_sub_ps(_mm_set1_ps(1.5f),
+                                                 _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), lengthSquared), _mm_mul_ps(inverse, inverse))));
+        n4 = _mm_mul_ps(n4, inverse);
+
+        float result[8];
+        _mm_storeu_ps(result, p4);
+        _mm_storeu_ps(result + 4, n4);
+        out[v].Position = glm::vec3(result[0], result[1], result[2]);
+        out[v].Normal = glm::vec3(result[4], result[5], result[6]);
+#else
+        glm::mat4 blended(0.0f);
+        bool skinned = false;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            if (vertex.m_BoneIDs[i] < 0 || vertex.m_Weights[i] == 0.0f)
+                continue;
+            const glm::mat4& bone = palette[vertex.m_BoneIDs[i]];
+            float weight = vertex.m_Weights[i];
+            blended[0] += bone[0] * weight;
+            blended[1] += bone[1] * weight;
+            blended[2] += bone[2] * weight;
+            blended[3] += bone[3] * weight;
+            skinned = true;
+        }
+        if (!skinned)
+        {
+            out[v].Position = vertex.Position;
+            out[v].Normal = vertex.Normal;
+            continue;
+        }
+        out[v].Position = glm::vec3(blended * glm::vec4(vertex.Position, 1.0f));
+        glm::vec3 normal = glm::vec3(blended * glm::vec4(vertex.Normal, 0.0f));
+        float length = glm::length(normal);
+        out[v].Normal = length > 0.0f ? normal / length : normal;
+#endif
+    }
+}
+
+// skin a whole vertex array, split into chunks of grain vertices
+inline void skinVertices(const std::vector<Vertex>& vertices, const glm::mat4* palette, SkinnedVertex* out,
+                         const ParallelFor& parallelFor = serialFor, size_t grain = 4096)
+{
+    parallelFor(vertices.size(), grain, [&](size_t begin, size_t end) {
+        skinVertices(vertices.data() + begin, end - begin, palette, out + begin);
+    });
+}
+
+/*  Skin straight into this frame's part of a streaming buffer (ring_buffer.h), ready to be used as
+    a vertex source for the draw. Without a persistent mapping the vertices go through scratch
+    memory and glBufferSubData; that path has to run on the GL thread. */
+inline RingAllocation skinToBuffer(StreamRingBuffer& ring, const std::vector<Vertex>& vertices, const glm::mat4* palette,
+                                   const ParallelFor& parallelFor = serialFor, std::vector<SkinnedVertex>* scratch = nullptr)
+{
+    GLsizeiptr size = static_cast<GLsizeiptr>(vertices.size() * sizeof(SkinnedVertex));
+    if (ring.Persistent())
+    {
+        RingAllocation allocation = ring.Allocate(size, sizeof(float));
+        if (allocation.Valid())
+            skinVertices(vertices, palette, reinterpret_cast<SkinnedVertex*>(allocation.data), parallelFor);
+        return allocation;
+    }
+
+    std::vector<SkinnedVertex> local;
+    std::vector<SkinnedVertex>& skinned = scratch ? *scratch : local;
+    skinned.resize(vertices.size());
+    skinVertices(vertices, palette, skinned.data(), parallelFor);
+    return ring.Write(skinned.data(), size, sizeof(float));
+}
+
+/*  The GPU path: upload every instance's skinning matrices into a GL_SHADER_STORAGE_BUFFER ring and
+    bind them for skinning.glsl, which blends them in the vertex shader from the m_BoneIDs and
+    m_Weights attributes (locations 5 and 6) that setupMesh already configures. */
+inline RingAllocation uploadPalettes(StreamRingBuffer& ring, const std::vector<glm::mat4>& palettes)
+{
+    RingAllocation allocation = ring.Write(palettes);
+    if (allocation.Valid())
+        ring.BindRange(allocation, SKINNING_PALETTE_BINDING);
+    return allocation;
+}
+
+// skinned vertices per second of the CPU kernel, for a synthetic mesh with four influences per vertex
+inline double benchmarkSkinning(size_t vertexCount, size_t boneCount, int iterations,
+                                const ParallelFor& parallelFor = serialFor)
+{
+    std::vector<Vertex> vertices(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        Vertex& vertex = vertices[v];
+        vertex.Position = glm::vec3(float(v % 97), float(v % 89), float(v % 83)) * 0.01f;
+        vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            vertex.m_BoneIDs[i] = static_cast<int>((v * 7 + i * 13) % boneCount);
+            vertex.m_Weights[i] = 0.25f;
+        }
+    }
+    std::vector<glm::mat4> palette(boneCount);
+    for (size_t b = 0; b < boneCount; b++)
+        palette[b] = glm::translate(glm::mat4(1.0f), glm::vec3(float(b) * 0.1f, 0.0f, 0.0f));
+    std::vector<SkinnedVertex> out(vertexCount);
+
+    skinVertices(vertices, palette.data(), out.data(), parallelFor); // warm up
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++)
+        skinVertices(vertices, palette.data(), out.data(), parallelFor);
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    return seconds > 0.0 ? double(vertexCount) * iterations / seconds : 0.0;
+}
+#endif
@@ -0,0 +1,256 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "matrix_simd.h"
+#include "../In Practice/parallel_for.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+/*  TransformHierarchy replaces the model matrices that each demo builds inline with
+    glm::translate/glm::scale. Nodes are stored as structure of arrays, one vector per field, and
+    kept sorted by depth, so every parent comes before its children and all nodes of one depth are
+    contiguous. Update then walks the depth levels in order; inside a level no node depends on
+    another, so each level is split into chunks that can run on different threads.
+
+    Only dirty subtrees are touched: setting a node's local transform marks it, the marks are
+    pushed down to the children in one linear pass, and clean nodes are skipped. World matrices
+    are computed with the SIMD multiply from matrix_simd.h and the normal matrix is derived in the
+    same pass.
+
+    Sorting moves nodes around, so callers refer to nodes by the NodeID returned from AddNode,
+    which stays valid for the lifetime of the hierarchy. */
+class TransformHierarchy {
+public:
+    typedef std::uint32_t NodeID;
+    static const std::uint32_t NO_PARENT = 0xFFFFFFFFu;
+
+    // structure of arrays, indexed by sorted position (see IndexOf)
+    std::vector<std::uint32_t> parents;     // sorted index of the parent, NO_PARENT for roots
+    std::vector<glm::vec3> localPositions;
+    std::vector<glm::quat> localRotations;
+    std::vector<glm::vec3> localScales;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<glm::mat3> normalMatrices;
+
+    NodeID AddNode(NodeID parent = NO_PARENT, const glm::vec3& position = glm::vec3(0.0f),
+                   const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f))
+    {
+        std::uint32_t index = static_cast<std::uint32_t>(parents.size());
+        std::uint32_t parentIndex = parent == NO_PARENT ? NO_PARENT : indexOf[parent];
+        std::uint32_t depth = parentIndex == NO_PARENT ? 0 : depths[parentIndex] + 1;
+
+        parents.push_back(parentIndex);
+        depths.push_back(depth);
+        localPositions.push_back(position);
+        localRotations.push_back(rotation);
+        localScales.push_back(scale);
+        worldMatrices.push_back(glm::mat4(1.0f));
+        normalMatrices.push_back(glm::mat3(1.0f));
+        dirty.push_back(1);
+
+        NodeID id = static_cast<NodeID>(indexOf.size());
+        indexOf.push_back(index);
+        idOf.push_back(id);
+
+        // the level table has to be rebuilt before the next update
+        unsorted = true;
+        return id;
+    }
+
+    void SetLocal(NodeID node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+    {
+        std::uint32_t index = indexOf[node];
+        localPositions[index] = position;
+        localRotations[index] = rotation;
+        localScales[index] = scale;
+        dirty[index] = 1;
+    }
+
+    void SetPosition(NodeID node, const glm::vec3& position)
+    {
+        std::uint32_t index = indexOf[node];
+        localPositions[index] = position;
+        dirty[index] = 1;
+    }
+
+    void SetRotation(NodeID node, const glm::quat& rotation)
+    {
+        std::uint32_t index = indexOf[node];
+        localRotations[index] = rotation;
+        dirty[index] = 1;
+    }
+
+    // move a node (and its subtree) under another parent; refused if parent is the node itself or
+    // one of its descendants, which would make a cycle
+    bool SetParent(NodeID node, NodeID parent)
+    {
+        std::uint32_t index = indexOf[node];
+        std::uint32_t parentIndex = parent == NO_PARENT ? NO_PARENT : indexOf[parent];
+        for (std::uint32_t ancestor = parentIndex; ancestor != NO_PARENT; ancestor = parents[ancestor])
+            if (ancestor == index)
+            {
+                std::cout << "ERROR::TRANSFORM_HIERARCHY: node " << node << " can't be parented to its own descendant " << parent << std::endl;
+                return false;
+            }
+        parents[index] = parentIndex;
+        dirty[index] = 1;
+        unsorted = true;
+        return true;
+    }
+
+    std::uint32_t IndexOf(NodeID node) const
+    {
+        return indexOf[node];
+    }
+
+    const glm::mat4& World(NodeID node) const
+    {
+        return worldMatrices[indexOf[node]];
+    }
+
+    const glm::mat3& Normal(NodeID node) const
+    {
+        return normalMatrices[indexOf[node]];
+    }
+
+    size_t Size() const
+    {
+        return parents.size();
+    }
+
+    // recompute the world and normal matrices of every dirty node and its descendants
+    void Update(const ParallelFor& parallelFor = serialFor, size_t grain = 1024)
+    {
+        if (unsorted)
+            sort();
+
+        // push dirty marks down; parents come first, so one pass reaches every descendant
+        const size_t count = parents.size();
+        for (size_t i = 0; i < count; i++)
+            if (parents[i] != NO_PARENT && dirty[parents[i]])
+                dirty[i] = 1;
+
+        // levels in order, the nodes inside one level in parallel
+        for (size_t level = 0; level + 1 < levelStarts.size(); level++)
+        {
+            size_t first = levelStarts[level];
+            size_t size = levelStarts[level + 1] - first;
+            parallelFor(size, grain, [this, first](size_t begin, size_t end) {
+                updateRange(first + begin, first + end);
+            });
+        }
+        std::fill(dirty.begin(), dirty.end(), 0);
+    }
+
+private:
+    std::vector<std::uint32_t> depths;
+    std::vector<std::uint8_t> dirty;
+    std::vector<std::uint32_t> indexOf; // NodeID -> sorted index
+    std::vector<NodeID> idOf;           // sorted index -> NodeID
+    std::vector<size_t> levelStarts;    // first index of every depth level, plus the end
+    bool unsorted = true;
+
+    void updateRange(size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            if (!dirty[i])
+                continue;
+
+            // local = T * R * S
+            glm::mat3 rotation = glm::mat3_cast(localRotations[i]);
+            glm::mat4 local(glm::vec4(rotation[0] * localScales[i].x, 0.0f),
+                            glm::vec4(rotation[1] * localScales[i].y, 0.0f),
+                            glm::vec4(rotation[2] * localScales[i].z, 0.0f),
+                            glm::vec4(localPositions[i], 1.0f));
+
+            if (parents[i] == NO_PARENT)
+                worldMatrices[i] = local;
+            else
+                multiplyMat4(worldMatrices[parents[i]], local, worldMatrices[i]);
+            normalMatrices[i] = normalMatrix(worldMatrices[i]);
+        }
+    }
+
+    // recompute depths and reorder every array by depth (stable, so siblings keep their order)
+    void sort()
+    {
+        const size_t count = parents.size();
+
+        // depths can only be computed top-down once the order is right, so resolve them by walking up
+        std::vector<std::uint32_t> depth(count, NO_PARENT);
+        for (size_t i = 0; i < count; i++)
+        {
+            std::uint32_t d = 0;
+            std::uint32_t node = static_cast<std::uint32_t>(i);
+            while (parents[node] != NO_PARENT && depth[node] == NO_PARENT)
+            {
+                node = parents[node];
+                d++;
+            }
+            d += depth[node] == NO_PARENT ? 0 : depth[node];
+            // fill the walked path
+            node = static_cast<std::uint32_t>(i);
+            for (std::uint32_t k = d; depth[node] == NO_PARENT; k--)
+            {
+                depth[node] = k;
+                if (parents[node] == NO_PARENT)
+                    break;
+                node = parents[node];
+            }
+        }
+
+        std::vector<std::uint32_t> order(count);
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&depth](std::uint32_t a, std::uint32_t b) {
+            return depth[a] < depth[b];
+        });
+        std::vector<std::uint32_t> newIndex(count);
+        for (size_t i = 0; i < count; i++)
+            newIndex[order[i]] = static_cast<std::uint32_t>(i);
+
+        std::vector<std::uint32_t> sortedParents(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            std::uint32_t parent = parents[order[i]];
+            sortedParents[i] = parent == NO_PARENT ? NO_PARENT : newIndex[parent];
+        }
+        parents.swap(sortedParents);
+        reorder(depth, order);
+        depths.swap(depth);
+        reorder(localPositions, order);
+        reorder(localRotations, order);
+        reorder(localScales, order);
+        reorder(worldMatrices, order);
+        reorder(normalMatrices, order);
+        reorder(dirty, order);
+        reorder(idOf, order);
+        for (size_t i = 0; i < count; i++)
+            indexOf[idOf[i]] = static_cast<std::uint32_t>(i);
+
+        levelStarts.clear();
+        for (size_t i = 0; i < count; i++)
+            if (i == 0 || depths[i] != depths[i - 1])
+                levelStarts.push_back(i);
+        levelStarts.push_back(count);
+        unsorted = false;
+    }
+
+    template <typename T>
+    static void reorder(std::vector<T>& values, const std::vector<std::uint32_t>& order)
+    {
+        std::vector<T> sorted;
+        sorted.reserve(values.size());
+        for (std::uint32_t index : order)
+            sorted.push_back(values[index]);
+        values.swap(sorted);
+    }
+};
+#endif